@@ -1,8 +1,13 @@
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++11 thread
 CONFIG -= app_bundle
 CONFIG -= qt
 
+# Test build: counts every heap allocation (see src/core/heapcounter.h)
+heapcount {
+    DEFINES += RTIS_COUNT_HEAP
+}
+
 SOURCES += \
     src/shapes/shape.cpp \
     src/shapes/sphere.cpp \
@@ -18,6 +23,38 @@ SOURCES += \
     src/core/vector3d.cpp \
     src/main.cpp \
     src/core/bitmap.cpp \
+    src/core/parallel.cpp \
+    src/core/tonemapper.cpp \
+    src/render/tile.cpp \
+    src/render/renderer.cpp \
+    src/render/distributedrenderer.cpp \
+    src/render/checkpoint.cpp \
+    src/core/rng.cpp \
+    src/core/memoryarena.cpp \
+    src/core/intersection.cpp \
+    src/materials/material.cpp \
+    src/render/wavefront.cpp \
+    src/render/raysort.cpp \
+    src/core/bounds3d.cpp \
+    src/render/frustum.cpp \
+    src/render/visibilitybuffer.cpp \
+    src/render/cropwindow.cpp \
+    src/render/progressive.cpp \
+    src/core/tiledfilm.cpp \
+    src/filters/kernel.cpp \
+    src/filters/fft.cpp \
+    src/filters/convolution.cpp \
+    src/filters/summedareatable.cpp \
+    src/filters/iterativefilter.cpp \
+    src/textures/mippyramid.cpp \
+    src/textures/texture.cpp \
+    src/textures/texturecache.cpp \
+    src/render/scene.cpp \
+    src/render/batchrenderer.cpp \
+    src/render/renderdaemon.cpp \
+    src/core/simd.cpp \
+    src/render/scenegraph.cpp \
+    src/core/heapcounter.cpp \
 
 HEADERS += \
     src/shapes/shape.h \
@@ -32,4 +69,39 @@ HEADERS += \
     src/core/ray.h \
     src/core/tester.h \
     src/core/vector3d.h \
-    src/core/bitmap.h
+    src/core/bitmap.h \
+    src/core/parallel.h \
+    src/core/tonemapper.h \
+    src/render/tile.h \
+    src/render/renderer.h \
+    src/render/distributedrenderer.h \
+    src/render/checkpoint.h \
+    src/core/rng.h \
+    src/core/memoryarena.h \
+    src/core/intersection.h \
+    src/materials/material.h \
+    src/render/wavefront.h \
+    src/render/raysort.h \
+    src/core/bounds3d.h \
+    src/render/frustum.h \
+    src/render/visibilitybuffer.h \
+    src/render/cropwindow.h \
+    src/render/progressive.h \
+    src/core/tiledfilm.h \
+    src/filters/kernel.h \
+    src/filters/fft.h \
+    src/filters/convolution.h \
+    src/filters/summedareatable.h \
+    src/filters/iterativefilter.h \
+    src/textures/mippyramid.h \
+    src/textures/texture.h \
+    src/textures/texturecache.h \
+    src/render/scene.h \
+    src/render/batchrenderer.h \
+    src/render/renderdaemon.h \
+    src/core/simd.h \
+    src/render/scenegraph.h \
+    src/core/heapcounter.h
+
+# shm_open() (render daemon) lives in librt on older glibc
+unix:!macx: LIBS += -lrt
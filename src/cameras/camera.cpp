@@ -1,7 +1,12 @@
 #include "camera.h"
 
 Camera::Camera(const Matrix4x4 &cameraToWorld_, const Film &film_)
-    : cameraToWorld(cameraToWorld_), film(film_)
+    : Camera(cameraToWorld_, film_.getWidth(), film_.getHeight())
+{ }
+
+Camera::Camera(const Matrix4x4 &cameraToWorld_, size_t width_, size_t height_)
+    : cameraToWorld(cameraToWorld_), width(width_), height(height_)
 {
-    aspect = (double) (film.getWidth()) / (double) (film.getHeight());
+    aspect = (double) (width) / (double) (height);
+    cameraToWorld.inverse(worldToCamera);
 }
@@ -9,12 +9,19 @@ class Camera
 public:
     Camera() = delete;
     Camera(const Matrix4x4 &cameraToWorld_, const Film &film_);
+    // Same, with the resolution of the (full) image instead of its film,
+    // e.g., when only a crop window of a large frame is allocated
+    Camera(const Matrix4x4 &cameraToWorld_, size_t width_, size_t height_);
 
     // Given image plane coordinates (u, v) = [0,1]x[0,1] in normalized
     // device coordinates (NDC), returns a ray in WORLD COORDINATES which passes
     // through (u, v)
     virtual Ray generateRay(const double u, const double v) const = 0;
     virtual Vector3D ndcToCameraSpace(const double u, const double v) const = 0;
+    // Inverse mapping: NDC coordinates (u, v) of the image point where the
+    // world point p is seen. Returns false if p cannot be projected (e.g.,
+    // it lies behind a perspective camera)
+    virtual bool worldToNdc(const Vector3D &p, double &u, double &v) const = 0;
 
     /* ******************* */
     /* General Camera data */
@@ -23,8 +30,11 @@ public:
     // The cameraToWorld transformation "places"
     //  the camera in the world
     Matrix4x4 cameraToWorld;
-    // Film to store and handle the actual image
-    const Film &film;
+    // Its inverse (computed once, at construction)
+    Matrix4x4 worldToCamera;
+    // Resolution of the full image (the camera mapping only depends on it)
+    size_t width;
+    size_t height;
     // Aspect (based on the film size)
     double aspect;
 };
@@ -5,6 +5,11 @@ OrtographicCamera::OrtographicCamera(const Matrix4x4 &cameraToWorld_,
     : Camera(cameraToWorld_, film_)
 { }
 
+OrtographicCamera::OrtographicCamera(const Matrix4x4 &cameraToWorld_,
+                  size_t width_, size_t height_)
+    : Camera(cameraToWorld_, width_, height_)
+{ }
+
 
 Vector3D OrtographicCamera::ndcToCameraSpace(const double u, const double v) const
 {
@@ -17,6 +22,14 @@ Vector3D OrtographicCamera::ndcToCameraSpace(const double u, const double v) con
     return Vector3D(x, y, 0);
 }
 
+bool OrtographicCamera::worldToNdc(const Vector3D &p, double &u, double &v) const
+{
+    // Inverse of ndcToCameraSpace(): the depth is irrelevant
+    Vector3D pCamera = worldToCamera.transformPoint(p);
+    u = (pCamera.x / aspect + 1) * 0.5;
+    v = (pCamera.y + 1) * 0.5;
+    return true;
+}
 
 // Input in image space
 Ray OrtographicCamera::generateRay(const double u, const double v) const
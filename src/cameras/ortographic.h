@@ -12,10 +12,13 @@ public:
 
     OrtographicCamera(const Matrix4x4 &cameraToWorld_,
                       const Film &film_ );
+    OrtographicCamera(const Matrix4x4 &cameraToWorld_,
+                      size_t width_, size_t height_);
 
     // Member functions
     virtual Ray generateRay(const double u, const double v) const;
     virtual Vector3D ndcToCameraSpace(const double u, const double v) const;
+    virtual bool worldToNdc(const Vector3D &p, double &u, double &v) const;
 };
 
 #endif // ORTOGRAPHICCAMERA_H
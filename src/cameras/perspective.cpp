@@ -1,11 +1,19 @@
 #include "perspective.h"
 
+#include <cmath>
+
 PerspectiveCamera::PerspectiveCamera(const Matrix4x4 &cameraToWorld_, const double fov_,
             const Film &film_ )
     : Camera(cameraToWorld_, film_),
       fov(fov_)
 { }
 
+PerspectiveCamera::PerspectiveCamera(const Matrix4x4 &cameraToWorld_, const double fov_,
+            size_t width_, size_t height_)
+    : Camera(cameraToWorld_, width_, height_),
+      fov(fov_)
+{ }
+
 Vector3D PerspectiveCamera::ndcToCameraSpace(const double u, const double v) const
 {
     // In the following code, we assume a focal distance fd = 1
@@ -24,6 +32,19 @@ Vector3D PerspectiveCamera::ndcToCameraSpace(const double u, const double v) con
                       1);
 }
 
+bool PerspectiveCamera::worldToNdc(const Vector3D &p, double &u, double &v) const
+{
+    // Project on the image plane (z = 1) and invert ndcToCameraSpace()
+    Vector3D pCamera = worldToCamera.transformPoint(p);
+    if(pCamera.z <= 0)
+        return false;
+
+    double size = 2.0 * std::tan(fov/2);
+    u = (pCamera.x / pCamera.z / aspect + size * 0.5) / size;
+    v = (size * 0.5 - pCamera.y / pCamera.z) / size;
+    return true;
+}
+
 Ray PerspectiveCamera::generateRay(const double u, const double v) const
 {
     // Convert the sample to camera coordinates
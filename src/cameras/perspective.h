@@ -10,10 +10,13 @@ public:
 
     PerspectiveCamera(const Matrix4x4 &cameraToWorld_, const double fov,
                 const Film &film_ );
+    PerspectiveCamera(const Matrix4x4 &cameraToWorld_, const double fov,
+                size_t width_, size_t height_);
 
     // Member functions
     virtual Ray generateRay(const double u, const double v) const;
     virtual Vector3D ndcToCameraSpace(const double u, const double v) const;
+    virtual bool worldToNdc(const Vector3D &p, double &u, double &v) const;
 
     /* Perspective Camera Data */
     double fov; // Radians
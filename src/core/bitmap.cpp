@@ -112,7 +112,42 @@ int BitMap::read(Vector3D** &dataOut, size_t &widthOut, size_t &heightOut, std::
     }
 }
 
-int BitMap::save(Vector3D** &data, const size_t &width, const size_t &height, std::string name)
+int BitMap::readBGR(std::vector<uint8_t> &bgr, size_t &width, size_t &height, std::string name)
+{
+    std::ifstream inputFile;
+    inputFile.open(name+".bmp", std::ios::binary | std::ios::in);
+    if(!inputFile.is_open())
+        return 1;
+
+    // Fields are read from their file offsets, so the result does not
+    // depend on the padding of the header structs
+    char header[54];
+    if(!inputFile.read(header, 54) || header[0] != 'B' || header[1] != 'M')
+        return 2;
+
+    int32_t offbits, fileWidth, fileHeight, compression;
+    int16_t bitCount;
+    memcpy(&offbits,     &header[10], sizeof(offbits));
+    memcpy(&fileWidth,   &header[18], sizeof(fileWidth));
+    memcpy(&fileHeight,  &header[22], sizeof(fileHeight));
+    memcpy(&bitCount,    &header[28], sizeof(bitCount));
+    memcpy(&compression, &header[30], sizeof(compression));
+    if(bitCount != 24 || compression != 0 || fileWidth <= 0 || fileHeight <= 0)
+        return 2;
+
+    width  = (size_t)fileWidth;
+    height = (size_t)fileHeight;
+    size_t stride = (width * 3 + 3) / 4 * 4;
+    bgr.resize(stride * height);
+
+    inputFile.seekg(offbits);
+    if(!inputFile.read(reinterpret_cast<char *>(bgr.data()), bgr.size()))
+        return 2;
+
+    return 0;
+}
+
+int BitMap::save(const std::vector<uint8_t> &bgr, const size_t &width, const size_t &height, std::string name)
 {
     // Create file header
     bmp24_file_header fileHeader;
@@ -120,41 +155,32 @@ int BitMap::save(Vector3D** &data, const size_t &width, const size_t &height, st
     // Create info header
     bmp24_info_header infoHeader(width, height);
 
+    if(bgr.size() != (size_t)infoHeader.size_image)
+    {
+        std::cout << "Problem at BitMap::save() : the pixel buffer holds " << bgr.size()
+                  << " bytes but " << infoHeader.size_image << " were expected" << std::endl;
+        return 2;
+    }
+
     std::ofstream outputFile;
     outputFile.open(name+".bmp", std::ios::binary | std::ios::out);
 
     if(outputFile.is_open())
     {
         // Write the file header
-        outputFile.write(fileHeader.toCharBlock(), 14);
+        char *fileBlock = fileHeader.toCharBlock();
+        outputFile.write(fileBlock, 14);
+        free(fileBlock);
 
         // Write the info header
-        outputFile.write(infoHeader.toCharBlock(), 40);
-
-        int extra_bytes = (4 - (infoHeader.width * 3) % 4) % 4;
-        void* padd = (void*)malloc(extra_bytes);
-
-        // Store the image in the BMP format (bottom-up, i.e.,
-        //  first row stores is the lowermost one)
-        for(size_t row = height; row > 0; row--)
-        {
-            for(size_t col = 0; col < width; col++)
-            {
-                // Get the pixel value
-                Vector3D p = data[row-1][col];
-                uint8_t red   = (uint8_t)(std::min(p.x, 1.0) * 255);
-                uint8_t green = (uint8_t)(std::min(p.y, 1.0) * 255);
-                uint8_t blue  = (uint8_t)(std::min(p.z, 1.0) * 255);
-
-                // Write the pixel value
-                outputFile.write(reinterpret_cast<const char *>(&blue),  1); // blue
-                outputFile.write(reinterpret_cast<const char *>(&green), 1); // green
-                outputFile.write(reinterpret_cast<const char *>(&red),   1); // red
+        char *infoBlock = infoHeader.toCharBlock();
+        outputFile.write(infoBlock, 40);
+        free(infoBlock);
 
-            }
-            // Padd the rest of the row;
-            outputFile.write(reinterpret_cast<const char *>(padd), extra_bytes);
-        }
+        // The buffer is already in the BMP layout (bottom-up, i.e., first
+        //  row stored is the lowermost one, and padded), so a single write
+        //  is enough
+        outputFile.write(reinterpret_cast<const char *>(bgr.data()), bgr.size());
 
         outputFile.close();
         return 0;
@@ -163,7 +189,7 @@ int BitMap::save(Vector3D** &data, const size_t &width, const size_t &height, st
     {
         // Problem opening file
         std::cout << "Problem at BitMap::save() : Could not open file \""
-                  << "example.bmp" << "\"" << std::endl;
+                  << name << ".bmp" << "\"" << std::endl;
         return 1;
     }
 }
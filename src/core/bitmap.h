@@ -1,6 +1,12 @@
 #ifndef BITMAP_H
 #define BITMAP_H
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
 #include "vector3d.h"
 //#include <iostream>
 
@@ -11,10 +17,10 @@ struct bmp24_file_header
 {
     char      magic1;    // 'B'
     char      magic2;    // 'M'
-    long      size;      // 0
-    short int reserved1; // 0
-    short int reserved2; // 0
-    long      offbits;   // 14 + 40
+    int32_t   size;      // 0
+    int16_t   reserved1; // 0
+    int16_t   reserved2; // 0
+    int32_t   offbits;   // 14 + 40
                          // (info header size) + (fileheader size)
 
     /**
@@ -50,17 +56,19 @@ struct bmp24_file_header
  */
 struct bmp24_info_header
 {
-    long	  size;             // 40 (size of the info header block in bytes)
-    long	  width;            // img.width
-    long	  height;           // img.height
-    short int planes;           // 1
-    short int bit_count;        // 24
-    long	  compression;      // 0
-    long      size_image;       // (img.width * 3 + extra_bytes) * img.height
-    long	  x_pels_per_meter; // 2952
-    long	  y_pels_per_meter; // 2952
-    long	  clr_used;         // 0
-    long	  clr_important;    // 0
+    // Fixed-size fields, so that the in-memory layout matches the 40 bytes
+    // of the file block on every platform (long is 8 bytes on LP64)
+    int32_t   size;             // 40 (size of the info header block in bytes)
+    int32_t   width;            // img.width
+    int32_t   height;           // img.height
+    int16_t   planes;           // 1
+    int16_t   bit_count;        // 24
+    int32_t   compression;      // 0
+    int32_t   size_image;       // (img.width * 3 + extra_bytes) * img.height
+    int32_t   x_pels_per_meter; // 2952
+    int32_t   y_pels_per_meter; // 2952
+    int32_t   clr_used;         // 0
+    int32_t   clr_important;    // 0
 
     /**
      * @brief bmp24_info_header
@@ -72,8 +80,8 @@ struct bmp24_info_header
                                    y_pels_per_meter(2952), clr_used(0),
                                    clr_important(0)
     {
-        width  = (long) width_;
-        height = (long) height_;
+        width  = (int32_t) width_;
+        height = (int32_t) height_;
 
         int extra_bytes = (4 - (width * 3) % 4) % 4;
         size_image = (width * 3 + extra_bytes) * height;
@@ -83,17 +91,17 @@ struct bmp24_info_header
     {
         char *block = (char *)malloc(40);
 
-        memcpy((void*)&block[0],  &size,   sizeof(long));
-        memcpy((void*)&block[4],  &width,  sizeof(long));
-        memcpy((void*)&block[8],  &height, sizeof(long));
-        memcpy((void*)&block[12], &planes, sizeof(short int));
-        memcpy((void*)&block[14], &bit_count,   sizeof(short int));
-        memcpy((void*)&block[16], &compression, sizeof(long));
-        memcpy((void*)&block[20], &size_image,  sizeof(long));
-        memcpy((void*)&block[24], &x_pels_per_meter, sizeof(long));
-        memcpy((void*)&block[28], &y_pels_per_meter, sizeof(long));
-        memcpy((void*)&block[32], &clr_used,         sizeof(long));
-        memcpy((void*)&block[36], &clr_important,    sizeof(long));
+        memcpy((void*)&block[0],  &size,   sizeof(size));
+        memcpy((void*)&block[4],  &width,  sizeof(width));
+        memcpy((void*)&block[8],  &height, sizeof(height));
+        memcpy((void*)&block[12], &planes, sizeof(planes));
+        memcpy((void*)&block[14], &bit_count,   sizeof(bit_count));
+        memcpy((void*)&block[16], &compression, sizeof(compression));
+        memcpy((void*)&block[20], &size_image,  sizeof(size_image));
+        memcpy((void*)&block[24], &x_pels_per_meter, sizeof(x_pels_per_meter));
+        memcpy((void*)&block[28], &y_pels_per_meter, sizeof(y_pels_per_meter));
+        memcpy((void*)&block[32], &clr_used,         sizeof(clr_used));
+        memcpy((void*)&block[36], &clr_important,    sizeof(clr_important));
 
         return block;
     }
@@ -105,8 +113,14 @@ class BitMap
 public:
     BitMap();
 
-    static int save(Vector3D** &data, const size_t &width, const size_t &height,std::string name);
+    // Writes an already quantized image (see ToneMapper::toBGR8), stored
+    // bottom-up with rows padded to 4 bytes
+    static int save(const std::vector<uint8_t> &bgr, const size_t &width, const size_t &height, std::string name);
     static int read(Vector3D** &dataOut, size_t &width, size_t &height, std::string &fileName);
+    // Reads "<name>.bmp" (24 bits, bottom-up) into the layout written by
+    // save(), without conversion. Silent: returns 0 on success, 1 if the
+    // file cannot be opened and 2 if it is not in that format
+    static int readBGR(std::vector<uint8_t> &bgr, size_t &width, size_t &height, std::string name);
 };
 
 #endif // BITMAP_H
@@ -0,0 +1,45 @@
+#include "bounds3d.h"
+
+#include <algorithm>
+#include <cmath>
+
+Bounds3D::Bounds3D()
+    : pMin(INFINITY, INFINITY, INFINITY), pMax(-INFINITY, -INFINITY, -INFINITY)
+{ }
+
+Bounds3D::Bounds3D(const Vector3D &p1, const Vector3D &p2)
+    : pMin(std::min(p1.x, p2.x), std::min(p1.y, p2.y), std::min(p1.z, p2.z)),
+      pMax(std::max(p1.x, p2.x), std::max(p1.y, p2.y), std::max(p1.z, p2.z))
+{ }
+
+bool Bounds3D::isEmpty() const
+{
+    return pMin.x > pMax.x || pMin.y > pMax.y || pMin.z > pMax.z;
+}
+
+void Bounds3D::include(const Vector3D &p)
+{
+    pMin = Vector3D(std::min(pMin.x, p.x), std::min(pMin.y, p.y), std::min(pMin.z, p.z));
+    pMax = Vector3D(std::max(pMax.x, p.x), std::max(pMax.y, p.y), std::max(pMax.z, p.z));
+}
+
+Vector3D Bounds3D::getCorner(int i) const
+{
+    return Vector3D((i & 1) ? pMax.x : pMin.x,
+                    (i & 2) ? pMax.y : pMin.y,
+                    (i & 4) ? pMax.z : pMin.z);
+}
+
+Bounds3D Bounds3D::transformed(const Matrix4x4 &t) const
+{
+    Bounds3D result;
+    if(isEmpty())
+        return result;
+
+    // The transformed box contains the 8 transformed corners
+    for(int i = 0; i < 8; i++)
+    {
+        result.include(t.transformPoint(getCorner(i)));
+    }
+    return result;
+}
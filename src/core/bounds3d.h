@@ -0,0 +1,34 @@
+#ifndef BOUNDS3D_H
+#define BOUNDS3D_H
+
+#include "vector3d.h"
+#include "matrix4x4.h"
+
+/**
+ * @brief The Bounds3D class
+ *
+ * Axis-aligned bounding box [pMin, pMax]. A default-constructed box is
+ * empty (pMin > pMax), so that growing it with include() gives the bounds
+ * of the included points.
+ */
+class Bounds3D
+{
+public:
+    // Constructors
+    Bounds3D();
+    Bounds3D(const Vector3D &p1, const Vector3D &p2);
+
+    // Member functions
+    bool isEmpty() const;
+    void include(const Vector3D &p);
+    // Corner i in [0, 8): bit 0 selects the x of pMax, bit 1 y, bit 2 z
+    Vector3D getCorner(int i) const;
+    // Bounds of the box after applying the transform t to it
+    Bounds3D transformed(const Matrix4x4 &t) const;
+
+    // Bounds public data
+    Vector3D pMin;
+    Vector3D pMax;
+};
+
+#endif // BOUNDS3D_H
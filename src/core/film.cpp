@@ -1,4 +1,5 @@
 #include "film.h"
+#include "tonemapper.h"
 
 /**
  * @brief Film::Film
@@ -46,7 +47,17 @@ Vector3D Film::getPixelValue(size_t w, size_t h) const
     return data[h][w];
 }
 
-void Film::setPixelValue(size_t w, size_t h, Vector3D &value)
+const Vector3D *Film::getRow(size_t h) const
+{
+    return data[h];
+}
+
+Vector3D *Film::getRow(size_t h)
+{
+    return data[h];
+}
+
+void Film::setPixelValue(size_t w, size_t h, const Vector3D &value)
 {
     data[h][w] = value;
 }
@@ -64,7 +75,16 @@ void Film::clearData()
     }
 }
 
-int Film::save(std::string name)
+int Film::save(std::string name) const
 {
-    return BitMap::save(data, width, height, name);
+    return save(name, ToneMapSettings());
+}
+
+int Film::save(std::string name, const ToneMapSettings &settings) const
+{
+    // Quantize the whole image first, then hand the packed rows to the writer
+    std::vector<uint8_t> bgr;
+    ToneMapper(settings).toBGR8(*this, bgr, 4, true);
+
+    return BitMap::save(bgr, width, height, name);
 }
@@ -4,6 +4,8 @@
 #include "vector3d.h"
 #include "bitmap.h"
 
+struct ToneMapSettings;
+
 #include <iostream>
 
 
@@ -24,12 +26,15 @@ public:
     size_t getWidth() const;
     size_t getHeight() const;
     Vector3D getPixelValue(size_t w, size_t h) const;
+    const Vector3D *getRow(size_t h) const;
+    Vector3D *getRow(size_t h);
 
     // Setters
-    void setPixelValue(size_t w, size_t h, Vector3D &value);
+    void setPixelValue(size_t w, size_t h, const Vector3D &value);
 
     // Other functions
-    int save(std::string name);
+    int save(std::string name) const;
+    int save(std::string name, const ToneMapSettings &settings) const;
     void clearData();
 
 private:
@@ -0,0 +1,89 @@
+#include "heapcounter.h"
+
+#ifdef RTIS_COUNT_HEAP
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> heapAllocations(0);
+
+// GCC flags free() on memory from operator new once these are inlined,
+// although here both ends are malloc/free
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size > 0 ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+bool HeapCounter::isEnabled()
+{
+    return true;
+}
+
+uint64_t HeapCounter::getAllocations()
+{
+    return heapAllocations.load();
+}
+
+#else
+
+bool HeapCounter::isEnabled()
+{
+    return false;
+}
+
+uint64_t HeapCounter::getAllocations()
+{
+    return 0;
+}
+
+#endif // RTIS_COUNT_HEAP
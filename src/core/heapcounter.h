@@ -0,0 +1,24 @@
+#ifndef HEAPCOUNTER_H
+#define HEAPCOUNTER_H
+
+#include <stdint.h>
+
+/**
+ * @brief The HeapCounter class
+ *
+ * Number of heap allocations made by the program, so that the testers can
+ * check what a piece of code really allocates (the arena and pool counters
+ * only see their own blocks). Counting replaces the global operator new,
+ * so it is only compiled into test builds, with RTIS_COUNT_HEAP defined
+ * (qmake CONFIG+=heapcount); the regular binary keeps the standard
+ * allocator and isEnabled() returns false.
+ */
+class HeapCounter
+{
+public:
+    static bool isEnabled();
+    // Allocations since the start of the program (0 if not enabled)
+    static uint64_t getAllocations();
+};
+
+#endif // HEAPCOUNTER_H
@@ -0,0 +1,9 @@
+#include "intersection.h"
+
+Intersection::Intersection() : shape(nullptr)
+{ }
+
+Intersection::Intersection(const Vector3D &itsPoint_, const Vector3D &normal_,
+                           const Shape *shape_)
+    : itsPoint(itsPoint_), normal(normal_), shape(shape_)
+{ }
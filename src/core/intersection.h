@@ -0,0 +1,27 @@
+#ifndef INTERSECTION_H
+#define INTERSECTION_H
+
+#include "vector3d.h"
+
+class Shape;
+
+/**
+ * @brief The Intersection class
+ *
+ * Closest-hit record filled by Shape::rayIntersect()
+ */
+class Intersection
+{
+public:
+    // Constructors
+    Intersection();
+    Intersection(const Vector3D &itsPoint_, const Vector3D &normal_,
+                 const Shape *shape_);
+
+    // Intersection public data (world coordinates)
+    Vector3D itsPoint;   // Hit point
+    Vector3D normal;     // Unit surface normal (pointing outwards)
+    const Shape *shape;  // Shape that was hit
+};
+
+#endif // INTERSECTION_H
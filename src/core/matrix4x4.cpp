@@ -1,130 +1,290 @@
 #include "matrix4x4.h"
 
-Matrix4x4::Matrix4x4()
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+
+#ifdef RTIS_AVX2
+#include <immintrin.h>
+#endif
+
+// Scalar kernels, shared by Matrix4x4 and Matrix4x4f. They also finish the
+// lanes left over by the vector kernels. Every path does its operations in
+// the order of operator*, transformPoint() and transformVector(), so all of
+// them give the same bits (unless the compiler is allowed to fuse
+// multiply-adds in the scalar code, e.g., with -march=native)
+template <typename T>
+static void multiplyScalar(const T (&a)[4][4], const T (&b)[4][4], T (&target)[4][4])
 {
+    T result[4][4];
     for(size_t lin=0; lin<4; lin++)
     {
-        for(size_t col=0; col<4; col++ )
+        for(size_t col=0; col<4; col++)
         {
-            if(lin == col)
-            {
-                data[lin][col] = 1;
-            } else
-            {
-                data[lin][col] = 0;
-            }
+            result[lin][col] = a[lin][0] * b[0][col] + a[lin][1] * b[1][col] +
+                               a[lin][2] * b[2][col] + a[lin][3] * b[3][col];
         }
     }
+    memcpy(target, result, sizeof(result));
 }
 
-Matrix4x4::Matrix4x4(double data_[4][4])
+template <typename T>
+static void transposeScalar(const T (&m)[4][4], T (&target)[4][4])
 {
+    T result[4][4];
     for(size_t lin=0; lin<4; lin++)
     {
-        for(size_t col=0; col<4; col++ )
+        for(size_t col=0; col<4; col++)
         {
-            data[lin][col] = data_[lin][col];
+            result[lin][col] = m[col][lin];
         }
     }
+    memcpy(target, result, sizeof(result));
 }
 
-Matrix4x4::Matrix4x4( double a00, double a01, double a02, double a03,
-           double a10, double a11, double a12, double a13,
-           double a20, double a21, double a22, double a23,
-           double a30, double a31, double a32, double a33)
+// Points (isPoint) or vectors [begin, n)
+template <bool isPoint, typename T>
+static void transformScalar(const T (&m)[4][4], const T *x, const T *y, const T *z,
+                            size_t begin, size_t n, T *outX, T *outY, T *outZ)
 {
-    data[0][0] = a00; data[0][1] = a01; data[0][2] = a02; data[0][3] = a03;
-    data[1][0] = a10; data[1][1] = a11; data[1][2] = a12; data[1][3] = a13;
-    data[2][0] = a20; data[2][1] = a21; data[2][2] = a22; data[2][3] = a23;
-    data[3][0] = a30; data[3][1] = a31; data[3][2] = a32; data[3][3] = a33;
+    for(size_t i = begin; i < n; i++)
+    {
+        T px = x[i], py = y[i], pz = z[i];
+        T tx = m[0][0] * px + m[0][1] * py + m[0][2] * pz;
+        T ty = m[1][0] * px + m[1][1] * py + m[1][2] * pz;
+        T tz = m[2][0] * px + m[2][1] * py + m[2][2] * pz;
+        if(isPoint)
+        {
+            tx += m[0][3];
+            ty += m[1][3];
+            tz += m[2][3];
+            T w = m[3][0] * px + m[3][1] * py + m[3][2] * pz + m[3][3];
+            if(w != 1)
+            {
+                tx /= w;
+                ty /= w;
+                tz /= w;
+            }
+        }
+        outX[i] = tx;
+        outY[i] = ty;
+        outZ[i] = tz;
+    }
 }
 
-Matrix4x4 Matrix4x4::operator+(const Matrix4x4 &m) const
-{
-    Matrix4x4 sum;
+#ifdef RTIS_AVX2
+
+// AVX2 kernels: 4 doubles or 8 floats per instruction. The batch
+// transforms return the number of entries done (a multiple of the lanes)
 
+RTIS_AVX2_TARGET
+static void multiplyAvx2(const double (&a)[4][4], const double (&b)[4][4], double (&target)[4][4])
+{
+    __m256d b0 = _mm256_loadu_pd(b[0]), b1 = _mm256_loadu_pd(b[1]);
+    __m256d b2 = _mm256_loadu_pd(b[2]), b3 = _mm256_loadu_pd(b[3]);
+    __m256d rows[4];
     for(size_t lin=0; lin<4; lin++)
     {
-        for(size_t col=0; col<4; col++)
-        {
-            sum.data[lin][col] = data[lin][col] + m.data[lin][col];
-        }
+        // Row lin of the result is sum_k a[lin][k] * (row k of b)
+        __m256d r = _mm256_mul_pd(_mm256_set1_pd(a[lin][0]), b0);
+        r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_set1_pd(a[lin][1]), b1));
+        r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_set1_pd(a[lin][2]), b2));
+        rows[lin] = _mm256_add_pd(r, _mm256_mul_pd(_mm256_set1_pd(a[lin][3]), b3));
     }
-
-    return sum;
+    for(size_t lin=0; lin<4; lin++)
+        _mm256_storeu_pd(target[lin], rows[lin]);
 }
 
-Matrix4x4 Matrix4x4::operator-(const Matrix4x4 &m) const
+RTIS_AVX2_TARGET
+static void multiplyAvx2(const float (&a)[4][4], const float (&b)[4][4], float (&target)[4][4])
 {
-    Matrix4x4 sum;
-
+    __m128 b0 = _mm_loadu_ps(b[0]), b1 = _mm_loadu_ps(b[1]);
+    __m128 b2 = _mm_loadu_ps(b[2]), b3 = _mm_loadu_ps(b[3]);
+    __m128 rows[4];
     for(size_t lin=0; lin<4; lin++)
     {
-        for(size_t col=0; col<4; col++)
-        {
-            sum.data[lin][col] = data[lin][col] - m.data[lin][col];
-        }
+        __m128 r = _mm_mul_ps(_mm_set1_ps(a[lin][0]), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[lin][1]), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[lin][2]), b2));
+        rows[lin] = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a[lin][3]), b3));
     }
+    for(size_t lin=0; lin<4; lin++)
+        _mm_storeu_ps(target[lin], rows[lin]);
+}
 
-    return sum;
+RTIS_AVX2_TARGET
+static void transposeAvx2(const double (&m)[4][4], double (&target)[4][4])
+{
+    __m256d r0 = _mm256_loadu_pd(m[0]), r1 = _mm256_loadu_pd(m[1]);
+    __m256d r2 = _mm256_loadu_pd(m[2]), r3 = _mm256_loadu_pd(m[3]);
+    // Pairs (r0[k], r1[k]) and (r2[k], r3[k]), then their 128-bit halves
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1), t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3), t3 = _mm256_unpackhi_pd(r2, r3);
+    _mm256_storeu_pd(target[0], _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(target[1], _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(target[2], _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(target[3], _mm256_permute2f128_pd(t1, t3, 0x31));
 }
 
-// Product between two matrices 4x4
-// res(lin, col) = inner product of this.data(lin,:)
-//                  with m.data(:,col)
-// Given the current matrix m1 and a second matrix m2, returns a matrix
-// res which, applied to an object (e.g., a point p) is equal to m1(m2(p))
-Matrix4x4 Matrix4x4::operator*(const Matrix4x4 &m) const
+RTIS_AVX2_TARGET
+static void transposeAvx2(const float (&m)[4][4], float (&target)[4][4])
 {
-    Matrix4x4 res;
+    __m128 r0 = _mm_loadu_ps(m[0]), r1 = _mm_loadu_ps(m[1]);
+    __m128 r2 = _mm_loadu_ps(m[2]), r3 = _mm_loadu_ps(m[3]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(target[0], r0);
+    _mm_storeu_ps(target[1], r1);
+    _mm_storeu_ps(target[2], r2);
+    _mm_storeu_ps(target[3], r3);
+}
 
+template <bool isPoint>
+RTIS_AVX2_TARGET
+static size_t transformAvx2(const double (&m)[4][4], const double *x, const double *y,
+                            const double *z, size_t n, double *outX, double *outY, double *outZ)
+{
+    __m256d c[4][4];
     for(size_t lin=0; lin<4; lin++)
-    {
         for(size_t col=0; col<4; col++)
+            c[lin][col] = _mm256_set1_pd(m[lin][col]);
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d px = _mm256_loadu_pd(x + i), py = _mm256_loadu_pd(y + i), pz = _mm256_loadu_pd(z + i);
+        __m256d t[3];
+        for(size_t lin=0; lin<3; lin++)
+        {
+            t[lin] = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c[lin][0], px),
+                                                 _mm256_mul_pd(c[lin][1], py)),
+                                   _mm256_mul_pd(c[lin][2], pz));
+        }
+        if(isPoint)
         {
-            res.data[lin][col] = data[lin][0] * m.data[0][col] +
-                                 data[lin][1] * m.data[1][col] +
-                                 data[lin][2] * m.data[2][col] +
-                                 data[lin][3] * m.data[3][col];
+            __m256d w = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(c[3][0], px),
+                                                    _mm256_mul_pd(c[3][1], py)),
+                                      _mm256_mul_pd(c[3][2], pz));
+            w = _mm256_add_pd(w, c[3][3]);
+            __m256d project = _mm256_cmp_pd(w, one, _CMP_NEQ_UQ);
+            for(size_t lin=0; lin<3; lin++)
+            {
+                t[lin] = _mm256_add_pd(t[lin], c[lin][3]);
+                t[lin] = _mm256_blendv_pd(t[lin], _mm256_div_pd(t[lin], w), project);
+            }
         }
+        _mm256_storeu_pd(outX + i, t[0]);
+        _mm256_storeu_pd(outY + i, t[1]);
+        _mm256_storeu_pd(outZ + i, t[2]);
     }
-    return res;
+    return i;
 }
 
-Matrix4x4 Matrix4x4::operator*(const double a) const
+template <bool isPoint>
+RTIS_AVX2_TARGET
+static size_t transformAvx2(const float (&m)[4][4], const float *x, const float *y,
+                            const float *z, size_t n, float *outX, float *outY, float *outZ)
 {
-    Matrix4x4 res;
-
+    __m256 c[4][4];
     for(size_t lin=0; lin<4; lin++)
-    {
         for(size_t col=0; col<4; col++)
+            c[lin][col] = _mm256_set1_ps(m[lin][col]);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+        __m256 t[3];
+        for(size_t lin=0; lin<3; lin++)
         {
-            res.data[lin][col] = data[lin][col]*a;
+            t[lin] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[lin][0], px),
+                                                 _mm256_mul_ps(c[lin][1], py)),
+                                   _mm256_mul_ps(c[lin][2], pz));
+        }
+        if(isPoint)
+        {
+            __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c[3][0], px),
+                                                   _mm256_mul_ps(c[3][1], py)),
+                                     _mm256_mul_ps(c[3][2], pz));
+            w = _mm256_add_ps(w, c[3][3]);
+            __m256 project = _mm256_cmp_ps(w, one, _CMP_NEQ_UQ);
+            for(size_t lin=0; lin<3; lin++)
+            {
+                t[lin] = _mm256_add_ps(t[lin], c[lin][3]);
+                t[lin] = _mm256_blendv_ps(t[lin], _mm256_div_ps(t[lin], w), project);
+            }
         }
+        _mm256_storeu_ps(outX + i, t[0]);
+        _mm256_storeu_ps(outY + i, t[1]);
+        _mm256_storeu_ps(outZ + i, t[2]);
     }
-    return res;
+    return i;
 }
 
-// CHANGE THE TEXT BELOW
-// This operator assumes that Vector3D are implicitly represented
-// through homogeneous coordinates [vx, vy, vz, 0]
-Vector3D Matrix4x4::transformVector(const Vector3D &v) const
+template <typename M>
+RTIS_AVX2_TARGET
+static void multiplyBatchAvx2(const M *a, const M *b, size_t n, M *target)
 {
-    double xTransformed, yTransformed, zTransformed;
+    for(size_t i = 0; i < n; i++)
+        multiplyAvx2(a[i].data, b[i].data, target[i].data);
+}
 
-    xTransformed = data[0][0] * v.x +
-                   data[0][1] * v.y +
-                   data[0][2] * v.z;
+#endif // RTIS_AVX2
 
-    yTransformed = data[1][0] * v.x +
-                   data[1][1] * v.y +
-                   data[1][2] * v.z;
+// Vector kernel when available, then the scalar one for the rest
+template <bool isPoint, typename T>
+static void transformBatch(const T (&m)[4][4], const T *x, const T *y, const T *z, size_t n,
+                           T *outX, T *outY, T *outZ)
+{
+    size_t done = 0;
+#ifdef RTIS_AVX2
+    if(Simd::useAvx2())
+        done = transformAvx2<isPoint>(m, x, y, z, n, outX, outY, outZ);
+#endif
+    transformScalar<isPoint>(m, x, y, z, done, n, outX, outY, outZ);
+}
 
-    zTransformed = data[2][0] * v.x +
-                   data[2][1] * v.y +
-                   data[2][2] * v.z;
+template <typename T>
+static void multiplyDispatch(const T (&a)[4][4], const T (&b)[4][4], T (&target)[4][4])
+{
+#ifdef RTIS_AVX2
+    if(Simd::useAvx2())
+    {
+        multiplyAvx2(a, b, target);
+        return;
+    }
+#endif
+    multiplyScalar(a, b, target);
+}
 
-    return Vector3D(xTransformed, yTransformed, zTransformed);
+// Batch of products; the path is chosen once for the whole batch
+template <typename M>
+static void multiplyBatch(const M *a, const M *b, size_t n, M *target)
+{
+#ifdef RTIS_AVX2
+    if(Simd::useAvx2())
+    {
+        multiplyBatchAvx2(a, b, n, target);
+        return;
+    }
+#endif
+    for(size_t i = 0; i < n; i++)
+        multiplyScalar(a[i].data, b[i].data, target[i].data);
+}
+
+template <typename T>
+static void transposeDispatch(const T (&m)[4][4], T (&target)[4][4])
+{
+#ifdef RTIS_AVX2
+    if(Simd::useAvx2())
+    {
+        transposeAvx2(m, target);
+        return;
+    }
+#endif
+    transposeScalar(m, target);
 }
 
 // This operator assumes that Point3D are implicitly represented
@@ -273,68 +433,119 @@ void Matrix4x4::setToZeros()
 }
 
 void Matrix4x4::transpose(Matrix4x4 &target) const
+{
+    transposeDispatch(data, target.data);
+}
+
+void Matrix4x4::transformPoints(const double *x, const double *y, const double *z, size_t n,
+                                double *outX, double *outY, double *outZ) const
+{
+    transformBatch<true>(data, x, y, z, n, outX, outY, outZ);
+}
+
+void Matrix4x4::transformVectors(const double *x, const double *y, const double *z, size_t n,
+                                 double *outX, double *outY, double *outZ) const
+{
+    transformBatch<false>(data, x, y, z, n, outX, outY, outZ);
+}
+
+void Matrix4x4::transformNormals(const double *x, const double *y, const double *z, size_t n,
+                                 double *outX, double *outY, double *outZ) const
+{
+    Matrix4x4 t = transposed();
+    transformBatch<false>(t.data, x, y, z, n, outX, outY, outZ);
+}
+
+// static method implementation
+Matrix4x4 Matrix4x4::rotate(const double angleInRad, const Vector3D &axis)
+{
+    // The rotation itself is the constexpr overload
+    return rotate(std::cos(angleInRad), std::sin(angleInRad), axis.normalized());
+}
+
+void Matrix4x4::multiply(const Matrix4x4 &a, const Matrix4x4 &b, Matrix4x4 &target)
+{
+    multiplyDispatch(a.data, b.data, target.data);
+}
+
+void Matrix4x4::multiply(const Matrix4x4 *a, const Matrix4x4 *b, size_t n, Matrix4x4 *target)
+{
+    multiplyBatch(a, b, n, target);
+}
+
+ostream& operator<<(ostream &out, const Matrix4x4 &m)
+{
+
+    out << m.toString();
+    return out;
+}
+
+Matrix4x4f::Matrix4x4f()
 {
     for(size_t lin=0; lin<4; lin++)
     {
         for(size_t col=0; col<4; col++)
         {
-            target.data[lin][col] = data[col][lin];
+            data[lin][col] = lin == col ? 1.0f : 0.0f;
         }
     }
 }
 
-// static method implementation
-Matrix4x4 Matrix4x4::translate(const Vector3D &delta)
+Matrix4x4f::Matrix4x4f(const Matrix4x4 &m)
 {
-    Matrix4x4 m(1, 0, 0, delta.x,
-                0, 1, 0, delta.y,
-                0, 0, 1, delta.z,
-                0, 0, 0, 1);
+    for(size_t lin=0; lin<4; lin++)
+    {
+        for(size_t col=0; col<4; col++)
+        {
+            data[lin][col] = (float)m.data[lin][col];
+        }
+    }
+}
 
+Matrix4x4 Matrix4x4f::toMatrix4x4() const
+{
+    Matrix4x4 m;
+    for(size_t lin=0; lin<4; lin++)
+    {
+        for(size_t col=0; col<4; col++)
+        {
+            m.data[lin][col] = data[lin][col];
+        }
+    }
     return m;
 }
 
-// static method implementation
-Matrix4x4 Matrix4x4::scale(const Vector3D &scalingVector)
+void Matrix4x4f::transpose(Matrix4x4f &target) const
 {
-    Matrix4x4 m(scalingVector.x, 0, 0, 0,
-                0, scalingVector.y, 0, 0,
-                0, 0, scalingVector.z, 0,
-                0, 0, 0, 1);
-    return m;
+    transposeDispatch(data, target.data);
 }
 
-// static method implementation
-Matrix4x4 Matrix4x4::rotate(const double angleInRad, const Vector3D &axis)
+void Matrix4x4f::transformPoints(const float *x, const float *y, const float *z, size_t n,
+                                 float *outX, float *outY, float *outZ) const
 {
-    Vector3D a = axis.normalized();
-    double s = std::sin(angleInRad);
-    double c = std::cos(angleInRad);
-    double m[4][4];
-    m[0][0] = a.x * a.x + (1.0 - a.x * a.x) * c;
-    m[0][1] = a.x * a.y * (1.0 - c) - a.z * s;
-    m[0][2] = a.x * a.z * (1.0 - c) + a.y * s;
-    m[0][3] = 0;
-    m[1][0] = a.x * a.y * (1.0 - c) + a.z * s;
-    m[1][1] = a.y * a.y + (1.0 - a.y * a.y) * c;
-    m[1][2] = a.y * a.z * (1.0 - c) - a.x * s;
-    m[1][3] = 0;
-    m[2][0] = a.x * a.z * (1.0 - c) - a.y * s;
-    m[2][1] = a.y * a.z * (1.0 - c) + a.x * s;
-    m[2][2] = a.z * a.z + (1.0 - a.z * a.z) * c;
-    m[2][3] = 0;
-    m[3][0] = 0;
-    m[3][1] = 0;
-    m[3][2] = 0;
-    m[3][3] = 1;
-    Matrix4x4 mat(m);
-
-    return mat;
+    transformBatch<true>(data, x, y, z, n, outX, outY, outZ);
 }
 
-ostream& operator<<(ostream &out, const Matrix4x4 &m)
+void Matrix4x4f::transformVectors(const float *x, const float *y, const float *z, size_t n,
+                                  float *outX, float *outY, float *outZ) const
 {
+    transformBatch<false>(data, x, y, z, n, outX, outY, outZ);
+}
 
-    out << m.toString();
-    return out;
+void Matrix4x4f::transformNormals(const float *x, const float *y, const float *z, size_t n,
+                                  float *outX, float *outY, float *outZ) const
+{
+    Matrix4x4f t;
+    transpose(t);
+    transformBatch<false>(t.data, x, y, z, n, outX, outY, outZ);
+}
+
+void Matrix4x4f::multiply(const Matrix4x4f &a, const Matrix4x4f &b, Matrix4x4f &target)
+{
+    multiplyDispatch(a.data, b.data, target.data);
+}
+
+void Matrix4x4f::multiply(const Matrix4x4f *a, const Matrix4x4f *b, size_t n, Matrix4x4f *target)
+{
+    multiplyBatch(a, b, n, target);
 }
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <type_traits>
 
 #include "vector3d.h"
 #include "ray.h"
@@ -12,29 +13,33 @@ using std::ostream;
 using std::string;
 
 // Matrix stored in row-major form
+// Like Vector3D, it is trivially copyable and everything that does not need
+// the standard math library (sin, cos, sqrt) or a loop with side effects is
+// constexpr: fixed transforms such as translate(v) * scale(s) are folded
+// at compile time
 struct Matrix4x4
 {
     // Constructors
-    Matrix4x4();
-    Matrix4x4(double data_[4][4]);
-    Matrix4x4( double a00, double a01, double a02, double a03,
-               double a10, double a11, double a12, double a13,
-               double a20, double a21, double a22, double a23,
-               double a30, double a31, double a32, double a33);
+    constexpr Matrix4x4();
+    constexpr Matrix4x4(const double data_[4][4]);
+    constexpr Matrix4x4( double a00, double a01, double a02, double a03,
+                         double a10, double a11, double a12, double a13,
+                         double a20, double a21, double a22, double a23,
+                         double a30, double a31, double a32, double a33);
 
     //Matrix4x4(Matrix4x4);
 
     // Member operators overload
-    Matrix4x4 operator+(const Matrix4x4 &m) const;
-    Matrix4x4 operator-(const Matrix4x4 &m) const;
-    Matrix4x4 operator*(const Matrix4x4 &m) const;
-    Matrix4x4 operator*(const double     a) const;
+    constexpr Matrix4x4 operator+(const Matrix4x4 &m) const;
+    constexpr Matrix4x4 operator-(const Matrix4x4 &m) const;
+    constexpr Matrix4x4 operator*(const Matrix4x4 &m) const;
+    constexpr Matrix4x4 operator*(const double     a) const;
     /*Matrix4x4& operator+=(const Matrix4x4 &m);
     Matrix4x4& operator-=(const Matrix4x4 &m);
     Matrix4x4& operator*=(const Matrix4x4 &m);*/
 
     // Member functions (Transformations)
-    Vector3D transformVector(const Vector3D &v) const;
+    constexpr Vector3D transformVector(const Vector3D &v) const;
     Vector3D transformPoint(const Vector3D &p) const;
     Ray      transformRay(const Ray &r) const;
 
@@ -42,20 +47,196 @@ struct Matrix4x4
     std::string toString() const;
     bool inverse(Matrix4x4 &target) const;
     void setToZeros();
+    // Run-time transpose, on the vector path when available
     void transpose(Matrix4x4 &target) const;
+    constexpr Matrix4x4 transposed() const;
     // determinant ?
 
+    // Batch transforms of n points, vectors or normals stored as structure
+    // of arrays (x[i], y[i], z[i]); the outputs may be the inputs. Results
+    // are those of transformPoint() / transformVector(), bit by bit.
+    // Normals are multiplied by the transpose of the matrix, so that
+    // worldToObject.transformNormals() takes object-space normals to world
+    // space (see Sphere::rayIntersect())
+    void transformPoints(const double *x, const double *y, const double *z, size_t n,
+                         double *outX, double *outY, double *outZ) const;
+    void transformVectors(const double *x, const double *y, const double *z, size_t n,
+                          double *outX, double *outY, double *outZ) const;
+    void transformNormals(const double *x, const double *y, const double *z, size_t n,
+                          double *outX, double *outY, double *outZ) const;
+
     // Static methods
-    static Matrix4x4 translate(const Vector3D &delta);
-    static Matrix4x4 scale(const Vector3D &scalingVector);
+    static constexpr Matrix4x4 translate(const Vector3D &delta);
+    static constexpr Matrix4x4 scale(const Vector3D &scalingVector);
     static Matrix4x4 rotate(const double angleInRad, const Vector3D &axis);
-
+    // Same rotation from the cosine and sine of the angle and a unit-length
+    // axis, usable in constant expressions
+    static constexpr Matrix4x4 rotate(const double c, const double s, const Vector3D &a);
+    // Run-time product a * b (same result as operator*), on the vector path
+    // when available. "target" may be a or b
+    static void multiply(const Matrix4x4 &a, const Matrix4x4 &b, Matrix4x4 &target);
+    // Same for n pairs: target[i] = a[i] * b[i]
+    static void multiply(const Matrix4x4 *a, const Matrix4x4 *b, size_t n, Matrix4x4 *target);
 
     // Structure data
     double data[4][4];
+
+private:
+    // Inner product of row "lin" of m1 with column "col" of m2
+    static constexpr double rowTimesCol(const Matrix4x4 &m1, const Matrix4x4 &m2,
+                                        size_t lin, size_t col);
 };
 
+static_assert(std::is_trivially_copyable<Matrix4x4>::value,
+              "Matrix4x4 must stay trivially copyable");
+
 // Stream insertion operator
 ostream& operator<<(ostream &out, const Matrix4x4& m);
 
+// Single-precision copy of a Matrix4x4, for batch work on float data (a
+// vector instruction handles twice as many floats as doubles)
+struct Matrix4x4f
+{
+    // Constructors
+    Matrix4x4f();
+    explicit Matrix4x4f(const Matrix4x4 &m);
+
+    // Member functions (same conventions as in Matrix4x4)
+    Matrix4x4 toMatrix4x4() const;
+    void transpose(Matrix4x4f &target) const;
+    void transformPoints(const float *x, const float *y, const float *z, size_t n,
+                         float *outX, float *outY, float *outZ) const;
+    void transformVectors(const float *x, const float *y, const float *z, size_t n,
+                          float *outX, float *outY, float *outZ) const;
+    void transformNormals(const float *x, const float *y, const float *z, size_t n,
+                          float *outX, float *outY, float *outZ) const;
+
+    // Static methods
+    static void multiply(const Matrix4x4f &a, const Matrix4x4f &b, Matrix4x4f &target);
+    static void multiply(const Matrix4x4f *a, const Matrix4x4f *b, size_t n, Matrix4x4f *target);
+
+    // Structure data
+    float data[4][4];
+};
+
+inline constexpr Matrix4x4::Matrix4x4()
+    : data{ { 1, 0, 0, 0 },
+            { 0, 1, 0, 0 },
+            { 0, 0, 1, 0 },
+            { 0, 0, 0, 1 } }
+{ }
+
+inline constexpr Matrix4x4::Matrix4x4(const double data_[4][4])
+    : data{ { data_[0][0], data_[0][1], data_[0][2], data_[0][3] },
+            { data_[1][0], data_[1][1], data_[1][2], data_[1][3] },
+            { data_[2][0], data_[2][1], data_[2][2], data_[2][3] },
+            { data_[3][0], data_[3][1], data_[3][2], data_[3][3] } }
+{ }
+
+inline constexpr Matrix4x4::Matrix4x4( double a00, double a01, double a02, double a03,
+                                       double a10, double a11, double a12, double a13,
+                                       double a20, double a21, double a22, double a23,
+                                       double a30, double a31, double a32, double a33)
+    : data{ { a00, a01, a02, a03 },
+            { a10, a11, a12, a13 },
+            { a20, a21, a22, a23 },
+            { a30, a31, a32, a33 } }
+{ }
+
+inline constexpr Matrix4x4 Matrix4x4::operator+(const Matrix4x4 &m) const
+{
+    return Matrix4x4(data[0][0] + m.data[0][0], data[0][1] + m.data[0][1], data[0][2] + m.data[0][2], data[0][3] + m.data[0][3],
+                     data[1][0] + m.data[1][0], data[1][1] + m.data[1][1], data[1][2] + m.data[1][2], data[1][3] + m.data[1][3],
+                     data[2][0] + m.data[2][0], data[2][1] + m.data[2][1], data[2][2] + m.data[2][2], data[2][3] + m.data[2][3],
+                     data[3][0] + m.data[3][0], data[3][1] + m.data[3][1], data[3][2] + m.data[3][2], data[3][3] + m.data[3][3]);
+}
+
+inline constexpr Matrix4x4 Matrix4x4::operator-(const Matrix4x4 &m) const
+{
+    return Matrix4x4(data[0][0] - m.data[0][0], data[0][1] - m.data[0][1], data[0][2] - m.data[0][2], data[0][3] - m.data[0][3],
+                     data[1][0] - m.data[1][0], data[1][1] - m.data[1][1], data[1][2] - m.data[1][2], data[1][3] - m.data[1][3],
+                     data[2][0] - m.data[2][0], data[2][1] - m.data[2][1], data[2][2] - m.data[2][2], data[2][3] - m.data[2][3],
+                     data[3][0] - m.data[3][0], data[3][1] - m.data[3][1], data[3][2] - m.data[3][2], data[3][3] - m.data[3][3]);
+}
+
+inline constexpr double Matrix4x4::rowTimesCol(const Matrix4x4 &m1, const Matrix4x4 &m2,
+                                               size_t lin, size_t col)
+{
+    return m1.data[lin][0] * m2.data[0][col] +
+           m1.data[lin][1] * m2.data[1][col] +
+           m1.data[lin][2] * m2.data[2][col] +
+           m1.data[lin][3] * m2.data[3][col];
+}
+
+// Product between two matrices 4x4
+// res(lin, col) = inner product of this.data(lin,:)
+//                  with m.data(:,col)
+// Given the current matrix m1 and a second matrix m2, returns a matrix
+// res which, applied to an object (e.g., a point p) is equal to m1(m2(p))
+inline constexpr Matrix4x4 Matrix4x4::operator*(const Matrix4x4 &m) const
+{
+    return Matrix4x4(rowTimesCol(*this, m, 0, 0), rowTimesCol(*this, m, 0, 1), rowTimesCol(*this, m, 0, 2), rowTimesCol(*this, m, 0, 3),
+                     rowTimesCol(*this, m, 1, 0), rowTimesCol(*this, m, 1, 1), rowTimesCol(*this, m, 1, 2), rowTimesCol(*this, m, 1, 3),
+                     rowTimesCol(*this, m, 2, 0), rowTimesCol(*this, m, 2, 1), rowTimesCol(*this, m, 2, 2), rowTimesCol(*this, m, 2, 3),
+                     rowTimesCol(*this, m, 3, 0), rowTimesCol(*this, m, 3, 1), rowTimesCol(*this, m, 3, 2), rowTimesCol(*this, m, 3, 3));
+}
+
+inline constexpr Matrix4x4 Matrix4x4::operator*(const double a) const
+{
+    return Matrix4x4(data[0][0] * a, data[0][1] * a, data[0][2] * a, data[0][3] * a,
+                     data[1][0] * a, data[1][1] * a, data[1][2] * a, data[1][3] * a,
+                     data[2][0] * a, data[2][1] * a, data[2][2] * a, data[2][3] * a,
+                     data[3][0] * a, data[3][1] * a, data[3][2] * a, data[3][3] * a);
+}
+
+// This operator assumes that Vector3D are implicitly represented
+// through homogeneous coordinates [vx, vy, vz, 0]
+inline constexpr Vector3D Matrix4x4::transformVector(const Vector3D &v) const
+{
+    return Vector3D(data[0][0] * v.x + data[0][1] * v.y + data[0][2] * v.z,
+                    data[1][0] * v.x + data[1][1] * v.y + data[1][2] * v.z,
+                    data[2][0] * v.x + data[2][1] * v.y + data[2][2] * v.z);
+}
+
+inline constexpr Matrix4x4 Matrix4x4::transposed() const
+{
+    return Matrix4x4(data[0][0], data[1][0], data[2][0], data[3][0],
+                     data[0][1], data[1][1], data[2][1], data[3][1],
+                     data[0][2], data[1][2], data[2][2], data[3][2],
+                     data[0][3], data[1][3], data[2][3], data[3][3]);
+}
+
+inline constexpr Matrix4x4 Matrix4x4::translate(const Vector3D &delta)
+{
+    return Matrix4x4(1, 0, 0, delta.x,
+                     0, 1, 0, delta.y,
+                     0, 0, 1, delta.z,
+                     0, 0, 0, 1);
+}
+
+inline constexpr Matrix4x4 Matrix4x4::scale(const Vector3D &scalingVector)
+{
+    return Matrix4x4(scalingVector.x, 0, 0, 0,
+                     0, scalingVector.y, 0, 0,
+                     0, 0, scalingVector.z, 0,
+                     0, 0, 0, 1);
+}
+
+inline constexpr Matrix4x4 Matrix4x4::rotate(const double c, const double s, const Vector3D &a)
+{
+    return Matrix4x4(a.x * a.x + (1.0 - a.x * a.x) * c,
+                     a.x * a.y * (1.0 - c) - a.z * s,
+                     a.x * a.z * (1.0 - c) + a.y * s,
+                     0,
+                     a.x * a.y * (1.0 - c) + a.z * s,
+                     a.y * a.y + (1.0 - a.y * a.y) * c,
+                     a.y * a.z * (1.0 - c) - a.x * s,
+                     0,
+                     a.x * a.z * (1.0 - c) - a.y * s,
+                     a.y * a.z * (1.0 - c) + a.x * s,
+                     a.z * a.z + (1.0 - a.z * a.z) * c,
+                     0,
+                     0, 0, 0, 1);
+}
+
 #endif // MATRIX_H
@@ -0,0 +1,168 @@
+#include "memoryarena.h"
+
+#include <algorithm>
+#include <mutex>
+
+// Live counters, and the totals of the destroyed ones
+struct CounterRegistry
+{
+    std::mutex mutex;
+    std::vector<const AllocationCounters *> live;
+    ArenaStats retired;
+
+    CounterRegistry()
+    {
+        retired.arenaMallocs = retired.arenaAllocations = 0;
+        retired.poolMallocs = retired.poolAllocations = 0;
+        retired.bytesReserved = 0;
+    }
+};
+
+// Never destroyed: thread arenas may unregister after the static objects
+// are gone
+static CounterRegistry &getRegistry()
+{
+    static CounterRegistry *registry = new CounterRegistry();
+    return *registry;
+}
+
+static void addCounters(const AllocationCounters &counters, ArenaStats &stats)
+{
+    if(counters.kind == AllocationCounters::Kind::Arena)
+    {
+        stats.arenaMallocs     += counters.mallocs.load(std::memory_order_relaxed);
+        stats.arenaAllocations += counters.allocations.load(std::memory_order_relaxed);
+    }
+    else
+    {
+        stats.poolMallocs     += counters.mallocs.load(std::memory_order_relaxed);
+        stats.poolAllocations += counters.allocations.load(std::memory_order_relaxed);
+    }
+    stats.bytesReserved += counters.bytesReserved.load(std::memory_order_relaxed);
+}
+
+AllocationCounters::AllocationCounters(Kind kind_)
+    : kind(kind_), mallocs(0), allocations(0), bytesReserved(0)
+{
+    CounterRegistry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.live.push_back(this);
+}
+
+AllocationCounters::~AllocationCounters()
+{
+    CounterRegistry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.live.erase(std::find(registry.live.begin(), registry.live.end(), this));
+    addCounters(*this, registry.retired);
+}
+
+MemoryArena::MemoryArena(size_t blockSize_)
+    : blockSize(blockSize_), currentBlock(0), offset(0), bytesUsed(0),
+      counters(AllocationCounters::Kind::Arena)
+{ }
+
+MemoryArena::~MemoryArena()
+{
+    for(size_t i=0; i<blocks.size(); i++)
+    {
+        ::operator delete(blocks[i].data);
+    }
+}
+
+void *MemoryArena::alloc(size_t size, size_t alignment)
+{
+    counters.countAllocation();
+
+    // Try the current block, then the (already reserved) following ones
+    while(currentBlock < blocks.size())
+    {
+        Block &block = blocks[currentBlock];
+        uintptr_t base    = (uintptr_t)block.data;
+        uintptr_t aligned = (base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+        size_t newOffset  = (size_t)(aligned - base) + size;
+
+        if(newOffset <= block.size)
+        {
+            bytesUsed += newOffset - offset;
+            offset = newOffset;
+            return (void *)aligned;
+        }
+
+        currentBlock++;
+        offset = 0;
+    }
+
+    // Out of reserved memory: this is the only path that reaches the heap.
+    // Oversized requests get a block of their own
+    Block block;
+    block.size = std::max(blockSize, size + alignment);
+    block.data = static_cast<char *>(::operator new(block.size));
+    blocks.push_back(block);
+    currentBlock = blocks.size() - 1;
+    counters.countMalloc(block.size);
+
+    return alloc(size, alignment);
+}
+
+void MemoryArena::reset()
+{
+    currentBlock = 0;
+    offset = 0;
+    bytesUsed = 0;
+}
+
+MemoryArena::Marker MemoryArena::getMarker() const
+{
+    Marker marker;
+    marker.block     = currentBlock;
+    marker.offset    = offset;
+    marker.bytesUsed = bytesUsed;
+    return marker;
+}
+
+void MemoryArena::rewind(const Marker &marker)
+{
+    currentBlock = marker.block;
+    offset       = marker.offset;
+    bytesUsed    = marker.bytesUsed;
+}
+
+size_t MemoryArena::getBytesUsed() const
+{
+    return bytesUsed;
+}
+
+size_t MemoryArena::getBytesReserved() const
+{
+    size_t total = 0;
+    for(size_t i=0; i<blocks.size(); i++)
+    {
+        total += blocks[i].size;
+    }
+    return total;
+}
+
+struct ThreadArenas
+{
+    MemoryArena tile;
+    MemoryArena frame;
+};
+
+MemoryArena &MemoryArena::forThread(ArenaLifetime lifetime)
+{
+    static thread_local ThreadArenas arenas;
+    return (lifetime == ArenaLifetime::Tile) ? arenas.tile : arenas.frame;
+}
+
+ArenaStats MemoryArena::getStats()
+{
+    CounterRegistry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    ArenaStats stats = registry.retired;
+    for(size_t i=0; i<registry.live.size(); i++)
+    {
+        addCounters(*registry.live[i], stats);
+    }
+    return stats;
+}
@@ -0,0 +1,249 @@
+#ifndef MEMORYARENA_H
+#define MEMORYARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+#include <vector>
+
+// How long the memory obtained from a thread arena lives
+enum class ArenaLifetime
+{
+    Tile,  // Released by the renderer after every tile
+    Frame  // Released when the render that allocated it ends (see ArenaScope)
+};
+
+/**
+ * @brief The ArenaStats struct
+ *
+ * Process-wide counters. "mallocs" are the calls that actually reached the
+ * heap; in a steady-state render loop they stay constant, while
+ * "allocations" (requests served from already reserved memory) grow.
+ */
+struct ArenaStats
+{
+    uint64_t arenaMallocs;     // Blocks allocated by MemoryArena
+    uint64_t arenaAllocations; // MemoryArena::alloc() calls
+    uint64_t poolMallocs;      // Chunks allocated by ObjectPool
+    uint64_t poolAllocations;  // ObjectPool::alloc() calls
+    uint64_t bytesReserved;    // Total heap memory obtained by both
+};
+
+/**
+ * @brief The AllocationCounters struct
+ *
+ * Counters of a single arena or pool. Only the thread that owns it writes
+ * them, with a relaxed load and store (a plain add, with no locked
+ * instruction and no cache line shared with other threads); they are
+ * atomic only so that MemoryArena::getStats() can read them meanwhile.
+ * Counters register themselves when created, and their totals are kept
+ * when destroyed.
+ */
+struct AllocationCounters
+{
+    enum class Kind { Arena, Pool };
+
+    explicit AllocationCounters(Kind kind_);
+    ~AllocationCounters();
+    AllocationCounters(const AllocationCounters &) = delete;
+    AllocationCounters &operator=(const AllocationCounters &) = delete;
+
+    void countAllocation()
+    {
+        allocations.store(allocations.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+    }
+    void countMalloc(size_t bytes)
+    {
+        mallocs.store(mallocs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        bytesReserved.store(bytesReserved.load(std::memory_order_relaxed) + bytes,
+                            std::memory_order_relaxed);
+    }
+
+    Kind kind;
+    std::atomic<uint64_t> mallocs;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> bytesReserved;
+};
+
+/**
+ * @brief The MemoryArena class
+ *
+ * Bump allocator: alloc() only advances an offset in the current block, and
+ * reset() makes all the memory available again without freeing it. Objects
+ * created in an arena are never destroyed, so it is meant for transient,
+ * trivially destructible data (rays, sample offsets, intersection records).
+ */
+class MemoryArena
+{
+public:
+    // Constructor(s)
+    explicit MemoryArena(size_t blockSize_ = 256 * 1024);
+    MemoryArena(const MemoryArena &) = delete;
+    MemoryArena &operator=(const MemoryArena &) = delete;
+
+    // Destructor
+    ~MemoryArena();
+
+    // Member functions
+    void *alloc(size_t size, size_t alignment = 16);
+    template<typename T> T *alloc(size_t n = 1);
+    void reset();
+
+    // Position of the arena: rewinding to it gives back everything that
+    // was allocated afterwards
+    struct Marker
+    {
+        size_t block;
+        size_t offset;
+        size_t bytesUsed;
+    };
+    Marker getMarker() const;
+    void rewind(const Marker &marker);
+
+    size_t getBytesUsed() const;
+    size_t getBytesReserved() const;
+
+    // Static methods
+    // Arena of the calling thread for the given lifetime. It is only ever
+    // touched by that thread
+    static MemoryArena &forThread(ArenaLifetime lifetime);
+    // Sum of the counters of every arena and pool, live or destroyed
+    static ArenaStats getStats();
+
+private:
+    struct Block
+    {
+        char *data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t blockSize;
+    size_t currentBlock;
+    size_t offset;
+    size_t bytesUsed;
+    AllocationCounters counters;
+};
+
+template<typename T>
+T *MemoryArena::alloc(size_t n)
+{
+    T *objects = static_cast<T *>(alloc(n * sizeof(T), alignof(T)));
+    for(size_t i=0; i<n; i++)
+    {
+        new (&objects[i]) T();
+    }
+    return objects;
+}
+
+/**
+ * @brief The ArenaScope class
+ *
+ * Rewinds an arena, when destroyed, to where it was when the scope was
+ * created. A render opens one on the frame arena of the thread that runs
+ * it, so its frame memory is released when it returns. Scopes nest, so
+ * renders running at the same time (each on its own thread) or one inside
+ * another (a pool worker picking up a batch job) never release each
+ * other's memory.
+ */
+class ArenaScope
+{
+public:
+    explicit ArenaScope(MemoryArena &arena_) : arena(arena_), marker(arena_.getMarker())
+    { }
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+    ~ArenaScope()
+    {
+        arena.rewind(marker);
+    }
+
+private:
+    MemoryArena &arena;
+    MemoryArena::Marker marker;
+};
+
+/**
+ * @brief The ObjectPool class
+ *
+ * Free-list allocator for fixed-size records. Memory is obtained in chunks
+ * of chunkSize objects and recycled by free(); it is only returned to the
+ * system when the pool is destroyed. Not thread-safe: use one per thread.
+ */
+template<typename T>
+class ObjectPool
+{
+public:
+    explicit ObjectPool(size_t chunkSize_ = 1024)
+        : freeList(nullptr), chunkSize(chunkSize_ > 0 ? chunkSize_ : 1), nLive(0),
+          counters(AllocationCounters::Kind::Pool)
+    { }
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool()
+    {
+        for(size_t i=0; i<chunks.size(); i++)
+        {
+            ::operator delete(chunks[i]);
+        }
+    }
+
+    // Returns a default-constructed object
+    T *alloc()
+    {
+        if(!freeList)
+            grow();
+
+        Slot *slot = freeList;
+        freeList = slot->next;
+        nLive++;
+        counters.countAllocation();
+        return new (slot->storage) T();
+    }
+
+    void free(T *object)
+    {
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+        nLive--;
+    }
+
+    size_t getLiveCount() const
+    {
+        return nLive;
+    }
+
+private:
+    union Slot
+    {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    void grow()
+    {
+        Slot *chunk = static_cast<Slot *>(::operator new(chunkSize * sizeof(Slot)));
+        chunks.push_back(chunk);
+        counters.countMalloc(chunkSize * sizeof(Slot));
+
+        for(size_t i=0; i<chunkSize; i++)
+        {
+            chunk[i].next = freeList;
+            freeList = &chunk[i];
+        }
+    }
+
+    std::vector<Slot *> chunks;
+    Slot *freeList;
+    size_t chunkSize;
+    size_t nLive;
+    AllocationCounters counters;
+};
+
+#endif // MEMORYARENA_H
@@ -0,0 +1,148 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool(size_t nThreads) : stopping(false)
+{
+    if(nThreads == 0)
+    {
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for(size_t i=0; i<nThreads; i++)
+    {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for(size_t i=0; i<workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+void ThreadPool::enqueue(const std::function<void()> &task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+    condition.notify_one();
+}
+
+size_t ThreadPool::getThreadCount() const
+{
+    return workers.size();
+}
+
+ThreadPool &ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::workerLoop()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+            // Drain the queue before leaving
+            if(tasks.empty())
+                return;
+
+            task = tasks.front();
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+Parallel::Parallel()
+{ }
+
+// Shared state of a forRange() call. It is owned through a shared_ptr
+// because helper tasks may be dequeued after the call has returned
+struct ParallelForState
+{
+    std::function<void(size_t, size_t)> body;
+    size_t begin, end, grain, nChunks;
+    std::atomic<size_t> nextChunk;
+    std::atomic<size_t> doneChunks;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    // Process chunks until none is left
+    void run()
+    {
+        size_t chunk;
+        while((chunk = nextChunk.fetch_add(1)) < nChunks)
+        {
+            size_t chunkBegin = begin + chunk * grain;
+            size_t chunkEnd   = std::min(end, chunkBegin + grain);
+            body(chunkBegin, chunkEnd);
+
+            if(doneChunks.fetch_add(1) + 1 == nChunks)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+void Parallel::forRange(size_t begin, size_t end, size_t grain,
+                        const std::function<void(size_t, size_t)> &body)
+{
+    if(end <= begin)
+        return;
+
+    grain = std::max<size_t>(grain, 1);
+    size_t nChunks = (end - begin + grain - 1) / grain;
+
+    // Not worth waking up the pool
+    if(nChunks == 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    state->body  = body;
+    state->begin = begin;
+    state->end   = end;
+    state->grain = grain;
+    state->nChunks = nChunks;
+    state->nextChunk  = 0;
+    state->doneChunks = 0;
+
+    ThreadPool &pool = ThreadPool::global();
+    size_t nHelpers = std::min(pool.getThreadCount(), nChunks - 1);
+    for(size_t i=0; i<nHelpers; i++)
+    {
+        pool.enqueue([state] { state->run(); });
+    }
+
+    // The calling thread works too, then waits for the chunks still in flight
+    state->run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state] { return state->doneChunks == state->nChunks; });
+}
+
+size_t Parallel::getThreadCount()
+{
+    return ThreadPool::global().getThreadCount();
+}
@@ -0,0 +1,62 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The ThreadPool class
+ *
+ * Fixed set of worker threads consuming a FIFO queue of tasks. A single
+ * process-wide instance is available through ThreadPool::global().
+ */
+class ThreadPool
+{
+public:
+    // Constructor(s). A thread count of 0 means "one per hardware thread"
+    explicit ThreadPool(size_t nThreads = 0);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Destructor (waits for the queued tasks to finish)
+    ~ThreadPool();
+
+    // Member functions
+    void enqueue(const std::function<void()> &task);
+    size_t getThreadCount() const;
+
+    // Static methods
+    static ThreadPool &global();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+};
+
+class Parallel
+{
+public:
+    Parallel();
+
+    // Splits [begin, end) in chunks of (at most) "grain" indices and calls
+    // body(chunkBegin, chunkEnd) for each of them on the global pool. The
+    // calling thread also processes chunks, so forRange() may safely be
+    // called from inside a pool task.
+    static void forRange(size_t begin, size_t end, size_t grain,
+                         const std::function<void(size_t, size_t)> &body);
+
+    static size_t getThreadCount();
+};
+
+#endif // PARALLEL_H
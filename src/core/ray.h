@@ -1,6 +1,7 @@
 #ifndef RAY_H
 #define RAY_H
 
+#include <cmath>
 #include <string>
 #include <sstream>
 
@@ -31,4 +32,16 @@ public:
 
 std::ostream &operator<<(std::ostream &out, const Ray &r);
 
+// Rays stored as structure of arrays: ray i goes from (ox[i], oy[i], oz[i])
+// along (dx[i], dy[i], dz[i]) over [minT[i], maxT[i]]. Closest-hit queries
+// lower maxT as they find hits (see Shape::rayIntersect())
+struct RayBatch
+{
+    const double *ox, *oy, *oz;
+    const double *dx, *dy, *dz;
+    const double *minT;
+    double *maxT;
+    size_t n;
+};
+
 #endif // RAY_H
@@ -0,0 +1,149 @@
+#include "rng.h"
+
+// Philox4x32 constants
+static const uint32_t philoxM0 = 0xD2511F53u;
+static const uint32_t philoxM1 = 0xCD9E8D57u;
+static const uint32_t philoxW0 = 0x9E3779B9u; // Golden ratio
+static const uint32_t philoxW1 = 0xBB67AE85u; // sqrt(3) - 1
+static const int      philoxRounds = 10;
+
+// Set in the last counter word of the blocks of uniformDouble()
+static const uint32_t doubleDimensions = 0x80000000u;
+
+// Number of lanes processed together by the batch functions
+static const size_t batchLanes = 64;
+
+Philox::Philox(uint64_t seed_) : seed(seed_)
+{
+    key[0] = (uint32_t)seed;
+    key[1] = (uint32_t)(seed >> 32);
+}
+
+uint64_t Philox::getSeed() const
+{
+    return seed;
+}
+
+void Philox::generate(const uint32_t counter[4], uint32_t out[4]) const
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+
+    for(int r=0; r<philoxRounds; r++)
+    {
+        uint64_t p0 = (uint64_t)philoxM0 * c0;
+        uint64_t p1 = (uint64_t)philoxM1 * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += philoxW0;
+        k1 += philoxW1;
+    }
+
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+uint32_t Philox::nextUInt(uint64_t pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+    uint32_t counter[4] = { (uint32_t)pixel, (uint32_t)(pixel >> 32),
+                            sampleIndex, dimension >> 2 };
+    uint32_t out[4];
+    generate(counter, out);
+    return out[dimension & 3];
+}
+
+float Philox::uniformFloat(uint64_t pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+    return toFloat(nextUInt(pixel, sampleIndex, dimension));
+}
+
+double Philox::uniformDouble(uint64_t pixel, uint32_t sampleIndex, uint32_t dimension) const
+{
+    // Each double dimension takes a block of its own, marked by the top bit
+    // of the last counter word (which float dimensions, dimension >> 2,
+    // never reach), so that no two draws share a word
+    uint32_t counter[4] = { (uint32_t)pixel, (uint32_t)(pixel >> 32),
+                            sampleIndex, doubleDimensions | dimension };
+    uint32_t out[4];
+    generate(counter, out);
+    return toDouble(out[0], out[1]);
+}
+
+void Philox::uniformFloatBatch(const uint64_t *pixels, const uint32_t *samples,
+                               uint32_t dimension, float *out, size_t n) const
+{
+    uint32_t c0[batchLanes], c1[batchLanes], c2[batchLanes], c3[batchLanes];
+    const uint32_t lane = dimension & 3;
+
+    for(size_t base = 0; base < n; base += batchLanes)
+    {
+        size_t count = (n - base < batchLanes) ? n - base : batchLanes;
+
+        for(size_t i=0; i<batchLanes; i++)
+        {
+            size_t src = base + (i < count ? i : 0);
+            c0[i] = (uint32_t)pixels[src];
+            c1[i] = (uint32_t)(pixels[src] >> 32);
+            c2[i] = samples[src];
+            c3[i] = dimension >> 2;
+        }
+
+        uint32_t k0 = key[0], k1 = key[1];
+        for(int r=0; r<philoxRounds; r++)
+        {
+            // Fixed trip count, no branches: one SIMD lane per counter
+            for(size_t i=0; i<batchLanes; i++)
+            {
+                uint64_t p0 = (uint64_t)philoxM0 * c0[i];
+                uint64_t p1 = (uint64_t)philoxM1 * c2[i];
+                uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[i] ^ k0;
+                uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[i] ^ k1;
+                c1[i] = (uint32_t)p1;
+                c3[i] = (uint32_t)p0;
+                c0[i] = n0;
+                c2[i] = n2;
+            }
+            k0 += philoxW0;
+            k1 += philoxW1;
+        }
+
+        const uint32_t *words = (lane == 0) ? c0 : (lane == 1) ? c1 : (lane == 2) ? c2 : c3;
+        for(size_t i=0; i<count; i++)
+        {
+            out[base + i] = toFloat(words[i]);
+        }
+    }
+}
+
+void Philox::uniformFloatRow(uint64_t firstPixel, uint32_t sampleIndex,
+                             uint32_t dimension, float *out, size_t n) const
+{
+    uint64_t pixels[batchLanes];
+    uint32_t samples[batchLanes];
+    for(size_t i=0; i<batchLanes; i++)
+        samples[i] = sampleIndex;
+
+    for(size_t base = 0; base < n; base += batchLanes)
+    {
+        size_t count = (n - base < batchLanes) ? n - base : batchLanes;
+        for(size_t i=0; i<count; i++)
+            pixels[i] = firstPixel + base + i;
+
+        uniformFloatBatch(pixels, samples, dimension, out + base, count);
+    }
+}
+
+float Philox::toFloat(uint32_t x)
+{
+    // 24 bits of mantissa: exactly representable and strictly below 1
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+double Philox::toDouble(uint32_t hi, uint32_t lo)
+{
+    uint64_t bits = ((uint64_t)hi << 21) ^ (uint64_t)(lo >> 11);
+    return (double)bits * (1.0 / 9007199254740992.0);
+}
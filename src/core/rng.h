@@ -0,0 +1,56 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * @brief The Philox class
+ *
+ * Counter-based random number generator (Philox4x32-10, Salmon et al. 2011).
+ * There is no hidden state: every value is a pure function of the key (the
+ * seed) and a counter built from (pixel, sample index, dimension). Values
+ * can thus be generated by any thread, in any order, and they do not depend
+ * on how the work was scheduled.
+ *
+ * Each counter produces a block of 4 words: float (and integer) dimensions
+ * 4k..4k+3 of a (pixel, sample) pair share the same block, while every
+ * double dimension (below 2^31) has a block of its own.
+ */
+class Philox
+{
+public:
+    // Constructor(s)
+    explicit Philox(uint64_t seed_ = 0);
+
+    // Getters
+    uint64_t getSeed() const;
+
+    // Raw generator: 4 random words for a 128-bit counter
+    void generate(const uint32_t counter[4], uint32_t out[4]) const;
+
+    // Uniform values in [0, 1)
+    uint32_t nextUInt(uint64_t pixel, uint32_t sampleIndex, uint32_t dimension) const;
+    float    uniformFloat(uint64_t pixel, uint32_t sampleIndex, uint32_t dimension) const;
+    double   uniformDouble(uint64_t pixel, uint32_t sampleIndex, uint32_t dimension) const;
+
+    // Batch interface: out[i] = uniformFloat(pixels[i], samples[i], dimension).
+    // Lanes are processed in structure-of-arrays form with no branches, so
+    // the rounds compile to SIMD code
+    void uniformFloatBatch(const uint64_t *pixels, const uint32_t *samples,
+                           uint32_t dimension, float *out, size_t n) const;
+    // Same with consecutive pixels (firstPixel, firstPixel + 1, ...) and a
+    // common sample index, e.g., a row of a tile
+    void uniformFloatRow(uint64_t firstPixel, uint32_t sampleIndex,
+                         uint32_t dimension, float *out, size_t n) const;
+
+    // Conversions from random words
+    static float  toFloat(uint32_t x);
+    static double toDouble(uint32_t hi, uint32_t lo);
+
+private:
+    uint64_t seed;
+    uint32_t key[2];
+};
+
+#endif // RNG_H
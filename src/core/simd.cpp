@@ -0,0 +1,57 @@
+#include "simd.h"
+
+#include <atomic>
+
+#if defined(_MSC_VER) && defined(RTIS_AVX2)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+static std::atomic<bool> simdEnabled(true);
+
+static bool detectAvx2()
+{
+#if defined(RTIS_AVX2) && defined(_MSC_VER)
+    // OSXSAVE and AVX (leaf 1), YMM state enabled by the OS (XCR0), AVX2
+    // (leaf 7)
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuidex(info, 1, 0);
+    bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+    if(!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(RTIS_AVX2)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#else
+    return false;
+#endif
+}
+
+Simd::Simd()
+{ }
+
+bool Simd::hasAvx2()
+{
+    static const bool avx2 = detectAvx2();
+    return avx2;
+}
+
+bool Simd::isEnabled()
+{
+    return simdEnabled;
+}
+
+void Simd::setEnabled(bool enabled)
+{
+    simdEnabled = enabled;
+}
+
+bool Simd::useAvx2()
+{
+    return simdEnabled && hasAvx2();
+}
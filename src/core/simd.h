@@ -0,0 +1,42 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Vector code paths are compiled for AVX2 function by function (the rest of
+// the program keeps the baseline instruction set) and chosen at run time,
+// so one binary runs everywhere and uses AVX2 where the CPU has it.
+//
+// RTIS_AVX2 is defined when this compiler can build such paths, and
+// RTIS_AVX2_TARGET marks the functions that use AVX2 intrinsics
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RTIS_AVX2
+#define RTIS_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+// MSVC accepts AVX intrinsics in any function
+#define RTIS_AVX2
+#define RTIS_AVX2_TARGET
+#endif
+
+/**
+ * @brief The Simd class
+ *
+ * Run-time selection of the vector code paths.
+ */
+class Simd
+{
+public:
+    Simd();
+
+    // The CPU and the operating system support AVX2 (and RTIS_AVX2 paths
+    // were compiled)
+    static bool hasAvx2();
+
+    // Vector paths can be disabled (e.g., to compare them with the scalar
+    // ones). They are enabled by default
+    static bool isEnabled();
+    static void setEnabled(bool enabled);
+
+    // hasAvx2() and isEnabled()
+    static bool useAvx2();
+};
+
+#endif // SIMD_H
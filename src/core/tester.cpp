@@ -1,5 +1,35 @@
 #include "tester.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "bitmap.h"
+#include "film.h"
+#include "heapcounter.h"
+#include "memoryarena.h"
+#include "parallel.h"
+#include "rng.h"
+#include "simd.h"
+#include "tonemapper.h"
+#include "utils.h"
+#include "../cameras/ortographic.h"
+#include "../cameras/perspective.h"
+#include "../filters/iterativefilter.h"
+#include "../render/progressive.h"
+#include "../render/renderer.h"
+#include "../render/wavefront.h"
+#include "../shapes/sphere.h"
+#include "../textures/texture.h"
+
 Tester::Tester()
 {
 
@@ -87,4 +117,1056 @@ void Tester::testMatrixClass()
     std::cout << "\nCreate a rotation matrix r of " << angle << " rads around "
               << axis << ":\n" << r << std::endl;
 
+    // The same products, evaluated by the compiler
+    constexpr Matrix4x4 stConst = Matrix4x4::scale(Vector3D(2, 2, -2)) *
+                                  Matrix4x4::translate(Vector3D(4, 7, -5));
+    constexpr Vector3D stPoint = stConst.transformVector(Vector3D(1, 1, 1)) +
+                                 Vector3D(stConst.data[0][3], stConst.data[1][3], stConst.data[2][3]);
+    static_assert(stPoint.x == 10 && stPoint.y == 16 && stPoint.z == 8,
+                  "compile-time (s*t) must match the runtime result");
+    constexpr Matrix4x4 rConst = Matrix4x4::rotate(0.0, 1.0, Vector3D(0, 0, 1));
+    static_assert(rConst.transformVector(Vector3D(1, 0, 0)).y == 1,
+                  "a quarter turn around z maps x to y");
+    std::cout << "Compile-time (s*t).transformPoint(Vector3D(1,1,1)) = " << stPoint << std::endl;
+
+}
+
+void Tester::testRandomGenerator()
+{
+    std::cout << "Random Generator Tester\n" << std::endl;
+
+    // Known answers of Philox4x32-10 (Random123 test vectors)
+    uint32_t out[4];
+    uint32_t zeros[4] = { 0, 0, 0, 0 };
+    Philox(0).generate(zeros, out);
+    bool ok = out[0] == 0x6627e8d5u && out[1] == 0xe169c58du &&
+              out[2] == 0xbc57ac4cu && out[3] == 0x9b00dbd8u;
+
+    uint32_t ones[4] = { ~0u, ~0u, ~0u, ~0u };
+    Philox(~0ull).generate(ones, out);
+    ok = ok && out[0] == 0x408f276du && out[1] == 0x41c83b0eu &&
+               out[2] == 0xa20bc7c6u && out[3] == 0x6d5451fdu;
+    std::cout << "Known answer test: " << (ok ? "passed" : "FAILED") << std::endl;
+
+    // The batch interface must return the scalar values
+    Philox rng(1234);
+    std::vector<float> row(1000);
+    rng.uniformFloatRow(5000, 7, 3, row.data(), row.size());
+    size_t mismatches = 0;
+    for(size_t i=0; i<row.size(); i++)
+    {
+        if(row[i] != rng.uniformFloat(5000 + i, 7, 3))
+            mismatches++;
+    }
+    std::cout << "Batch vs scalar mismatches: " << mismatches << std::endl;
+
+    // Double dimensions must not share words: neighbouring dimensions once
+    // came from the same two words, which made v = frac(u * 2^32)
+    ok = rng.uniformDouble(42, 7, 0) == 0.75720732861654061 &&
+         rng.uniformDouble(42, 7, 1) == 0.88349690794072855;
+    std::cout << "Double known answer test: " << (ok ? "passed" : "FAILED") << std::endl;
+
+    const size_t nPairs = 100000;
+    size_t nRelated = 0;
+    double sumU = 0, sumV = 0, sumUU = 0, sumVV = 0, sumUV = 0;
+    for(size_t i=0; i<nPairs; i++)
+    {
+        double u = rng.uniformDouble(i, 0, 0);
+        double v = rng.uniformDouble(i, 0, 1);
+        double shifted = u * 4294967296.0;
+        if(std::fabs(v - (shifted - std::floor(shifted))) < 1e-3)
+            nRelated++;
+        sumU += u; sumV += v;
+        sumUU += u * u; sumVV += v * v; sumUV += u * v;
+    }
+    double covariance = sumUV / nPairs - (sumU / nPairs) * (sumV / nPairs);
+    double correlation = covariance / std::sqrt((sumUU / nPairs - (sumU / nPairs) * (sumU / nPairs)) *
+                                                (sumVV / nPairs - (sumV / nPairs) * (sumV / nPairs)));
+    // About 0.2% of the pairs fall that close by chance; the correlation of
+    // independent draws is within +-0.01 (3 standard deviations)
+    ok = nRelated < nPairs / 100 && std::fabs(correlation) < 0.01;
+    std::cout << "Double dimensions 0 and 1: correlation " << correlation << ", "
+              << nRelated << " of " << nPairs << " pairs with v = frac(u * 2^32) "
+              << (ok ? "(ok)" : "(CORRELATED)") << std::endl;
+
+    // Throughput on every core of the global pool
+    const size_t perChunk = 1 << 20;
+    const size_t nChunks  = 16 * Parallel::getThreadCount();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Parallel::forRange(0, nChunks, 1, [&](size_t begin, size_t end)
+    {
+        std::vector<float> values(perChunk);
+        for(size_t c = begin; c < end; c++)
+            rng.uniformFloatRow(c * perChunk, 0, 0, values.data(), perChunk);
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Generated " << nChunks * perChunk << " values in " << seconds << " s ("
+              << nChunks * perChunk / seconds * 1e-9 << " billion/s on "
+              << Parallel::getThreadCount() << " threads)" << std::endl;
+}
+
+void Tester::testMemoryArena()
+{
+    std::cout << "Memory Arena Tester\n" << std::endl;
+
+    MemoryArena arena(1024);
+    double *a = arena.alloc<double>(10);
+    char   *b = arena.alloc<char>(3);
+    double *c = arena.alloc<double>(1);
+    std::cout << "Alignment of doubles after a char block: "
+              << (((uintptr_t)c % alignof(double)) == 0 ? "ok" : "WRONG") << std::endl;
+    std::cout << "Bytes used / reserved: " << arena.getBytesUsed() << " / "
+              << arena.getBytesReserved() << std::endl;
+
+    // Steady state: once the blocks exist (after the first frame), a
+    // reset/alloc cycle reuses them
+    ArenaStats before = MemoryArena::getStats();
+    for(int frame=0; frame<=100; frame++)
+    {
+        if(frame == 1)
+            before = MemoryArena::getStats();
+        arena.reset();
+        for(int i=0; i<50; i++)
+            arena.alloc<float>(16);
+    }
+    ArenaStats after = MemoryArena::getStats();
+    std::cout << "Block mallocs in 100 warm frames: "
+              << after.arenaMallocs - before.arenaMallocs << " (for "
+              << after.arenaAllocations - before.arenaAllocations << " allocations)" << std::endl;
+
+    ObjectPool<Vector3D> pool(64);
+    std::vector<Vector3D *> records;
+    for(int i=0; i<64; i++)
+        records.push_back(pool.alloc());
+    for(size_t i=0; i<records.size(); i++)
+        pool.free(records[i]);
+    before = MemoryArena::getStats();
+    for(int i=0; i<64; i++)
+        records[i] = pool.alloc();
+    after = MemoryArena::getStats();
+    std::cout << "Pool mallocs when recycling 64 records: "
+              << after.poolMallocs - before.poolMallocs << std::endl;
+    for(size_t i=0; i<records.size(); i++)
+        pool.free(records[i]);
+
+    if(!HeapCounter::isEnabled())
+    {
+        std::cout << "Heap allocations of warm render loops: not counted in this build "
+                  << "(build with RTIS_COUNT_HEAP, qmake CONFIG+=heapcount)" << std::endl;
+        (void)a; (void)b;
+        return;
+    }
+
+    // Real heap traffic of warm render loops. Parallel::forRange allocates
+    // its shared state on every call, so the loops are run on a small and
+    // a large image with the same forRange calls: their allocations must
+    // not grow with the number of tiles or rays
+    Sphere glass(0.8, Matrix4x4::translate(Vector3D(0, 0, 3)));
+    Sphere mirror(1.2, Matrix4x4::translate(Vector3D(0.5, 0.3, 6)));
+    glass.setMaterial(Material(Vector3D(1, 1, 1), 0, 0.95, 1.5));
+    mirror.setMaterial(Material(Vector3D(1, 1, 1), 0.9));
+    std::vector<Shape*> objects;
+    objects.push_back(&glass);
+    objects.push_back(&mirror);
+
+    const size_t resolutions[2] = { 128, 512 };
+    uint64_t passAllocations[2], waveAllocations[2];
+    size_t nTiles[2], nRays[2], nForRanges = 0;
+    for(int r = 0; r < 2; r++)
+    {
+        size_t res = resolutions[r];
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), res, res);
+        Film film(res, res);
+
+        // Second pass (the first jittered one) after a warm-up pass
+        std::vector<Tile> tiles = Tile::split(0, 0, res, res, 16);
+        Renderer renderer(camera, objects);
+        renderer.renderPass(film, tiles, 0);
+        uint64_t start = HeapCounter::getAllocations();
+        renderer.renderPass(film, tiles, 1);
+        passAllocations[r] = HeapCounter::getAllocations() - start;
+        nTiles[r] = tiles.size();
+
+        // A single wave, with every secondary queue sorted. One ray per
+        // batch, so that every call has several chunks (a call with a single
+        // chunk runs inline and allocates nothing)
+        WavefrontSettings settings;
+        settings.waveSize    = res * res;
+        settings.batchSize   = 1;
+        settings.sortMinRays = 0;
+        WavefrontRenderer wavefront(camera, objects, settings);
+        WavefrontStats stats;
+        wavefront.render(film, &stats);
+        start = HeapCounter::getAllocations();
+        wavefront.render(film);
+        waveAllocations[r] = HeapCounter::getAllocations() - start;
+
+        // Both images reach the same depths, so they make the same calls:
+        // generate, then intersect, shade, spawn (two) and sort (three)
+        nRays[r] = 0;
+        nForRanges = 1;
+        for(size_t depth = 0; depth < stats.raysPerDepth.size(); depth++)
+        {
+            nRays[r] += stats.raysPerDepth[depth];
+            if(stats.raysPerDepth[depth] > 0)
+                nForRanges += 4 + (depth >= settings.sortFromDepth ? 3 : 0);
+        }
+    }
+
+    // The task queue of the pool may take or release a node on any call
+    bool passOk = passAllocations[1] <= passAllocations[0] + 1;
+    bool waveOk = waveAllocations[1] <= waveAllocations[0] + nForRanges;
+    std::cout << "Heap allocations of a warm render pass: " << passAllocations[0] << " for "
+              << nTiles[0] << " tiles, " << passAllocations[1] << " for " << nTiles[1] << " tiles"
+              << (passOk ? " (ok)" : " (GROWS WITH THE TILES)") << std::endl;
+    std::cout << "Heap allocations of a warm wavefront render: " << waveAllocations[0] << " for "
+              << nRays[0] << " rays, " << waveAllocations[1] << " for " << nRays[1] << " rays"
+              << (waveOk ? " (ok)" : " (GROWS WITH THE RAYS)") << std::endl;
+
+    (void)a; (void)b;
+}
+
+// Compares every layout and format against the row-major float texture on
+// odd, non-square sizes (partial tiles, Morton padding, odd mip levels),
+// with both wrap modes and every filter, through the single and the batch
+// lookups. Coordinates reach outside [0, 1] so that wrapping is exercised.
+// Returns the number of mismatching configurations
+static int checkTextureLayouts()
+{
+    const size_t sizes[][2] = { { 37, 23 }, { 5, 64 }, { 1, 9 }, { 129, 3 } };
+    const size_t nSamples = 999; // Not a multiple of the batch size
+    const char *layoutNames[] = { "row-major", "tiled", "Morton" };
+    const char *formatNames[] = { "RGB8", "float" };
+    const char *filterNames[] = { "nearest", "bilinear", "trilinear" };
+    const char *wrapNames[] = { "repeat", "clamp" };
+
+    std::vector<float> u(nSamples), v(nSamples), lod(nSamples);
+    Philox rng(11);
+    rng.uniformFloatRow(0, 0, 0, u.data(), nSamples);
+    rng.uniformFloatRow(0, 0, 1, v.data(), nSamples);
+    rng.uniformFloatRow(0, 0, 2, lod.data(), nSamples);
+    for(size_t i = 0; i < nSamples; i++)
+    {
+        u[i] = u[i] * 3 - 1;
+        v[i] = v[i] * 3 - 1;
+        lod[i] *= 8;
+    }
+
+    int nFailed = 0;
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        size_t width = sizes[s][0], height = sizes[s][1];
+        Film film(width, height);
+        for(size_t y = 0; y < height; y++)
+            for(size_t x = 0; x < width; x++)
+                film.setPixelValue(x, y, Vector3D((double)x / width, (double)y / height,
+                                                  ((x ^ y) & 1) ? 1.0 : 0.25));
+
+        for(int wrap = 0; wrap < 2; wrap++)
+        {
+            TextureSettings referenceSettings;
+            referenceSettings.layout = TextureLayout::RowMajor;
+            referenceSettings.format = TextureFormat::Float;
+            referenceSettings.wrap = (TextureWrap)wrap;
+            Texture reference(film, referenceSettings);
+
+            for(int layout = 0; layout < 3; layout++)
+            {
+                for(int format = 0; format < 2; format++)
+                {
+                    TextureSettings settings = referenceSettings;
+                    settings.layout = (TextureLayout)layout;
+                    settings.format = (TextureFormat)format;
+                    Texture texture(film, settings);
+                    float tolerance = format == 0 ? 0.5f / 255.0f + 1e-5f : 1e-6f;
+
+                    for(int filter = 0; filter < 3; filter++)
+                    {
+                        TextureFilter textureFilter = (TextureFilter)filter;
+                        std::vector<float> expected(3 * nSamples), result(3 * nSamples);
+                        reference.sample(u.data(), v.data(), lod.data(), nSamples,
+                                         textureFilter, expected.data());
+                        texture.sample(u.data(), v.data(), lod.data(), nSamples,
+                                       textureFilter, result.data());
+
+                        float maxError = 0;
+                        for(size_t i = 0; i < nSamples; i++)
+                        {
+                            Vector3D single = texture.sample(u[i], v[i], textureFilter, lod[i]);
+                            float singleRgb[3] = { (float)single.x, (float)single.y, (float)single.z };
+                            for(int c = 0; c < 3; c++)
+                            {
+                                maxError = std::max(maxError, std::fabs(result[3 * i + c] - expected[3 * i + c]));
+                                maxError = std::max(maxError, std::fabs(singleRgb[c] - expected[3 * i + c]));
+                            }
+                        }
+
+                        if(maxError > tolerance)
+                        {
+                            std::cout << "Layout check: " << layoutNames[layout] << " "
+                                      << formatNames[format] << " " << filterNames[filter] << " "
+                                      << wrapNames[wrap] << " " << width << "x" << height
+                                      << ": WRONG TEXELS (error " << maxError << ")" << std::endl;
+                            nFailed++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return nFailed;
+}
+
+void Tester::testTextureSampling()
+{
+    std::cout << "Texture Sampling Tester\n" << std::endl;
+
+    int nFailed = checkTextureLayouts();
+    std::cout << "Layout check (odd sizes, both wrap modes, all filters): "
+              << (nFailed == 0 ? "ok" : "FAILED") << "\n" << std::endl;
+
+    // Checkerboard with gradients, so that neighbouring texels differ
+    const size_t size = 2048;
+    Film film(size, size);
+    for(size_t y = 0; y < size; y++)
+    {
+        for(size_t x = 0; x < size; x++)
+        {
+            double check = ((x / 16 + y / 16) % 2) ? 1.0 : 0.25;
+            film.setPixelValue(x, y, Vector3D(check * x / size, check * y / size, check));
+        }
+    }
+
+    // Lookups: scattered (uniform random) and coherent (the scanlines of a
+    // 1024x1024 screen showing the texture rotated by 60 degrees, one
+    // texel per pixel, which walks the texture diagonally)
+    const size_t nSamples = 1 << 20;
+    std::vector<float> scatteredU(nSamples), scatteredV(nSamples);
+    std::vector<float> coherentU(nSamples), coherentV(nSamples), lod(nSamples);
+    Philox rng(7);
+    rng.uniformFloatRow(0, 0, 0, scatteredU.data(), nSamples);
+    rng.uniformFloatRow(0, 0, 1, scatteredV.data(), nSamples);
+    rng.uniformFloatRow(0, 0, 2, lod.data(), nSamples);
+    for(size_t i = 0; i < nSamples; i++)
+    {
+        double x = (double)(i % 1024), y = (double)(i / 1024);
+        coherentU[i] = (float)((0.5 * x - 0.866 * y) / size + 0.5);
+        coherentV[i] = (float)((0.866 * x + 0.5 * y) / size);
+        lod[i] *= 4;
+    }
+
+    TextureSettings referenceSettings;
+    referenceSettings.layout = TextureLayout::RowMajor;
+    referenceSettings.format = TextureFormat::Float;
+    Texture reference(film, referenceSettings);
+    std::vector<float> expected(3 * nSamples), result(3 * nSamples);
+
+    const char *layoutNames[] = { "row-major", "tiled", "Morton" };
+    const char *formatNames[] = { "RGB8", "float" };
+    const char *filterNames[] = { "nearest", "bilinear", "trilinear" };
+    const char *patternNames[] = { "scattered", "coherent" };
+
+    for(int layout = 0; layout < 3; layout++)
+    {
+        for(int format = 0; format < 2; format++)
+        {
+            TextureSettings settings;
+            settings.layout = (TextureLayout)layout;
+            settings.format = (TextureFormat)format;
+            Texture texture(film, settings);
+
+            for(int filter = 0; filter < 3; filter++)
+            {
+                for(int pattern = 0; pattern < 2; pattern++)
+                {
+                    const float *u = pattern ? coherentU.data() : scatteredU.data();
+                    const float *v = pattern ? coherentV.data() : scatteredV.data();
+                    TextureFilter textureFilter = (TextureFilter)filter;
+
+                    // Best of three runs, split across the pool
+                    double best = 0;
+                    for(int run = 0; run < 3; run++)
+                    {
+                        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                        Parallel::forRange(0, nSamples, 4096, [&](size_t begin, size_t end)
+                        {
+                            texture.sample(u + begin, v + begin, lod.data() + begin, end - begin,
+                                           textureFilter, &result[3 * begin]);
+                        });
+                        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                        if(run == 0 || seconds < best)
+                            best = seconds;
+                    }
+
+                    // Quantization is the only accepted difference
+                    reference.sample(u, v, lod.data(), nSamples, textureFilter, expected.data());
+                    float maxError = 0;
+                    for(size_t i = 0; i < 3 * nSamples; i++)
+                        maxError = std::max(maxError, std::fabs(result[i] - expected[i]));
+                    bool ok = maxError <= (format == 0 ? 0.5f / 255.0f + 1e-5f : 1e-6f);
+
+                    double texels = (double)nSamples * Texture::getTexelsPerLookup(textureFilter);
+                    std::cout << layoutNames[layout] << " " << formatNames[format] << " "
+                              << filterNames[filter] << " " << patternNames[pattern] << ": "
+                              << texels / best * 1e-6 << " Mtexels/s ("
+                              << nSamples / best * 1e-6 << " Mlookups/s)"
+                              << (ok ? "" : " WRONG TEXELS") << std::endl;
+                }
+            }
+        }
+    }
+}
+
+// Best time of three runs of f
+static double bestOfThree(const std::function<void()> &f)
+{
+    double best = 0;
+    for(int run = 0; run < 3; run++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(run == 0 || seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+void Tester::testMatrixKernels()
+{
+    std::cout << "Matrix Kernels Tester (AVX2 " << (Simd::hasAvx2() ? "available" : "not available")
+              << ")\n" << std::endl;
+
+    // Random transforms (a general last row, so that points are projected)
+    // and points
+    const size_t nMatrices = 1 << 12, nPoints = 1 << 20;
+    Philox rng(11);
+    std::vector<Matrix4x4> matrices(nMatrices);
+    for(size_t k = 0; k < nMatrices; k++)
+        for(size_t lin = 0; lin < 4; lin++)
+            for(size_t col = 0; col < 4; col++)
+                matrices[k].data[lin][col] = rng.uniformDouble(k, (uint32_t)lin, (uint32_t)col) - 0.5;
+    Matrix4x4 affine = Matrix4x4::translate(Vector3D(1, 2, 3)) *
+                       Matrix4x4::rotate(0.7, Vector3D(1, 1, 0)) * Matrix4x4::scale(Vector3D(2, 1, 0.5));
+
+    std::vector<double> x(nPoints), y(nPoints), z(nPoints);
+    std::vector<float> xf(nPoints), yf(nPoints), zf(nPoints);
+    for(size_t i = 0; i < nPoints; i++)
+    {
+        x[i] = rng.uniformDouble(i, 0, 0) * 10 - 5;
+        y[i] = rng.uniformDouble(i, 0, 1) * 10 - 5;
+        z[i] = rng.uniformDouble(i, 0, 2) * 10 - 5;
+        xf[i] = (float)x[i];
+        yf[i] = (float)y[i];
+        zf[i] = (float)z[i];
+    }
+
+    // Products: operator* (scalar, inlined) against multiply(), one by one
+    // and in batches, on each path
+    const size_t nRounds = 1 << 10, nProducts = nRounds * nMatrices;
+    std::vector<Matrix4x4> rotated(nMatrices), expected(nMatrices), products(nMatrices);
+    for(size_t k = 0; k < nMatrices; k++)
+        rotated[k] = matrices[(k * 7 + 1) % nMatrices];
+    double operatorSeconds = bestOfThree([&]()
+    {
+        for(size_t round = 0; round < nRounds; round++)
+            for(size_t k = 0; k < nMatrices; k++)
+                expected[k] = matrices[k] * rotated[k];
+    });
+    bool productsOk = true;
+    double multiplySeconds[2], multiplyBatchSeconds[2];
+    for(int path = 0; path < 2; path++)
+    {
+        Simd::setEnabled(path == 1);
+        multiplySeconds[path] = bestOfThree([&]()
+        {
+            for(size_t round = 0; round < nRounds; round++)
+                for(size_t k = 0; k < nMatrices; k++)
+                    Matrix4x4::multiply(matrices[k], rotated[k], products[k]);
+        });
+        productsOk = productsOk && memcmp(expected.data(), products.data(),
+                                          nMatrices * sizeof(Matrix4x4)) == 0;
+        multiplyBatchSeconds[path] = bestOfThree([&]()
+        {
+            for(size_t round = 0; round < nRounds; round++)
+                Matrix4x4::multiply(matrices.data(), rotated.data(), nMatrices, products.data());
+        });
+        productsOk = productsOk && memcmp(expected.data(), products.data(),
+                                          nMatrices * sizeof(Matrix4x4)) == 0;
+    }
+    std::cout << "Products: operator* " << nProducts / operatorSeconds * 1e-6 << " M/s, multiply() "
+              << nProducts / multiplySeconds[0] * 1e-6 << " / " << nProducts / multiplySeconds[1] * 1e-6
+              << " M/s (scalar / vector), batch " << nProducts / multiplyBatchSeconds[0] * 1e-6 << " / "
+              << nProducts / multiplyBatchSeconds[1] * 1e-6 << " M/s" << (productsOk ? "" : " WRONG RESULTS")
+              << std::endl;
+
+    // Point transforms: transformPoint() one by one against the batch
+    // transforms, double and float
+    const Matrix4x4 *transforms[2] = { &affine, &matrices[0] };
+    const char *transformNames[2] = { "affine", "projective" };
+    for(int t = 0; t < 2; t++)
+    {
+        const Matrix4x4 &m = *transforms[t];
+        std::vector<double> ox(nPoints), oy(nPoints), oz(nPoints);
+        std::vector<double> bx(nPoints), by(nPoints), bz(nPoints);
+        double singleSeconds = bestOfThree([&]()
+        {
+            for(size_t i = 0; i < nPoints; i++)
+            {
+                // Same arithmetic as transformPoint(), without its warning
+                // for w = 0, which random matrices may trigger
+                Vector3D p = m.transformPoint(Vector3D(x[i], y[i], z[i]));
+                ox[i] = p.x;
+                oy[i] = p.y;
+                oz[i] = p.z;
+            }
+        });
+
+        bool pointsOk = true;
+        double batchSeconds[2], floatSeconds[2];
+        std::vector<float> fx[2], fy[2], fz[2];
+        Matrix4x4f mf(m);
+        for(int path = 0; path < 2; path++)
+        {
+            Simd::setEnabled(path == 1);
+            batchSeconds[path] = bestOfThree([&]()
+            {
+                m.transformPoints(x.data(), y.data(), z.data(), nPoints, bx.data(), by.data(), bz.data());
+            });
+            pointsOk = pointsOk && bx == ox && by == oy && bz == oz;
+
+            fx[path].resize(nPoints);
+            fy[path].resize(nPoints);
+            fz[path].resize(nPoints);
+            floatSeconds[path] = bestOfThree([&]()
+            {
+                mf.transformPoints(xf.data(), yf.data(), zf.data(), nPoints,
+                                   fx[path].data(), fy[path].data(), fz[path].data());
+            });
+        }
+        pointsOk = pointsOk && fx[0] == fx[1] && fy[0] == fy[1] && fz[0] == fz[1];
+
+        std::cout << "Points (" << transformNames[t] << "): transformPoint() "
+                  << nPoints / singleSeconds * 1e-6 << " M/s, batch "
+                  << nPoints / batchSeconds[0] * 1e-6 << " M/s (scalar), "
+                  << nPoints / batchSeconds[1] * 1e-6 << " M/s (vector), float batch "
+                  << nPoints / floatSeconds[0] * 1e-6 << " M/s (scalar), "
+                  << nPoints / floatSeconds[1] * 1e-6 << " M/s (vector)"
+                  << (pointsOk ? "" : " WRONG RESULTS") << std::endl;
+    }
+
+    // Vectors and normals against transformVector() and the transposed
+    // matrix, in place
+    std::vector<double> vx = x, vy = y, vz = z;
+    affine.transformNormals(vx.data(), vy.data(), vz.data(), nPoints, vx.data(), vy.data(), vz.data());
+    bool normalsOk = true;
+    Matrix4x4 transposed = affine.transposed();
+    for(size_t i = 0; i < nPoints; i++)
+    {
+        Vector3D n = transposed.transformVector(Vector3D(x[i], y[i], z[i]));
+        normalsOk = normalsOk && n.x == vx[i] && n.y == vy[i] && n.z == vz[i];
+    }
+    std::cout << "Normals (in place): " << (normalsOk ? "OK" : "WRONG RESULTS") << std::endl;
+
+    Simd::setEnabled(true);
+}
+
+void Tester::testOcclusionQueries()
+{
+    std::cout << "Occlusion Queries Tester\n" << std::endl;
+
+    // Spheres scattered in a box, and rays aimed close to them from
+    // anywhere in the box
+    Philox rng(17);
+    const size_t nSpheres = 12, nRays = 10000; // Not a whole number of packets
+    std::vector<std::unique_ptr<Sphere>> spheres;
+    std::vector<Shape*> objects;
+    for(size_t k = 0; k < nSpheres; k++)
+    {
+        Vector3D center(rng.uniformDouble(k, 0, 0) * 8 - 4, rng.uniformDouble(k, 0, 1) * 8 - 4,
+                        rng.uniformDouble(k, 0, 2) * 8 - 4);
+        double radius = 0.3 + rng.uniformDouble(k, 0, 3);
+        spheres.push_back(std::unique_ptr<Sphere>(new Sphere(radius, Matrix4x4::translate(center))));
+        objects.push_back(spheres.back().get());
+    }
+
+    // Ranges: the whole ray, only up to a distance, only from a distance,
+    // and a segment in between, so that many hits fall outside [minT, maxT]
+    std::vector<Ray> rays(nRays);
+    for(size_t i = 0; i < nRays; i++)
+    {
+        Vector3D origin(rng.uniformDouble(i, 1, 0) * 10 - 5, rng.uniformDouble(i, 1, 1) * 10 - 5,
+                        rng.uniformDouble(i, 1, 2) * 10 - 5);
+        Vector3D target(rng.uniformDouble(i, 1, 3) * 8 - 4, rng.uniformDouble(i, 1, 4) * 8 - 4,
+                        rng.uniformDouble(i, 1, 5) * 8 - 4);
+        rays[i] = Ray(origin, (target - origin).normalized());
+        double t0 = rng.uniformDouble(i, 1, 6) * 8, t1 = t0 + rng.uniformDouble(i, 1, 7) * 4;
+        switch(i % 4)
+        {
+        case 1: rays[i].maxT = t0; break;
+        case 2: rays[i].minT = t0; break;
+        case 3: rays[i].minT = t0; rays[i].maxT = t1; break;
+        default: break;
+        }
+    }
+
+    // Batch query of the whole scene against one scalar query per ray
+    std::vector<uint8_t> expected(nRays);
+    size_t nOccluded = 0, nOutOfRange = 0;
+    for(size_t i = 0; i < nRays; i++)
+    {
+        expected[i] = Utils::hasIntersection(rays[i], objects);
+        Ray unbounded(rays[i].o, rays[i].d, 0, 0, INFINITY);
+        nOccluded += expected[i];
+        nOutOfRange += !expected[i] && Utils::hasIntersection(unbounded, objects);
+    }
+    std::unique_ptr<bool[]> occluded(new bool[nRays]);
+    Utils::hasIntersection(rays.data(), nRays, objects, occluded.get());
+    size_t nWrong = 0;
+    for(size_t i = 0; i < nRays; i++)
+        nWrong += occluded[i] != (expected[i] != 0);
+    std::cout << "Scene batch: " << nOccluded << " occluded, " << nOutOfRange
+              << " with hits only outside [minT, maxT], " << nWrong << " differences"
+              << (nWrong == 0 && nOutOfRange > 0 ? "" : " WRONG RESULTS") << std::endl;
+
+    // Sphere batch on a subset of the rays: the active rays that hit are
+    // flagged, the others stay active in their order, and the inactive
+    // rays are left alone
+    nWrong = 0;
+    for(size_t k = 0; k < nSpheres; k++)
+    {
+        std::vector<uint32_t> active;
+        for(uint32_t i = (uint32_t)(k % 2); i < nRays; i += 2)
+            active.push_back(i);
+        std::vector<uint32_t> expectedLeft;
+        for(size_t i = 0; i < nRays; i++)
+            occluded[i] = false;
+        for(size_t a = 0; a < active.size(); a++)
+        {
+            if(!spheres[k]->rayIntersectP(rays[active[a]]))
+                expectedLeft.push_back(active[a]);
+        }
+
+        size_t nLeft = spheres[k]->rayIntersectP(rays.data(), active.data(), active.size(),
+                                                 occluded.get());
+        active.resize(nLeft);
+        nWrong += active != expectedLeft;
+        for(size_t i = 0; i < nRays; i++)
+        {
+            bool hit = i % 2 == k % 2 && spheres[k]->rayIntersectP(rays[i]);
+            nWrong += occluded[i] != hit;
+        }
+    }
+    std::cout << "Sphere batch: " << nWrong << " differences" << (nWrong == 0 ? "" : " WRONG RESULTS")
+              << std::endl;
+}
+
+void Tester::testIterativeFilter()
+{
+    std::cout << "Iterative Filter Tester\n" << std::endl;
+
+    // Kernels: odd and even sizes, off-center and asymmetric weights, and
+    // a single row (no halo)
+    std::vector<Kernel> kernels;
+    kernels.push_back(Kernel::box(1));
+    kernels.push_back(Kernel::box(4));
+    kernels.push_back(Kernel::disk(2.5));
+    Philox rng(5);
+    size_t shapes[3][2] = { { 4, 2 }, { 2, 7 }, { 5, 1 } };
+    for(size_t k = 0; k < 3; k++)
+    {
+        Kernel kernel(shapes[k][0], shapes[k][1]);
+        for(size_t j = 0; j < shapes[k][1]; j++)
+            for(size_t i = 0; i < shapes[k][0]; i++)
+                kernel.setWeight(i, j, rng.uniformDouble((uint32_t)k, (uint32_t)j, (uint32_t)i) + 0.1);
+        kernel.normalize();
+        kernels.push_back(kernel);
+    }
+
+    // Every combination of film size, band height, fusion depth and
+    // iteration count must match the unfused loop bit by bit
+    size_t sizes[6][2] = { { 1, 1 }, { 7, 1 }, { 1, 9 }, { 37, 23 }, { 64, 64 }, { 128, 5 } };
+    size_t bandHeights[5] = { 0, 1, 3, 17, 1000 };
+    size_t fusedIterations[6] = { 0, 1, 2, 3, 5, 16 };
+    size_t iterationCounts[3] = { 1, 4, 7 };
+    size_t nRuns = 0, nFailed = 0;
+    for(size_t k = 0; k < kernels.size(); k++)
+    {
+        IterativeFilter filter(kernels[k]);
+        for(size_t s = 0; s < 6; s++)
+        {
+            size_t width = sizes[s][0], height = sizes[s][1];
+            Film input(width, height);
+            for(size_t y = 0; y < height; y++)
+                for(size_t x = 0; x < width; x++)
+                    input.getRow(y)[x] = Vector3D(rng.uniformDouble((uint32_t)x, (uint32_t)y, 0),
+                                                  rng.uniformDouble((uint32_t)x, (uint32_t)y, 1),
+                                                  rng.uniformDouble((uint32_t)x, (uint32_t)y, 2));
+
+            for(size_t n = 0; n < 3; n++)
+            {
+                Film reference(width, height);
+                for(size_t y = 0; y < height; y++)
+                    std::memcpy(reference.getRow(y), input.getRow(y), width * sizeof(Vector3D));
+                filter.applyReference(reference, iterationCounts[n]);
+
+                for(size_t b = 0; b < 5; b++)
+                {
+                    for(size_t f = 0; f < 6; f++)
+                    {
+                        IterativeFilterSettings settings;
+                        settings.iterations = iterationCounts[n];
+                        settings.bandHeight = bandHeights[b];
+                        settings.fusedIterations = fusedIterations[f];
+                        Film fused(width, height);
+                        for(size_t y = 0; y < height; y++)
+                            std::memcpy(fused.getRow(y), input.getRow(y), width * sizeof(Vector3D));
+                        filter.apply(fused, settings);
+
+                        bool same = true;
+                        for(size_t y = 0; y < height && same; y++)
+                            same = std::memcmp(fused.getRow(y), reference.getRow(y),
+                                               width * sizeof(Vector3D)) == 0;
+                        nRuns++;
+                        if(!same)
+                        {
+                            nFailed++;
+                            std::cout << "Kernel " << kernels[k].getWidth() << "x"
+                                      << kernels[k].getHeight() << ", film " << width << "x"
+                                      << height << ", " << iterationCounts[n] << " iterations, band "
+                                      << bandHeights[b] << ", fused " << fusedIterations[f]
+                                      << ": DIFFERENT RESULTS" << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    std::cout << "Fused against unfused: " << nRuns - nFailed << "/" << nRuns << " configurations match"
+              << std::endl;
+
+    // Automatic settings on the 9x9 box of --iterate: they should fuse
+    IterativeFilter box(Kernel::box(4));
+    Film film(512, 512);
+    IterativeFilterSettings settings;
+    IterativeFilterStats stats;
+    box.apply(film, settings, &stats);
+    std::cout << "Automatic settings (512x512, 9x9 box): " << stats.fusedIterations
+              << " fused iterations, bands of " << stats.bandHeight << " rows"
+              << (stats.fusedIterations > 1 ? "" : " NOT FUSED") << std::endl;
+}
+
+// Reference scenes of the regression harness: small images that exercise
+// the main rendering paths
+struct RegressionScene
+{
+    std::string name;
+    size_t width, height;
+    std::function<void(Film &)> render;
+    // Scene whose golden image this one must match (a faster path to the
+    // same pixels), or empty for a golden image of its own
+    std::string golden;
+
+
+    RegressionScene(const std::string &name_, size_t width_, size_t height_,
+                    const std::function<void(Film &)> &render_,
+                    const std::string &golden_ = std::string())
+        : name(name_), width(width_), height(height_), render(render_), golden(golden_)
+    { }
+};
+
+static std::vector<RegressionScene> getRegressionScenes()
+{
+    std::vector<RegressionScene> scenes;
+    const size_t res = 128;
+
+    scenes.push_back({ "ortographic_sphere", res, res, [=](Film &film)
+    {
+        Sphere sphere(1.0, Matrix4x4::translate(Vector3D(0.2, -0.1, 3)));
+        std::vector<Shape*> objects(1, &sphere);
+        OrtographicCamera camera(Matrix4x4(), res, res);
+        Renderer(camera, objects).render(film, 16);
+    } });
+
+    scenes.push_back({ "perspective_spheres_16spp", res, res, [=](Film &film)
+    {
+        Sphere near(0.6, Matrix4x4::translate(Vector3D(-0.5, 0, 2.5)));
+        Sphere far(1.0, Matrix4x4::translate(Vector3D(0.8, 0.4, 5)));
+        std::vector<Shape*> objects;
+        objects.push_back(&near);
+        objects.push_back(&far);
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), res, res);
+        Renderer renderer(camera, objects);
+        renderer.setSeed(7);
+        renderer.renderSamples(film, 16, nullptr, 16);
+    } });
+
+    scenes.push_back({ "wavefront_glass_mirror", res, res, [=](Film &film)
+    {
+        Sphere glass(0.8, Matrix4x4::translate(Vector3D(0, 0, 3)));
+        Sphere mirror(1.2, Matrix4x4::translate(Vector3D(0.5, 0.3, 6)));
+        Sphere red(0.6, Matrix4x4::translate(Vector3D(-1.4, -0.4, 4)));
+        glass.setMaterial(Material(Vector3D(1, 1, 1), 0, 0.95, 1.5));
+        mirror.setMaterial(Material(Vector3D(1, 1, 1), 0.9));
+        red.setMaterial(Material(Vector3D(1, 0.2, 0.2)));
+        std::vector<Shape*> objects;
+        objects.push_back(&glass);
+        objects.push_back(&mirror);
+        objects.push_back(&red);
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), res, res);
+        WavefrontSettings settings;
+        settings.background = Vector3D(0.1, 0.1, 0.15);
+        WavefrontRenderer(camera, objects, settings).render(film);
+    } });
+
+    scenes.push_back({ "progressive_preview_8", res, res, [=](Film &film)
+    {
+        Sphere sphere(1.0, Matrix4x4::translate(Vector3D(0, 0, 3)));
+        std::vector<Shape*> objects(1, &sphere);
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), res, res);
+        Renderer renderer(camera, objects);
+
+        // Keep the (bilinear) preview of the coarse level
+        ProgressiveSettings settings;
+        settings.strides.assign(1, 8);
+        Film full(res, res);
+        ProgressiveRenderer(renderer, settings).render(full, [&](const Film &preview, size_t stride)
+        {
+            if(stride != 8)
+                return;
+            for(size_t row = 0; row < res; row++)
+                std::copy(preview.getRow(row), preview.getRow(row) + res, film.getRow(row));
+        });
+    } });
+
+    // A row of overlapping spheres that leave the frame on both sides,
+    // traced against every shape for every pixel, then through the two
+    // ways of narrowing the candidates, which must give the same image.
+    // The size is not a multiple of the tile size
+    std::function<void(Renderer &, Film &)> renderSpheres = [](Renderer &renderer, Film &film)
+    {
+        renderer.render(film, 16);
+    };
+    auto sphereRow = [](std::vector<Sphere> &spheres)
+    {
+        for(int k = 0; k < 9; k++)
+        {
+            double z = 3 + 0.8 * (k % 3);
+            spheres.push_back(Sphere(0.45 + 0.1 * (k % 2),
+                                     Matrix4x4::translate(Vector3D(-2.6 + 0.65 * k, 0.3 * (k % 4) - 0.45, z))));
+        }
+    };
+    const size_t rowWidth = 150, rowHeight = 100;
+    scenes.push_back({ "spheres_brute_force", rowWidth, rowHeight, [=](Film &film)
+    {
+        std::vector<Sphere> spheres;
+        sphereRow(spheres);
+        std::vector<Shape*> objects;
+        for(size_t k = 0; k < spheres.size(); k++)
+            objects.push_back(&spheres[k]);
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), rowWidth, rowHeight);
+        Renderer renderer(camera, objects);
+        renderer.setFrustumCulling(false);
+        renderSpheres(renderer, film);
+    } });
+
+    scenes.push_back({ "spheres_frustum_culling", rowWidth, rowHeight, [=](Film &film)
+    {
+        std::vector<Sphere> spheres;
+        sphereRow(spheres);
+        std::vector<Shape*> objects;
+        for(size_t k = 0; k < spheres.size(); k++)
+            objects.push_back(&spheres[k]);
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), rowWidth, rowHeight);
+        Renderer renderer(camera, objects);
+        renderer.setFrustumCulling(true);
+        renderSpheres(renderer, film);
+    }, "spheres_brute_force" });
+
+    scenes.push_back({ "spheres_visibility_buffer", rowWidth, rowHeight, [=](Film &film)
+    {
+        std::vector<Sphere> spheres;
+        sphereRow(spheres);
+        std::vector<Shape*> objects;
+        for(size_t k = 0; k < spheres.size(); k++)
+            objects.push_back(&spheres[k]);
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), rowWidth, rowHeight);
+        Renderer renderer(camera, objects);
+        renderer.setFrustumCulling(false);
+        renderer.setRasterizedVisibility(true);
+        renderSpheres(renderer, film);
+    }, "spheres_brute_force" });
+
+    scenes.push_back({ "cropped_sphere", 80, 48, [=](Film &film)
+    {
+        Sphere sphere(1.0, Matrix4x4::translate(Vector3D(0, 0, 3)));
+        std::vector<Shape*> objects(1, &sphere);
+        PerspectiveCamera camera(Matrix4x4(), Utils::degreesToRadians(60), res, res);
+        Renderer renderer(camera, objects);
+        renderer.setCropWindow(CropWindow(30, 20, 110, 68));
+        renderer.render(film);
+    } });
+
+    return scenes;
+}
+
+static std::map<std::string, double> readBudgets(const std::string &fileName)
+{
+    std::map<std::string, double> budgets;
+    std::ifstream inputFile(fileName);
+    std::string line;
+    while(std::getline(inputFile, line))
+    {
+        std::istringstream fields(line);
+        std::string name;
+        double seconds;
+        if(line.empty() || line[0] == '#' || !(fields >> name >> seconds))
+            continue;
+        budgets[name] = seconds;
+    }
+    return budgets;
+}
+
+int Tester::runRegressionTests(const RegressionSettings &settings)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::cout << "Regression Tester (" << (settings.update ? "recording" : "checking")
+              << " \"" << settings.goldenDir << "\")\n" << std::endl;
+
+    std::string budgetsFile = settings.goldenDir + "/budgets.txt";
+    std::map<std::string, double> budgets = readBudgets(budgetsFile);
+    std::vector<RegressionScene> scenes = getRegressionScenes();
+    int nFailed = 0;
+
+    for(size_t s = 0; s < scenes.size(); s++)
+    {
+        const RegressionScene &scene = scenes[s];
+        Film film(scene.width, scene.height);
+
+        // Time per render: each run renders the scene repeatedly for at
+        // least minTimingTime seconds, and the best run is kept
+        double seconds = INFINITY;
+        for(size_t run = 0; run < std::max<size_t>(settings.timingRuns, 1); run++)
+        {
+            Clock::time_point start = Clock::now();
+            size_t nRenders = 0;
+            double elapsed = 0;
+            do
+            {
+                scene.render(film);
+                nRenders++;
+                elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            }
+            while(elapsed < settings.minTimingTime);
+            seconds = std::min(seconds, elapsed / nRenders);
+        }
+
+        std::vector<uint8_t> image;
+        ToneMapper().toBGR8(film, image, 4, true);
+        std::string golden = settings.goldenDir + "/" +
+                             (scene.golden.empty() ? scene.name : scene.golden);
+
+        if(settings.update)
+        {
+            // Scenes checked against another one only record their budget
+            bool ok = !scene.golden.empty() ||
+                      BitMap::save(image, scene.width, scene.height, golden) == 0;
+            budgets[scene.name] = seconds;
+            std::cout << "  " << scene.name << ": " << (ok ? "recorded" : "could not be recorded")
+                      << " (" << seconds << " s)" << std::endl;
+            nFailed += ok ? 0 : 1;
+            continue;
+        }
+
+        std::ostringstream report;
+        bool passed = true;
+
+        std::vector<uint8_t> reference;
+        size_t width, height;
+        if(BitMap::readBGR(reference, width, height, golden) != 0)
+        {
+            report << "no golden image";
+            passed = false;
+        }
+        else if(width != scene.width || height != scene.height)
+        {
+            report << "golden is " << width << "x" << height;
+            passed = false;
+        }
+        else
+        {
+            double psnr = computePsnr(image, reference, width, height);
+            int maxError = computeMaxAbsError(image, reference, width, height);
+            report << "PSNR " << psnr << " dB, max error " << maxError;
+            passed = psnr >= settings.minPsnr && maxError <= settings.maxAbsError;
+        }
+
+        std::map<std::string, double>::const_iterator budget = budgets.find(scene.name);
+        report << ", " << seconds << " s";
+        if(budget != budgets.end())
+        {
+            double limit = budget->second * (1 + settings.timeTolerance);
+            report << " (limit " << limit << " s)";
+            if(seconds > limit)
+                passed = false;
+        }
+        else
+        {
+            report << " (no budget)";
+        }
+
+        if(!passed)
+        {
+            nFailed++;
+            film.save("regression " + scene.name);
+        }
+        std::cout << "  " << (passed ? "PASS " : "FAIL ") << scene.name << ": "
+                  << report.str() << std::endl;
+    }
+
+    if(settings.update)
+    {
+        std::ofstream outputFile(budgetsFile);
+        outputFile << "# Render time of each scene, in seconds: best of " << settings.timingRuns
+                   << " runs of at least " << settings.minTimingTime << " s of repeated renders\n";
+        for(std::map<std::string, double>::const_iterator it = budgets.begin(); it != budgets.end(); ++it)
+            outputFile << it->first << " " << it->second << "\n";
+    }
+
+    std::cout << "\n" << scenes.size() - nFailed << "/" << scenes.size() << " scenes passed" << std::endl;
+    return nFailed;
+}
+
+double Tester::computePsnr(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b,
+                           size_t width, size_t height)
+{
+    size_t stride = (width * 3 + 3) / 4 * 4;
+    double sumSq = 0;
+    for(size_t row = 0; row < height; row++)
+    {
+        for(size_t i = row * stride; i < row * stride + width * 3; i++)
+        {
+            double d = (double)a[i] - (double)b[i];
+            sumSq += d * d;
+        }
+    }
+
+    double mse = sumSq / std::max<size_t>(width * height * 3, 1);
+    return mse == 0 ? INFINITY : 10 * std::log10(255.0 * 255.0 / mse);
+}
+
+int Tester::computeMaxAbsError(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b,
+                               size_t width, size_t height)
+{
+    size_t stride = (width * 3 + 3) / 4 * 4;
+    int maxError = 0;
+    for(size_t row = 0; row < height; row++)
+    {
+        for(size_t i = row * stride; i < row * stride + width * 3; i++)
+        {
+            maxError = std::max(maxError, std::abs((int)a[i] - (int)b[i]));
+        }
+    }
+    return maxError;
 }
@@ -1,14 +1,69 @@
 #ifndef TESTER_H
 #define TESTER_H
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 #include "matrix4x4.h"
 
+/**
+ * @brief The RegressionSettings struct
+ */
+struct RegressionSettings
+{
+    std::string goldenDir; // Golden images (<scene>.bmp) and budgets.txt
+    bool update;           // Record the current images and times instead
+    double minPsnr;        // Lowest PSNR (dB) accepted against the golden
+    int maxAbsError;       // Largest accepted channel error (8-bit units)
+    double timeTolerance;  // Accepted slowdown over the budget (1 = 100%)
+    double minTimingTime;  // A timing run repeats the render for at least
+                           //  this many seconds, so that short scenes are
+                           //  not lost in the timer noise
+    size_t timingRuns;     // Each scene is timed as the best of these runs
+
+    RegressionSettings() : goldenDir("output/golden"), update(false), minPsnr(40),
+                           maxAbsError(16), timeTolerance(1.0), minTimingTime(0.1),
+                           timingRuns(5)
+    { }
+};
+
 class Tester
 {
 public:
     Tester();
 
     static void testMatrixClass();
+    static void testRandomGenerator();
+    static void testMemoryArena();
+    // Texture lookups: checks that every layout and format returns the
+    // texels of the row-major float texture, and prints texels fetched
+    // per second for scattered and coherent lookups
+    static void testTextureSampling();
+    // Matrix kernels: checks that the vector paths (when the CPU has them)
+    // match the scalar ones bit by bit, and prints their throughput
+    static void testMatrixKernels();
+    // Iterative filter: checks that the fused (temporal blocking) path
+    // matches the unfused loop bit by bit over film sizes, kernels, band
+    // heights and fusion depths
+    static void testIterativeFilter();
+    // Occlusion queries: checks the batch forms of Utils::hasIntersection
+    // and Sphere::rayIntersectP against the scalar ones, with rays whose
+    // hits fall inside and outside [minT, maxT]
+    static void testOcclusionQueries();
+
+    // Renders the reference scenes and compares them with their golden
+    // images (quality) and budgets (time). Needs no display. Returns the
+    // number of failed scenes; failing images are saved as
+    // "regression <scene>.bmp" in the working directory
+    static int runRegressionTests(const RegressionSettings &settings = RegressionSettings());
+
+    // Metrics between two images in the layout of ToneMapper::toBGR8 (row
+    // padding is ignored)
+    static double computePsnr(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b,
+                              size_t width, size_t height);
+    static int computeMaxAbsError(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b,
+                                  size_t width, size_t height);
 };
 
 #endif // TESTER_H
@@ -0,0 +1,326 @@
+#include "tiledfilm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+#include "bitmap.h"
+#include "parallel.h"
+
+TiledFilm::TiledFilm(size_t width_, size_t height_, const std::string &backingFile_,
+                     size_t tileSize_, size_t maxResidentTiles_)
+    : width(width_), height(height_), tileSize(std::max<size_t>(tileSize_, 1)),
+      maxResidentTiles(std::max<size_t>(maxResidentTiles_, 1)), backingFile(backingFile_)
+{
+    tilesX = (width  + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+
+    // Every tile gets a full tileSize x tileSize slot. Sizing the file by
+    // writing its last byte leaves it sparse (and zero) where supported
+    file.open(backingFile.c_str(), std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    size_t fileSize = tilesX * tilesY * tileSize * tileSize * sizeof(Vector3D);
+    if(file.is_open() && fileSize > 0)
+    {
+        file.seekp((std::streamoff)(fileSize - 1));
+        file.put('\0');
+        file.flush();
+    }
+
+    if(!isOpen())
+    {
+        std::cout << "Problem at TiledFilm::TiledFilm() : Could not create backing file \""
+                  << backingFile << "\"" << std::endl;
+    }
+}
+
+TiledFilm::~TiledFilm()
+{
+    file.close();
+    std::remove(backingFile.c_str());
+}
+
+bool TiledFilm::isOpen() const
+{
+    return file.is_open() && !file.fail();
+}
+
+size_t TiledFilm::getWidth() const
+{
+    return width;
+}
+
+size_t TiledFilm::getHeight() const
+{
+    return height;
+}
+
+size_t TiledFilm::getTileSize() const
+{
+    return tileSize;
+}
+
+size_t TiledFilm::getTilesX() const
+{
+    return tilesX;
+}
+
+size_t TiledFilm::getTilesY() const
+{
+    return tilesY;
+}
+
+TiledFilmStats TiledFilm::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+Vector3D TiledFilm::getPixelValue(size_t w, size_t h)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    CachedTile &tile = fetchTile((h / tileSize) * tilesX + w / tileSize);
+    return tile.pixels[(h % tileSize) * tileSize + w % tileSize];
+}
+
+void TiledFilm::setPixelValue(size_t w, size_t h, const Vector3D &value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    CachedTile &tile = fetchTile((h / tileSize) * tilesX + w / tileSize);
+    tile.pixels[(h % tileSize) * tileSize + w % tileSize] = value;
+    tile.dirty = true;
+}
+
+void TiledFilm::writeTile(size_t tx, size_t ty, const Vector3D *pixels)
+{
+    size_t tileWidth  = std::min(tileSize, width  - tx * tileSize);
+    size_t tileHeight = std::min(tileSize, height - ty * tileSize);
+    size_t tileIndex  = ty * tilesX + tx;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::unordered_map<size_t, CachedTile>::iterator cached = cache.find(tileIndex);
+    if(cached != cache.end())
+    {
+        for(size_t row = 0; row < tileHeight; row++)
+        {
+            std::copy(pixels + row * tileWidth, pixels + (row + 1) * tileWidth,
+                      cached->second.pixels.begin() + row * tileSize);
+        }
+        cached->second.dirty = true;
+        return;
+    }
+
+    // Not resident: straight to the file (one write if the rows are
+    // contiguous in the slot, i.e., the tile is not clipped horizontally)
+    std::streamoff slot = (std::streamoff)(tileIndex * tileSize * tileSize * sizeof(Vector3D));
+    if(tileWidth == tileSize)
+    {
+        file.seekp(slot);
+        file.write(reinterpret_cast<const char *>(pixels), tileHeight * tileSize * sizeof(Vector3D));
+    }
+    else
+    {
+        for(size_t row = 0; row < tileHeight; row++)
+        {
+            file.seekp(slot + (std::streamoff)(row * tileSize * sizeof(Vector3D)));
+            file.write(reinterpret_cast<const char *>(pixels + row * tileWidth),
+                       tileWidth * sizeof(Vector3D));
+        }
+    }
+    stats.tileStores++;
+}
+
+void TiledFilm::readTile(size_t tx, size_t ty, Vector3D *pixels)
+{
+    size_t tileWidth  = std::min(tileSize, width  - tx * tileSize);
+    size_t tileHeight = std::min(tileSize, height - ty * tileSize);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    const CachedTile &tile = fetchTile(ty * tilesX + tx);
+    for(size_t row = 0; row < tileHeight; row++)
+    {
+        std::copy(tile.pixels.begin() + row * tileSize,
+                  tile.pixels.begin() + row * tileSize + tileWidth,
+                  pixels + row * tileWidth);
+    }
+}
+
+void TiledFilm::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for(std::unordered_map<size_t, CachedTile>::iterator it = cache.begin(); it != cache.end(); ++it)
+    {
+        if(it->second.dirty)
+        {
+            storeTile(it->first, it->second.pixels.data());
+            it->second.dirty = false;
+        }
+    }
+    file.flush();
+}
+
+TiledFilm::CachedTile &TiledFilm::fetchTile(size_t tileIndex)
+{
+    std::unordered_map<size_t, CachedTile>::iterator cached = cache.find(tileIndex);
+    if(cached != cache.end())
+    {
+        lru.splice(lru.begin(), lru, cached->second.lruPosition);
+        return cached->second;
+    }
+
+    // Make room, writing back the least recently used tile if needed
+    while(cache.size() >= maxResidentTiles)
+    {
+        size_t victim = lru.back();
+        CachedTile &evicted = cache[victim];
+        if(evicted.dirty)
+            storeTile(victim, evicted.pixels.data());
+        cache.erase(victim);
+        lru.pop_back();
+        stats.evictions++;
+    }
+
+    lru.push_front(tileIndex);
+    CachedTile &tile = cache[tileIndex];
+    tile.pixels.resize(tileSize * tileSize);
+    tile.dirty = false;
+    tile.lruPosition = lru.begin();
+    loadTile(tileIndex, tile.pixels.data());
+
+    stats.peakResident = std::max(stats.peakResident, cache.size());
+    return tile;
+}
+
+void TiledFilm::loadTile(size_t tileIndex, Vector3D *pixels)
+{
+    file.seekg((std::streamoff)(tileIndex * tileSize * tileSize * sizeof(Vector3D)));
+    file.read(reinterpret_cast<char *>(pixels), tileSize * tileSize * sizeof(Vector3D));
+    stats.tileLoads++;
+}
+
+void TiledFilm::storeTile(size_t tileIndex, const Vector3D *pixels)
+{
+    file.seekp((std::streamoff)(tileIndex * tileSize * tileSize * sizeof(Vector3D)));
+    file.write(reinterpret_cast<const char *>(pixels), tileSize * tileSize * sizeof(Vector3D));
+    stats.tileStores++;
+}
+
+void TiledFilm::readBand(size_t ty, std::vector<Vector3D> &band, std::vector<Vector3D> &tile)
+{
+    size_t bandHeight = std::min(tileSize, height - ty * tileSize);
+    band.resize(bandHeight * width);
+    tile.resize(tileSize * tileSize);
+
+    for(size_t tx = 0; tx < tilesX; tx++)
+    {
+        // Cached tiles may be newer than the file; the rest are read
+        // without entering the cache, so writing does not evict anything
+        size_t tileIndex = ty * tilesX + tx;
+        std::unordered_map<size_t, CachedTile>::iterator cached = cache.find(tileIndex);
+        const Vector3D *pixels = tile.data();
+        if(cached != cache.end())
+            pixels = cached->second.pixels.data();
+        else
+            loadTile(tileIndex, tile.data());
+
+        size_t x0 = tx * tileSize;
+        size_t tileWidth = std::min(tileSize, width - x0);
+        for(size_t row = 0; row < bandHeight; row++)
+        {
+            std::copy(pixels + row * tileSize, pixels + row * tileSize + tileWidth,
+                      band.begin() + row * width + x0);
+        }
+    }
+}
+
+int TiledFilm::save(std::string name, const ToneMapSettings &settings)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::ofstream outputFile;
+    outputFile.open(name+".bmp", std::ios::binary | std::ios::out);
+    if(!outputFile.is_open())
+    {
+        std::cout << "Problem at TiledFilm::save() : Could not open file \""
+                  << name << ".bmp" << "\"" << std::endl;
+        return 1;
+    }
+
+    // Headers. The image size field does not fit 32 bits for the largest
+    // images; 0 is valid there for uncompressed bitmaps
+    size_t stride = ToneMapper::getRowStride(width, 4);
+    bmp24_file_header fileHeader;
+    bmp24_info_header infoHeader(width, height);
+    uint64_t imageSize = (uint64_t)stride * height;
+    infoHeader.size_image = imageSize <= 0x7fffffff ? (int32_t)imageSize : 0;
+
+    char *fileBlock = fileHeader.toCharBlock();
+    outputFile.write(fileBlock, 14);
+    free(fileBlock);
+    char *infoBlock = infoHeader.toCharBlock();
+    outputFile.write(infoBlock, 40);
+    free(infoBlock);
+
+    // Bottom-up: bands from the last one, rows from the last one
+    ToneMapper toneMapper(settings);
+    std::vector<Vector3D> band, tile;
+    std::vector<uint8_t> bytes;
+    for(size_t ty = tilesY; ty-- > 0; )
+    {
+        readBand(ty, band, tile);
+        size_t bandHeight = band.size() / std::max<size_t>(width, 1);
+        bytes.assign(bandHeight * stride, 0);
+
+        Parallel::forRange(0, bandHeight, 8, [&](size_t begin, size_t end)
+        {
+            std::vector<float> scratch(width * 3);
+            for(size_t row = begin; row < end; row++)
+            {
+                toneMapper.toneMapRow(&band[row * width], width, ty * tileSize + row,
+                                      scratch.data(), &bytes[(bandHeight - 1 - row) * stride]);
+            }
+        });
+        outputFile.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+
+    return outputFile.good() ? 0 : 1;
+}
+
+int TiledFilm::savePfm(std::string name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::ofstream outputFile;
+    outputFile.open(name+".pfm", std::ios::binary | std::ios::out);
+    if(!outputFile.is_open())
+    {
+        std::cout << "Problem at TiledFilm::savePfm() : Could not open file \""
+                  << name << ".pfm" << "\"" << std::endl;
+        return 1;
+    }
+
+    // Portable float map: a negative scale means little-endian floats, and
+    // rows are stored bottom-up
+    outputFile << "PF\n" << width << " " << height << "\n-1.0\n";
+
+    std::vector<Vector3D> band, tile;
+    std::vector<float> row(width * 3);
+    for(size_t ty = tilesY; ty-- > 0; )
+    {
+        readBand(ty, band, tile);
+        size_t bandHeight = band.size() / std::max<size_t>(width, 1);
+        for(size_t r = bandHeight; r-- > 0; )
+        {
+            const Vector3D *pixels = &band[r * width];
+            for(size_t i = 0; i < width; i++)
+            {
+                row[3*i]   = (float)pixels[i].x;
+                row[3*i+1] = (float)pixels[i].y;
+                row[3*i+2] = (float)pixels[i].z;
+            }
+            outputFile.write(reinterpret_cast<const char *>(row.data()), row.size() * sizeof(float));
+        }
+    }
+
+    return outputFile.good() ? 0 : 1;
+}
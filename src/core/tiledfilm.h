@@ -0,0 +1,112 @@
+#ifndef TILEDFILM_H
+#define TILEDFILM_H
+
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vector3d.h"
+#include "tonemapper.h"
+
+/**
+ * @brief The TiledFilmStats struct
+ */
+struct TiledFilmStats
+{
+    size_t tileLoads;     // Tiles read from the backing file
+    size_t tileStores;    // Tiles written to the backing file
+    size_t evictions;
+    size_t peakResident;  // Largest number of tiles held in memory at once
+
+    TiledFilmStats() : tileLoads(0), tileStores(0), evictions(0), peakResident(0)
+    { }
+};
+
+/**
+ * @brief The TiledFilm class
+ *
+ * Out-of-core film for images that do not fit in memory. Pixels live in a
+ * backing file, split in square tiles of tileSize x tileSize pixels (each
+ * tile is a contiguous block of the file), and at most maxResidentTiles of
+ * them are kept in memory, in a least-recently-used cache. Whole tiles
+ * written with writeTile() go straight to the file unless they are already
+ * resident, so a renderer that hands out one tile at a time needs no cache
+ * at all. The image writers stream the file one band of tiles at a time.
+ *
+ * All member functions are thread safe. The backing file is removed when
+ * the film is destroyed.
+ */
+class TiledFilm
+{
+public:
+    // Constructor(s)
+    TiledFilm(size_t width_, size_t height_, const std::string &backingFile_,
+              size_t tileSize_ = 64, size_t maxResidentTiles_ = 64);
+    TiledFilm() = delete;
+    TiledFilm(const TiledFilm &) = delete;
+    TiledFilm &operator=(const TiledFilm &) = delete;
+
+    // Destructor
+    ~TiledFilm();
+
+    // Getters
+    bool isOpen() const;
+    size_t getWidth() const;
+    size_t getHeight() const;
+    size_t getTileSize() const;
+    size_t getTilesX() const;
+    size_t getTilesY() const;
+    TiledFilmStats getStats() const;
+    // Pixel access through the tile cache
+    Vector3D getPixelValue(size_t w, size_t h);
+
+    // Setters
+    void setPixelValue(size_t w, size_t h, const Vector3D &value);
+
+    // Whole-tile access. Tile (tx, ty) covers the pixels from
+    // (tx * tileSize, ty * tileSize), clipped to the image; "pixels" holds
+    // its rows one after the other, with no padding
+    void writeTile(size_t tx, size_t ty, const Vector3D *pixels);
+    void readTile(size_t tx, size_t ty, Vector3D *pixels);
+
+    // Other functions
+    // Writes the dirty cached tiles to the backing file
+    void flush();
+    // Streams the image to "<name>.bmp" (8-bit, tone mapped) or "<name>.pfm"
+    // (32-bit float RGB). Return 0 on success
+    int save(std::string name, const ToneMapSettings &settings = ToneMapSettings());
+    int savePfm(std::string name);
+
+private:
+    struct CachedTile
+    {
+        std::vector<Vector3D> pixels; // tileSize x tileSize, row by row
+        bool dirty;
+        std::list<size_t>::iterator lruPosition;
+    };
+
+    // The following ones expect the mutex to be held
+    CachedTile &fetchTile(size_t tileIndex);
+    void loadTile(size_t tileIndex, Vector3D *pixels);
+    void storeTile(size_t tileIndex, const Vector3D *pixels);
+    // Reads the image rows [y0, y0 + tileSize) (clipped) into "band"
+    void readBand(size_t ty, std::vector<Vector3D> &band, std::vector<Vector3D> &tile);
+
+    size_t width;
+    size_t height;
+    size_t tileSize;
+    size_t tilesX, tilesY;
+    size_t maxResidentTiles;
+    std::string backingFile;
+
+    std::fstream file;
+    mutable std::mutex mutex;
+    std::unordered_map<size_t, CachedTile> cache;
+    std::list<size_t> lru; // Most recently used first
+    TiledFilmStats stats;
+};
+
+#endif // TILEDFILM_H
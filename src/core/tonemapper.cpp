@@ -0,0 +1,193 @@
+#include "tonemapper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "parallel.h"
+
+// The sRGB encoding is tabulated over [0, 1] and linearly interpolated.
+// With 4096 intervals the worst error (close to the linear segment, where
+// the curve bends the most) stays below 1/100 of an 8-bit step.
+static const int srgbLutSize = 4096;
+
+// Inputs are clamped to [0, maxCurveInput] before the tone curve, so that
+// the curves never see NaN, infinity or values whose square overflows
+static const float maxCurveInput = 65504.0f;
+
+static const float *getSrgbLut()
+{
+    static std::vector<float> lut;
+    static std::once_flag initialized;
+
+    std::call_once(initialized, []
+    {
+        lut.resize(srgbLutSize + 2);
+        for(int i=0; i<=srgbLutSize; i++)
+        {
+            lut[i] = (float)ToneMapper::linearToSrgb((double)i / srgbLutSize);
+        }
+        // Guard entry so that interpolating at x = 1 never reads out of bounds
+        lut[srgbLutSize + 1] = lut[srgbLutSize];
+    });
+
+    return lut.data();
+}
+
+// 8x8 Bayer matrix, used to build offsets (b + 0.5) / 64 in (0, 1) of an
+// 8-bit step. They are added before truncating, which thus rounds on average
+static const uint8_t bayer8x8[8][8] =
+{
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+ToneMapper::ToneMapper(const ToneMapSettings &settings_)
+    : settings(settings_)
+{ }
+
+size_t ToneMapper::getRowStride(size_t width, size_t rowAlignment)
+{
+    rowAlignment = std::max<size_t>(rowAlignment, 1);
+    return (width * 3 + rowAlignment - 1) / rowAlignment * rowAlignment;
+}
+
+double ToneMapper::linearToSrgb(double linear)
+{
+    if(linear <= 0.0031308)
+        return 12.92 * linear;
+
+    return 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+}
+
+void ToneMapper::toBGR8(const Film &film, std::vector<uint8_t> &buffer,
+                        size_t rowAlignment, bool bottomUp) const
+{
+    size_t width  = film.getWidth();
+    size_t height = film.getHeight();
+    size_t stride = getRowStride(width, rowAlignment);
+
+    // Padding bytes are left to zero
+    buffer.assign(stride * height, 0);
+
+    // Make sure the table is built before the workers race for it
+    if(settings.srgb)
+        getSrgbLut();
+
+    Parallel::forRange(0, height, 16, [&](size_t rowBegin, size_t rowEnd)
+    {
+        // One channel-planar scratch row per chunk (r | g | b)
+        std::vector<float> scratch(width * 3);
+
+        for(size_t row = rowBegin; row < rowEnd; row++)
+        {
+            size_t outRow = bottomUp ? (height - 1 - row) : row;
+            toneMapRow(film.getRow(row), width, row, scratch.data(),
+                       &buffer[outRow * stride]);
+        }
+    });
+}
+
+void ToneMapper::toneMapRow(const Vector3D *pixels, size_t width, size_t row,
+                            float *scratch, uint8_t *out) const
+{
+    float *r = scratch;
+    float *g = scratch + width;
+    float *b = scratch + 2 * width;
+    const float scale = (float)std::pow(2.0, settings.exposure);
+
+    // Gather the row into planar form, applying the exposure
+    for(size_t i=0; i<width; i++)
+    {
+        r[i] = (float)pixels[i].x * scale;
+        g[i] = (float)pixels[i].y * scale;
+        b[i] = (float)pixels[i].z * scale;
+    }
+
+    // Clamp to [0, maxCurveInput]. Written as comparisons that are false for
+    // NaN (std::max(NaN, 0) returns NaN), so NaN maps to 0 by construction
+    for(size_t i=0; i<3*width; i++)
+    {
+        float x = scratch[i];
+        x = x > 0.0f ? x : 0.0f;
+        scratch[i] = x < maxCurveInput ? x : maxCurveInput;
+    }
+
+    // Tone curve (the switch is hoisted so that every loop is branch-free)
+    float *channels[3] = { r, g, b };
+    for(int c=0; c<3; c++)
+    {
+        float *v = channels[c];
+        switch(settings.curve)
+        {
+        case ToneCurve::Clamp:
+            break;
+        case ToneCurve::Reinhard:
+            for(size_t i=0; i<width; i++)
+            {
+                float x = v[i];
+                v[i] = x / (1.0f + x);
+            }
+            break;
+        case ToneCurve::Filmic:
+            for(size_t i=0; i<width; i++)
+            {
+                float x = v[i];
+                v[i] = (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+            }
+            break;
+        }
+
+        for(size_t i=0; i<width; i++)
+        {
+            v[i] = v[i] < 1.0f ? v[i] : 1.0f;
+        }
+
+        // Transfer function through the interpolated table
+        if(settings.srgb)
+        {
+            const float *lut = getSrgbLut();
+            for(size_t i=0; i<width; i++)
+            {
+                float  pos  = v[i] * srgbLutSize;
+                int    idx  = (int)pos;
+                float  frac = pos - (float)idx;
+                v[i] = lut[idx] + (lut[idx + 1] - lut[idx]) * frac;
+            }
+        }
+
+        // To 8-bit range. Truncated like the legacy writer unless rounding
+        // is requested; the dither offset replaces both
+        if(settings.dither)
+        {
+            const uint8_t *bayerRow = bayer8x8[row & 7];
+            for(size_t i=0; i<width; i++)
+            {
+                float offset = (bayerRow[i & 7] + 0.5f) / 64.0f;
+                v[i] = std::min(std::max(v[i] * 255.0f + offset, 0.0f), 255.0f);
+            }
+        }
+        else
+        {
+            const float offset = settings.round ? 0.5f : 0.0f;
+            for(size_t i=0; i<width; i++)
+            {
+                v[i] = v[i] * 255.0f + offset;
+            }
+        }
+    }
+
+    // Pack as BGR
+    for(size_t i=0; i<width; i++)
+    {
+        out[3*i]   = (uint8_t)b[i];
+        out[3*i+1] = (uint8_t)g[i];
+        out[3*i+2] = (uint8_t)r[i];
+    }
+}
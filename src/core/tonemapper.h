@@ -0,0 +1,69 @@
+#ifndef TONEMAPPER_H
+#define TONEMAPPER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "film.h"
+
+// Tone curves applied after the exposure scale
+enum class ToneCurve
+{
+    Clamp,    // min(x, 1), i.e., the historical behaviour of BitMap::save
+    Reinhard, // x / (1 + x)
+    Filmic    // ACES fitted curve (Narkowicz 2015)
+};
+
+/**
+ * @brief The ToneMapSettings struct
+ */
+struct ToneMapSettings
+{
+    double    exposure; // In stops (pixel values are scaled by 2^exposure)
+    ToneCurve curve;
+    bool      srgb;     // Apply the sRGB transfer function before quantizing
+    bool      dither;   // Add an 8x8 ordered (Bayer) dither before quantizing
+    bool      round;    // Round to the nearest 8-bit value instead of
+                        //  truncating (as BitMap::save always did)
+
+    ToneMapSettings() : exposure(0), curve(ToneCurve::Clamp),
+                        srgb(false), dither(false), round(false)
+    { }
+};
+
+/**
+ * @brief The ToneMapper class
+ *
+ * Converts the linear radiance stored in a Film into packed 8-bit BGR rows,
+ * ready to be written by any of the image writers. Rows are processed in
+ * parallel, each of them as a set of branch-free loops over float arrays.
+ */
+class ToneMapper
+{
+public:
+    // Constructor(s)
+    ToneMapper(const ToneMapSettings &settings_ = ToneMapSettings());
+
+    // Fills "buffer" with width*height BGR triplets. Each row starts at a
+    // multiple of "rowAlignment" bytes (e.g., 4 for BMP) and, if "bottomUp"
+    // is set, the last film row is stored first.
+    void toBGR8(const Film &film, std::vector<uint8_t> &buffer,
+                size_t rowAlignment = 1, bool bottomUp = false) const;
+
+    // Size in bytes of a row once aligned to "rowAlignment"
+    static size_t getRowStride(size_t width, size_t rowAlignment);
+
+    // Single row, for writers that stream the image (e.g., TiledFilm).
+    // "row" is the film row (it selects the dither pattern), "scratch"
+    // must hold 3 * width floats and "out" receives 3 * width bytes
+    void toneMapRow(const Vector3D *pixels, size_t width, size_t row,
+                    float *scratch, uint8_t *out) const;
+
+    // Reference (scalar, std::pow-based) sRGB encoding of a linear value
+    static double linearToSrgb(double linear);
+
+private:
+    ToneMapSettings settings;
+};
+
+#endif // TONEMAPPER_H
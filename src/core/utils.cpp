@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#include <algorithm>
+
 Utils::Utils()
 { }
 
@@ -13,3 +15,96 @@ Vector3D Utils::multiplyPerCanal(const Vector3D &v1, const Vector3D &v2)
     return Vector3D(v1.x*v2.x, v1.y*v2.y, v1.z*v2.z);
 }
 
+
+// Occlusion query: is there anything along the ray between ray.minT and
+// ray.maxT? Returns at the first hit found, whichever it is
+bool Utils::hasIntersection(const Ray &cameraRay, const std::vector<Shape*> &objectsList)
+{
+    return hasIntersection(cameraRay, objectsList.data(), objectsList.size());
+}
+
+bool Utils::hasIntersection(const Ray &cameraRay, Shape *const *objects, size_t nObjects)
+{
+    for(size_t k=0; k<nObjects; k++)
+    {
+        if(objects[k]->rayIntersectP(cameraRay))
+            return true;
+    }
+    return false;
+}
+
+void Utils::hasIntersection(const Ray *rays, size_t nRays,
+                            const std::vector<Shape*> &objectsList, bool *occluded)
+{
+    // Rays are processed in packets. Shapes go in the outer loop: each one
+    // is tested against the rays of the packet that are not occluded yet,
+    // so blocked rays drop out early
+    const size_t packetSize = 256;
+    uint32_t active[packetSize];
+
+    for(size_t first = 0; first < nRays; first += packetSize)
+    {
+        size_t nActive = std::min(packetSize, nRays - first);
+        for(size_t i=0; i<nActive; i++)
+        {
+            occluded[first + i] = false;
+            active[i] = (uint32_t)i;
+        }
+
+        for(size_t k=0; k<objectsList.size() && nActive > 0; k++)
+        {
+            nActive = objectsList[k]->rayIntersectP(rays + first, active, nActive,
+                                                    occluded + first);
+        }
+    }
+}
+
+// Closest-hit query: every shape shortens cameraRay.maxT when it is hit, so
+// "its" ends up holding the nearest intersection
+bool Utils::getClosestIntersection(const Ray &cameraRay, const std::vector<Shape*> &objectsList, Intersection &its)
+{
+    bool hit = false;
+    for(size_t k=0; k<objectsList.size(); k++)
+    {
+        if(objectsList[k]->rayIntersect(cameraRay, its))
+            hit = true;
+    }
+    return hit;
+}
+
+// Mirror direction of "rayDirection" around "normal"
+Vector3D Utils::computeReflectionDirection(const Vector3D &rayDirection, const Vector3D &normal)
+{
+    return rayDirection - normal * (2 * dot(rayDirection, normal));
+}
+
+// eta = n_incident / n_transmitted. Snell's law gives
+// sin^2(thetaT) = eta^2 * (1 - cos^2(thetaI)); beyond 1 there is no
+// refracted ray
+bool Utils::isTotalInternalReflection(const double &eta, const double &cosThetaI,
+                                      double &cosThetaT_out)
+{
+    double sin2ThetaT = eta * eta * (1 - cosThetaI * cosThetaI);
+    if(sin2ThetaT > 1)
+        return true;
+
+    cosThetaT_out = std::sqrt(1 - sin2ThetaT);
+    return false;
+}
+
+// "normal" must point towards the incident side (cosThetaI >= 0)
+Vector3D Utils::computeTransmissionDirection(const Ray &r, const Vector3D &normal,
+                                             const double &eta, const double &cosThetaI,
+                                             const double &cosThetaT)
+{
+    return r.d.normalized() * eta + normal * (eta * cosThetaI - cosThetaT);
+}
+
+// Fresnel reflectance of a dielectric interface for unpolarized light
+double Utils::computeReflectanceCoefficient(const double &eta, const double &cosThetaI,
+                                            const double &cosThetaT)
+{
+    double rPerpendicular = (eta * cosThetaI - cosThetaT) / (eta * cosThetaI + cosThetaT);
+    double rParallel      = (cosThetaI - eta * cosThetaT) / (cosThetaI + eta * cosThetaT);
+    return (rPerpendicular * rPerpendicular + rParallel * rParallel) * 0.5;
+}
@@ -17,6 +17,10 @@ public:
 
     static bool getClosestIntersection(const Ray &cameraRay, const std::vector<Shape*> &objectsList, Intersection &its);
     static bool hasIntersection(const Ray &cameraRay, const std::vector<Shape*> &objectsList);
+    static bool hasIntersection(const Ray &cameraRay, Shape *const *objects, size_t nObjects);
+    // Batch (packet) form: occluded[i] = hasIntersection(rays[i], objectsList)
+    static void hasIntersection(const Ray *rays, size_t nRays,
+                                const std::vector<Shape*> &objectsList, bool *occluded);
     static Vector3D scalarToRGB(double scalar);
     static double degreesToRadians(double degrees);
 
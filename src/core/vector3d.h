@@ -2,21 +2,25 @@
 #define VECTOR3D_H
 
 #include <ostream>
+#include <type_traits>
 
+// Note: Vector3D is trivially copyable (no user-provided copy constructor)
+// and its constructors and non-mutating operators are constexpr, so that
+// constant vectors are built at compile time and arrays of vectors can be
+// copied with memcpy
 struct Vector3D
 {
     // Constructors
-    Vector3D();
-    Vector3D(double a);
-    Vector3D(double x_, double y_, double z_);
-    Vector3D(const Vector3D &v_);
+    constexpr Vector3D();
+    constexpr Vector3D(double a);
+    constexpr Vector3D(double x_, double y_, double z_);
 
     // Member operators overload
-    Vector3D operator+(const Vector3D &v) const;
-    Vector3D operator-(const Vector3D &v) const;
-    Vector3D operator*(const double a) const;
-    Vector3D operator/(const double a) const;
-    Vector3D operator-() const;
+    constexpr Vector3D operator+(const Vector3D &v) const;
+    constexpr Vector3D operator-(const Vector3D &v) const;
+    constexpr Vector3D operator*(const double a) const;
+    constexpr Vector3D operator/(const double a) const;
+    constexpr Vector3D operator-() const;
 
     Vector3D& operator+=(const Vector3D &v);
     Vector3D& operator-=(const Vector3D &v);
@@ -25,25 +29,75 @@ struct Vector3D
 
     // Member functions
     double length()      const;
-    double lengthSq()    const;
+    constexpr double lengthSq() const;
     Vector3D normalized() const;
 
     // Structure data
     double x, y, z;
 };
 
+static_assert(std::is_trivially_copyable<Vector3D>::value,
+              "Vector3D must stay trivially copyable");
+static_assert(sizeof(Vector3D) == 3 * sizeof(double),
+              "Vector3D must be tightly packed");
+
 // Stream insertion operator (since it takes the user-defined type at the right,
 //  i.e., "Vector3D", it must be implemented as non-member
 std::ostream& operator<<(std::ostream& out, const Vector3D &v);
 
+inline constexpr Vector3D::Vector3D() : x(0), y(0), z(0)
+{ }
+
+inline constexpr Vector3D::Vector3D(double a) : x(a), y(a), z(a)
+{ }
+
+inline constexpr Vector3D::Vector3D(double x_, double y_, double z_) : x(x_), y(y_), z(z_)
+{ }
+
+// Sum two vectors and return the result as a new object
+inline constexpr Vector3D Vector3D::operator+(const Vector3D &v) const
+{
+    return Vector3D(x + v.x, y + v.y, z + v.z);
+}
+
+// Subtract two vectors and return the result as a new object
+inline constexpr Vector3D Vector3D::operator-(const Vector3D &v) const
+{
+    return Vector3D(x - v.x, y - v.y, z - v.z);
+}
+
+// Return the negative of the vector as a new object
+inline constexpr Vector3D Vector3D::operator-() const
+{
+    return Vector3D(-x, -y, -z);
+}
+
+// Multiply a vector by a scalar and return the result as a new object
+inline constexpr Vector3D Vector3D::operator*(const double a) const
+{
+    return Vector3D(x*a, y*a, z*a);
+}
+
+// Divide a vector by a scalar and return the result as a new object
+inline constexpr Vector3D Vector3D::operator/(const double a) const
+{
+    return Vector3D(x/a, y/a, z/a);
+}
+
+// Squared length of the current vector
+inline constexpr double Vector3D::lengthSq() const
+{
+    return x*x + y*y + z*z;
+}
+
 // Dot product between two vectors
-inline double dot(const Vector3D &v1, const Vector3D &v2)
+inline constexpr double dot(const Vector3D &v1, const Vector3D &v2)
 {
     return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
 }
 
 // Returns the cross product between two vectors
-inline Vector3D cross(const Vector3D &v1, const Vector3D &v2)
+inline constexpr Vector3D cross(const Vector3D &v1, const Vector3D &v2)
 {
     return Vector3D( v1.y * v2.z - v1.z * v2.y,
                      v1.z * v2.x - v1.x * v2.z,
@@ -0,0 +1,362 @@
+#include "convolution.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "fft.h"
+#include "../core/parallel.h"
+
+// Relative cost of one complex butterfly (per value and per FFT level)
+// against one multiply-add of a pixel in the direct and separable loops.
+// Measured on the direct loop (which vectorizes) against FFT::transform():
+// with this value the automatic choice switches to the FFT for disks of
+// radius 5 or more, which is where it starts being faster
+static const double fftButterflyCost = 3.0;
+
+// Largest FFT size considered in each dimension
+static const size_t maxFftSize = 4096;
+
+// acc[t] += weight * src[t] for t < n. Pixels are handled as plain doubles
+// (Vector3D is tightly packed) so that the compiler vectorizes the loop
+static void accumulate(double *acc, const double *src, double weight, size_t n)
+{
+    for(size_t t = 0; t < n; t++)
+        acc[t] += weight * src[t];
+}
+
+Convolution::Convolution()
+{ }
+
+ConvolutionMethod Convolution::convolve(const Film &in, const Kernel &kernel, Film &out,
+                                        const ConvolutionSettings &settings,
+                                        ConvolutionStats *stats)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    ConvolutionStats local;
+    ConvolutionStats &s = stats ? *stats : local;
+    s = ConvolutionStats();
+
+    if(out.getWidth() != in.getWidth() || out.getHeight() != in.getHeight())
+    {
+        std::cout << "Problem at Convolution::convolve() : output film is "
+                  << out.getWidth() << "x" << out.getHeight() << ", expected "
+                  << in.getWidth() << "x" << in.getHeight() << std::endl;
+        return ConvolutionMethod::Auto;
+    }
+    if(kernel.getWidth() == 0 || kernel.getHeight() == 0)
+    {
+        std::cout << "Problem at Convolution::convolve() : empty kernel" << std::endl;
+        return ConvolutionMethod::Auto;
+    }
+
+    ConvolutionMethod method = estimateCost(in.getWidth(), in.getHeight(), kernel, settings, s);
+    if(settings.method != ConvolutionMethod::Auto)
+        method = settings.method;
+
+    std::vector<double> row, column;
+    if(method == ConvolutionMethod::Separable &&
+       !kernel.isSeparable(row, column, settings.separableTolerance))
+    {
+        std::cout << "Problem at Convolution::convolve() : kernel is not separable, "
+                  << "using direct convolution" << std::endl;
+        method = ConvolutionMethod::Direct;
+    }
+    if(method == ConvolutionMethod::FFT && s.fftWidth == 0)
+    {
+        std::cout << "Problem at Convolution::convolve() : kernel is larger than the "
+                  << "largest FFT, using direct convolution" << std::endl;
+        method = ConvolutionMethod::Direct;
+    }
+
+    // The padded copy also makes in-place convolution (&in == &out) safe
+    std::vector<Vector3D> padded;
+    pad(in, kernel, settings.border, padded);
+
+    switch(method)
+    {
+    case ConvolutionMethod::Separable:
+        convolveSeparable(padded, kernel, row, column, out);
+        break;
+    case ConvolutionMethod::FFT:
+        convolveFft(padded, kernel, s.fftWidth, s.fftHeight, out);
+        break;
+    default:
+        method = ConvolutionMethod::Direct;
+        convolveDirect(padded, kernel, out);
+        break;
+    }
+
+    s.method = method;
+    s.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return method;
+}
+
+ConvolutionMethod Convolution::estimateCost(size_t width, size_t height, const Kernel &kernel,
+                                            const ConvolutionSettings &settings,
+                                            ConvolutionStats &stats)
+{
+    size_t kw = kernel.getWidth(), kh = kernel.getHeight();
+    double nThreads = (double)Parallel::getThreadCount();
+    double pixels = (double)width * (double)height;
+
+    // Direct and separable convolution are split in rows, and thus use
+    // every thread; the FFT is split in blocks, so a plan with few large
+    // blocks is penalized for the threads it leaves idle
+    stats.costDirect = (double)kw * (double)kh;
+
+    std::vector<double> row, column;
+    stats.separable = kernel.isSeparable(row, column, settings.separableTolerance);
+    stats.costSeparable = stats.separable ? (double)(kw + kh) : 0;
+
+    stats.costFft = 0;
+    for(size_t nx = FFT::nextPowerOfTwo(kw); nx <= maxFftSize; nx *= 2)
+    {
+        for(size_t ny = FFT::nextPowerOfTwo(kh); ny <= maxFftSize; ny *= 2)
+        {
+            size_t blockW = nx - kw + 1, blockH = ny - kh + 1;
+            size_t nBlocks = ((width + blockW - 1) / blockW) * ((height + blockH - 1) / blockH);
+
+            // Two forward and two inverse transforms (red and green share
+            // one), plus the spectrum products
+            double size = (double)nx * (double)ny;
+            double perBlock = 4 * size * std::log2(size) * 0.5 * fftButterflyCost + 2 * size;
+            double cost = nBlocks * perBlock / pixels *
+                          nThreads / std::min(nThreads, (double)nBlocks);
+            if(stats.costFft == 0 || cost < stats.costFft)
+            {
+                stats.costFft = cost;
+                stats.fftWidth = nx;
+                stats.fftHeight = ny;
+                stats.nBlocks = nBlocks;
+            }
+
+            // Larger blocks only add padding once a block covers the image
+            if(blockH >= height)
+                break;
+        }
+        if(nx - kw + 1 >= width)
+            break;
+    }
+
+    ConvolutionMethod method = ConvolutionMethod::Direct;
+    double best = stats.costDirect;
+    if(stats.separable && stats.costSeparable < best)
+    {
+        method = ConvolutionMethod::Separable;
+        best = stats.costSeparable;
+    }
+    if(stats.costFft > 0 && stats.costFft < best)
+        method = ConvolutionMethod::FFT;
+    return method;
+}
+
+const char *Convolution::getMethodName(ConvolutionMethod method)
+{
+    switch(method)
+    {
+    case ConvolutionMethod::Direct:    return "direct";
+    case ConvolutionMethod::Separable: return "separable";
+    case ConvolutionMethod::FFT:       return "FFT";
+    default:                           return "auto";
+    }
+}
+
+void Convolution::pad(const Film &in, const Kernel &kernel, BorderMode border,
+                      std::vector<Vector3D> &padded)
+{
+    size_t width = in.getWidth(), height = in.getHeight();
+    size_t kw = kernel.getWidth(), kh = kernel.getHeight();
+
+    // Pixel (x, y) of the film lands at (x + left, y + top), so that
+    // out(x, y) = sum_ij kernel(i, j) * padded(x + kw - 1 - i, y + kh - 1 - j)
+    size_t left = kw - 1 - kernel.getCenterX();
+    size_t top  = kh - 1 - kernel.getCenterY();
+    size_t paddedW = width + kw - 1, paddedH = height + kh - 1;
+    padded.assign(paddedW * paddedH, Vector3D());
+
+    Parallel::forRange(0, paddedH, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t py = begin; py < end; py++)
+        {
+            long y = (long)py - (long)top;
+            if(y < 0 || y >= (long)height)
+            {
+                if(border == BorderMode::Zero)
+                    continue;
+                y = std::min(std::max(y, 0L), (long)height - 1);
+            }
+            const Vector3D *src = in.getRow((size_t)y);
+            Vector3D *dst = &padded[py * paddedW];
+            for(size_t px = 0; px < paddedW; px++)
+            {
+                long x = (long)px - (long)left;
+                if(x < 0 || x >= (long)width)
+                {
+                    if(border == BorderMode::Zero)
+                        continue;
+                    x = std::min(std::max(x, 0L), (long)width - 1);
+                }
+                dst[px] = src[x];
+            }
+        }
+    });
+}
+
+void Convolution::convolveDirect(const std::vector<Vector3D> &padded, const Kernel &kernel,
+                                 Film &out)
+{
+    size_t width = out.getWidth(), height = out.getHeight();
+    size_t kw = kernel.getWidth(), kh = kernel.getHeight();
+    size_t paddedW = width + kw - 1;
+
+    // Each output row is accumulated one weight at a time over the whole
+    // row, which keeps the inner loop contiguous and vectorizable
+    Parallel::forRange(0, height, 4, [&](size_t begin, size_t end)
+    {
+        std::vector<double> acc(3 * width);
+        for(size_t y = begin; y < end; y++)
+        {
+            std::fill(acc.begin(), acc.end(), 0.0);
+            for(size_t j = 0; j < kh; j++)
+            {
+                const Vector3D *src = &padded[(y + kh - 1 - j) * paddedW];
+                for(size_t i = 0; i < kw; i++)
+                {
+                    double weight = kernel.getWeight(i, j);
+                    if(weight != 0)
+                        accumulate(acc.data(), &src[kw - 1 - i].x, weight, 3 * width);
+                }
+            }
+            Vector3D *dst = out.getRow(y);
+            for(size_t x = 0; x < width; x++)
+                dst[x] = Vector3D(acc[3 * x], acc[3 * x + 1], acc[3 * x + 2]);
+        }
+    });
+}
+
+void Convolution::convolveSeparable(const std::vector<Vector3D> &padded, const Kernel &kernel,
+                                    const std::vector<double> &row,
+                                    const std::vector<double> &column, Film &out)
+{
+    size_t width = out.getWidth(), height = out.getHeight();
+    size_t kw = kernel.getWidth(), kh = kernel.getHeight();
+    size_t paddedW = width + kw - 1, paddedH = height + kh - 1;
+
+    // Row pass over every padded row (3 doubles per pixel)...
+    std::vector<double> rows(paddedH * 3 * width, 0.0);
+    Parallel::forRange(0, paddedH, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t py = begin; py < end; py++)
+        {
+            const Vector3D *src = &padded[py * paddedW];
+            double *acc = &rows[py * 3 * width];
+            for(size_t i = 0; i < kw; i++)
+                if(row[i] != 0)
+                    accumulate(acc, &src[kw - 1 - i].x, row[i], 3 * width);
+        }
+    });
+
+    // ... and column pass
+    Parallel::forRange(0, height, 4, [&](size_t begin, size_t end)
+    {
+        std::vector<double> acc(3 * width);
+        for(size_t y = begin; y < end; y++)
+        {
+            std::fill(acc.begin(), acc.end(), 0.0);
+            for(size_t j = 0; j < kh; j++)
+                if(column[j] != 0)
+                    accumulate(acc.data(), &rows[(y + kh - 1 - j) * 3 * width],
+                               column[j], 3 * width);
+            Vector3D *dst = out.getRow(y);
+            for(size_t x = 0; x < width; x++)
+                dst[x] = Vector3D(acc[3 * x], acc[3 * x + 1], acc[3 * x + 2]);
+        }
+    });
+}
+
+void Convolution::convolveFft(const std::vector<Vector3D> &padded, const Kernel &kernel,
+                              size_t fftWidth, size_t fftHeight, Film &out)
+{
+    typedef FFT::Complex Complex;
+
+    size_t width = out.getWidth(), height = out.getHeight();
+    size_t kw = kernel.getWidth(), kh = kernel.getHeight();
+    size_t paddedW = width + kw - 1, paddedH = height + kh - 1;
+    size_t nx = fftWidth, ny = fftHeight;
+
+    // Overlap-save: each block reads an nx x ny window of the padded image,
+    // and the circular convolution of that window is exact (no wrap-around)
+    // for the last (nx - kw + 1) x (ny - kh + 1) values, which are the
+    // output pixels of the block. Blocks are thus independent of each other
+    size_t blockW = nx - kw + 1, blockH = ny - kh + 1;
+    size_t blocksX = (width + blockW - 1) / blockW;
+    size_t blocksY = (height + blockH - 1) / blockH;
+
+    FFT rowFft(nx), colFft(ny);
+
+    // Kernel spectrum, with the 1 / (nx ny) of the inverse transform
+    std::vector<Complex> spectrum(nx * ny, Complex(0, 0));
+    std::vector<Complex> scratch(std::max(nx, ny));
+    double scale = 1.0 / ((double)nx * (double)ny);
+    for(size_t j = 0; j < kh; j++)
+        for(size_t i = 0; i < kw; i++)
+            spectrum[j * nx + i] = Complex(kernel.getWeight(i, j) * scale, 0);
+    FFT::transform2D(rowFft, colFft, spectrum.data(), false, scratch.data());
+
+    size_t nBlocks = blocksX * blocksY;
+    size_t grain = std::max((size_t)1, nBlocks / (4 * Parallel::getThreadCount()));
+    Parallel::forRange(0, nBlocks, grain, [&](size_t begin, size_t end)
+    {
+        // Since the kernel is real, red and green are convolved at once as
+        // the real and imaginary parts of a single complex image
+        std::vector<Complex> rg(nx * ny), b(nx * ny), colScratch(std::max(nx, ny));
+        for(size_t block = begin; block < end; block++)
+        {
+            size_t x0 = (block % blocksX) * blockW;
+            size_t y0 = (block / blocksX) * blockH;
+
+            for(size_t wy = 0; wy < ny; wy++)
+            {
+                Complex *rgRow = &rg[wy * nx];
+                Complex *bRow  = &b[wy * nx];
+                size_t py = y0 + wy;
+                size_t nValid = py < paddedH ? std::min(nx, paddedW - x0) : 0;
+                const Vector3D *src = nValid ? &padded[py * paddedW + x0] : nullptr;
+                for(size_t wx = 0; wx < nValid; wx++)
+                {
+                    rgRow[wx] = Complex(src[wx].x, src[wx].y);
+                    bRow[wx]  = Complex(src[wx].z, 0);
+                }
+                std::fill(rgRow + nValid, rgRow + nx, Complex(0, 0));
+                std::fill(bRow + nValid, bRow + nx, Complex(0, 0));
+            }
+
+            FFT::transform2D(rowFft, colFft, rg.data(), false, colScratch.data());
+            FFT::transform2D(rowFft, colFft, b.data(), false, colScratch.data());
+            for(size_t k = 0; k < nx * ny; k++)
+            {
+                rg[k] *= spectrum[k];
+                b[k]  *= spectrum[k];
+            }
+            FFT::transform2D(rowFft, colFft, rg.data(), true, colScratch.data());
+            FFT::transform2D(rowFft, colFft, b.data(), true, colScratch.data());
+
+            size_t x1 = std::min(x0 + blockW, width);
+            size_t y1 = std::min(y0 + blockH, height);
+            for(size_t y = y0; y < y1; y++)
+            {
+                Vector3D *dst = out.getRow(y);
+                size_t wy = y - y0 + kh - 1;
+                for(size_t x = x0; x < x1; x++)
+                {
+                    size_t k = wy * nx + (x - x0 + kw - 1);
+                    dst[x] = Vector3D(rg[k].real(), rg[k].imag(), b[k].real());
+                }
+            }
+        }
+    });
+}
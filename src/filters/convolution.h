@@ -0,0 +1,106 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include <vector>
+
+#include "kernel.h"
+#include "../core/film.h"
+
+/**
+ * @brief The ConvolutionMethod enum
+ */
+enum class ConvolutionMethod
+{
+    Auto,      // Cheapest of the ones below, according to Convolution::estimateCost()
+    Direct,    // Sum over every weight: O(kw * kh) per pixel
+    Separable, // Row pass and column pass: O(kw + kh), rank-1 kernels only
+    FFT        // Overlap-save blocks: O(log(block size)) per pixel
+};
+
+/**
+ * @brief The BorderMode enum
+ *
+ * Value of the pixels outside the film
+ */
+enum class BorderMode { Clamp, Zero };
+
+/**
+ * @brief The ConvolutionSettings struct
+ */
+struct ConvolutionSettings
+{
+    ConvolutionMethod method;
+    BorderMode border;
+    double separableTolerance; // See Kernel::isSeparable()
+
+    ConvolutionSettings() : method(ConvolutionMethod::Auto), border(BorderMode::Clamp),
+                            separableTolerance(1e-9)
+    { }
+};
+
+/**
+ * @brief The ConvolutionStats struct
+ */
+struct ConvolutionStats
+{
+    ConvolutionMethod method; // Method actually used
+    bool separable;
+    size_t fftWidth;          // FFT size of each overlap-save block
+    size_t fftHeight;
+    size_t nBlocks;
+    double costDirect;        // Estimated cost per pixel of each method
+    double costSeparable;     //  (0 if not applicable)
+    double costFft;
+    double seconds;
+
+    ConvolutionStats() : method(ConvolutionMethod::Auto), separable(false), fftWidth(0),
+                         fftHeight(0), nBlocks(0), costDirect(0), costSeparable(0),
+                         costFft(0), seconds(0)
+    { }
+};
+
+/**
+ * @brief The Convolution class
+ *
+ * General 2D convolution of a Film with an arbitrary Kernel:
+ *  out(x, y) = sum_ij kernel(i, j) * in(x + cx - i, y + cy - j)
+ * where (cx, cy) is the kernel center. All the methods give the same
+ * result (up to rounding); with ConvolutionMethod::Auto the cheapest one
+ * is picked from the kernel size, its separability, the image size and
+ * the number of threads. Every method runs on the global thread pool.
+ */
+class Convolution
+{
+public:
+    Convolution();
+
+    // Convolves "in" into "out" (of the same size; it may be "in" itself)
+    // and returns the method used
+    static ConvolutionMethod convolve(const Film &in, const Kernel &kernel, Film &out,
+                                      const ConvolutionSettings &settings = ConvolutionSettings(),
+                                      ConvolutionStats *stats = nullptr);
+
+    // Fills the cost fields of stats (and the FFT block size) for an image
+    // of the given size, and returns the method Auto would pick
+    static ConvolutionMethod estimateCost(size_t width, size_t height, const Kernel &kernel,
+                                          const ConvolutionSettings &settings,
+                                          ConvolutionStats &stats);
+
+    static const char *getMethodName(ConvolutionMethod method);
+
+private:
+    // Image extended by the kernel footprint according to the border mode:
+    // (width + kw - 1) x (height + kh - 1) pixels, row by row
+    static void pad(const Film &in, const Kernel &kernel, BorderMode border,
+                    std::vector<Vector3D> &padded);
+
+    static void convolveDirect(const std::vector<Vector3D> &padded, const Kernel &kernel,
+                               Film &out);
+    static void convolveSeparable(const std::vector<Vector3D> &padded, const Kernel &kernel,
+                                  const std::vector<double> &row,
+                                  const std::vector<double> &column, Film &out);
+    static void convolveFft(const std::vector<Vector3D> &padded, const Kernel &kernel,
+                            size_t fftWidth, size_t fftHeight, Film &out);
+};
+
+#endif // CONVOLUTION_H
@@ -0,0 +1,100 @@
+#include "fft.h"
+
+#include <cmath>
+#include <iostream>
+
+FFT::FFT(size_t n_) : n(n_)
+{
+    if(n == 0 || (n & (n - 1)) != 0)
+    {
+        std::cout << "Problem at FFT::FFT() : size " << n
+                  << " is not a power of two" << std::endl;
+        n = nextPowerOfTwo(n);
+    }
+
+    size_t bits = 0;
+    while(((size_t)1 << bits) < n)
+        bits++;
+
+    reversed.resize(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        size_t r = 0;
+        for(size_t b = 0; b < bits; b++)
+            if(i & ((size_t)1 << b))
+                r |= (size_t)1 << (bits - 1 - b);
+        reversed[i] = r;
+    }
+
+    twiddles.resize(n / 2);
+    const double twoPi = 6.283185307179586476925286766559;
+    for(size_t k = 0; k < n / 2; k++)
+    {
+        double angle = -twoPi * (double)k / (double)n;
+        twiddles[k] = Complex(std::cos(angle), std::sin(angle));
+    }
+}
+
+size_t FFT::getSize() const
+{
+    return n;
+}
+
+void FFT::transform(Complex *data, bool inverse, size_t stride) const
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        size_t r = reversed[i];
+        if(i < r)
+            std::swap(data[i * stride], data[r * stride]);
+    }
+
+    // Butterflies. The twiddle of a half-size "half" is twiddles[k * n / (2 half)]
+    for(size_t half = 1; half < n; half *= 2)
+    {
+        size_t step = n / (2 * half);
+        for(size_t start = 0; start < n; start += 2 * half)
+        {
+            for(size_t k = 0; k < half; k++)
+            {
+                Complex w = twiddles[k * step];
+                if(inverse)
+                    w = std::conj(w);
+                Complex &a = data[(start + k) * stride];
+                Complex &b = data[(start + k + half) * stride];
+                Complex t = w * b;
+                b = a - t;
+                a += t;
+            }
+        }
+    }
+}
+
+void FFT::transform2D(const FFT &rowFft, const FFT &colFft, Complex *data,
+                      bool inverse, Complex *scratch)
+{
+    size_t cols = rowFft.getSize();
+    size_t rows = colFft.getSize();
+
+    for(size_t r = 0; r < rows; r++)
+        rowFft.transform(data + r * cols, inverse);
+
+    // Columns are gathered into contiguous scratch memory first: a strided
+    // transform would touch one cache line per value
+    for(size_t c = 0; c < cols; c++)
+    {
+        for(size_t r = 0; r < rows; r++)
+            scratch[r] = data[r * cols + c];
+        colFft.transform(scratch, inverse);
+        for(size_t r = 0; r < rows; r++)
+            data[r * cols + c] = scratch[r];
+    }
+}
+
+size_t FFT::nextPowerOfTwo(size_t n)
+{
+    size_t p = 1;
+    while(p < n)
+        p *= 2;
+    return p;
+}
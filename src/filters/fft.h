@@ -0,0 +1,43 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The FFT class
+ *
+ * Iterative radix-2 FFT of a fixed power-of-two size. The twiddle factors
+ * and the bit-reversal permutation are computed once in the constructor,
+ * so an FFT object can be shared by several threads. Transforms are not
+ * normalized: an inverse after a forward transform scales by n.
+ */
+class FFT
+{
+public:
+    typedef std::complex<double> Complex;
+
+    // Constructor(s). "n" must be a power of two
+    explicit FFT(size_t n_);
+    FFT() = delete;
+
+    size_t getSize() const;
+
+    // In-place transform of n values, "stride" apart
+    void transform(Complex *data, bool inverse, size_t stride = 1) const;
+
+    // In-place transform of a rows x cols array stored row by row (rows
+    // of "cols" values). "scratch" must hold "rows" values
+    static void transform2D(const FFT &rowFft, const FFT &colFft, Complex *data,
+                            bool inverse, Complex *scratch);
+
+    static size_t nextPowerOfTwo(size_t n);
+
+private:
+    size_t n;
+    std::vector<Complex> twiddles; // exp(-2 pi i k / n), k < n / 2
+    std::vector<size_t> reversed;  // Bit-reversed index of each index
+};
+
+#endif // FFT_H
@@ -0,0 +1,250 @@
+#include "iterativefilter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "../core/parallel.h"
+
+// Largest number of iterations fused by the automatic settings
+static const size_t maxAutoFusedIterations = 16;
+
+IterativeFilter::IterativeFilter(const Kernel &kernel_)
+    : kernel(kernel_),
+      rowsAbove(kernel_.getHeight() - 1 - kernel_.getCenterY()),
+      rowsBelow(kernel_.getCenterY())
+{
+    size_t kw = kernel.getWidth(), kh = kernel.getHeight();
+    weightTable.assign((kw + 1) * (kh + 1), 0.0);
+    for(size_t j = 0; j < kh; j++)
+    {
+        double rowSum = 0;
+        for(size_t i = 0; i < kw; i++)
+        {
+            rowSum += kernel.getWeight(i, j);
+            weightTable[(j + 1) * (kw + 1) + i + 1] = weightTable[j * (kw + 1) + i + 1] + rowSum;
+        }
+    }
+}
+
+double IterativeFilter::getWeightSum(size_t i0, size_t j0, size_t i1, size_t j1) const
+{
+    size_t stride = kernel.getWidth() + 1;
+    return weightTable[j1 * stride + i1] - weightTable[j0 * stride + i1]
+         - weightTable[j1 * stride + i0] + weightTable[j0 * stride + i0];
+}
+
+void IterativeFilter::filterRow(const Vector3D *const *srcRows, size_t width, size_t height,
+                                size_t y, Vector3D *dst, double *acc) const
+{
+    // out(x, y) = sum_ij kernel(i, j) * in(x + cx - i, y + cy - j), over
+    // the (i, j) that fall inside the film
+    long kw = (long)kernel.getWidth(), kh = (long)kernel.getHeight();
+    long cx = (long)kernel.getCenterX(), cy = (long)kernel.getCenterY();
+    long w = (long)width, h = (long)height, ly = (long)y;
+
+    // Kernel rows that fall inside the film: 0 <= y + cy - j < height
+    long j0 = std::max(0L, ly + cy - h + 1), j1 = std::min(kh, ly + cy + 1);
+
+    std::fill(acc, acc + 3 * width, 0.0);
+    for(long j = j0; j < j1; j++)
+    {
+        const Vector3D *src = srcRows[ly + cy - j];
+        for(long i = 0; i < kw; i++)
+        {
+            double weight = kernel.getWeight((size_t)i, (size_t)j);
+            if(weight == 0)
+                continue;
+            // Columns x such that 0 <= x + cx - i < width
+            long x0 = std::max(0L, i - cx), x1 = std::min(w, w + i - cx);
+            const double *s = &src[x0 + cx - i].x;
+            double *a = acc + 3 * x0;
+            for(long t = 0; t < 3 * (x1 - x0); t++)
+                a[t] += weight * s[t];
+        }
+    }
+
+    // Every kernel column is used away from the left and right borders
+    double interiorNorm = 1.0 / getWeightSum(0, (size_t)j0, (size_t)kw, (size_t)j1);
+    for(long x = 0; x < w; x++)
+    {
+        long i0 = std::max(0L, x + cx - w + 1), i1 = std::min(kw, x + cx + 1);
+        double norm = (i0 == 0 && i1 == kw) ? interiorNorm
+                      : 1.0 / getWeightSum((size_t)i0, (size_t)j0, (size_t)i1, (size_t)j1);
+        dst[x] = Vector3D(acc[3 * x] * norm, acc[3 * x + 1] * norm, acc[3 * x + 2] * norm);
+    }
+}
+
+void IterativeFilter::applyReference(Film &film, size_t iterations) const
+{
+    size_t width = film.getWidth(), height = film.getHeight();
+    Film other(width, height);
+    Film *src = &film, *dst = &other;
+
+    std::vector<const Vector3D *> srcRows(height);
+    for(size_t it = 0; it < iterations; it++)
+    {
+        for(size_t y = 0; y < height; y++)
+            srcRows[y] = src->getRow(y);
+
+        Parallel::forRange(0, height, 8, [&](size_t begin, size_t end)
+        {
+            std::vector<double> acc(3 * width);
+            for(size_t y = begin; y < end; y++)
+                filterRow(srcRows.data(), width, height, y, dst->getRow(y), acc.data());
+        });
+        std::swap(src, dst);
+    }
+
+    if(src != &film)
+    {
+        for(size_t y = 0; y < height; y++)
+            std::memcpy(film.getRow(y), src->getRow(y), width * sizeof(Vector3D));
+    }
+}
+
+// Rows of a band through the fused iterations of a round. Level 0 is the
+// source film and level "steps" the destination film; the levels in
+// between keep their last kernel-height rows in a ring. Only the rows that
+// are alive have a pointer in "rows"
+struct IterativeFilter::FusedBand
+{
+    size_t width, height, steps, ringRows;
+    std::vector<const Vector3D *> rows; // rows[level * height + y]
+    std::vector<size_t> next;           // Next row to compute, per level
+    std::vector<size_t> end;            // End of the rows of each level
+    std::vector<Vector3D> ring;         // ringRows rows per middle level
+    Film *destination;
+    size_t computedRows;
+};
+
+void IterativeFilter::pullRows(FusedBand &band, size_t level, size_t upTo, double *acc) const
+{
+    for(; band.next[level] < upTo; band.next[level]++)
+    {
+        size_t y = band.next[level];
+        if(level > 1)
+            pullRows(band, level - 1, std::min(y + rowsBelow + 1, band.end[level - 1]), acc);
+
+        // Ring slot y % ringRows held row y - ringRows, which the level
+        // above no longer needs: it reads rows from y - ringRows + 1 on
+        Vector3D *dst;
+        if(level == band.steps)
+            dst = band.destination->getRow(y);
+        else
+            dst = &band.ring[((level - 1) * band.ringRows + y % band.ringRows) * band.width];
+
+        filterRow(&band.rows[(level - 1) * band.height], band.width, band.height, y, dst, acc);
+        band.rows[level * band.height + y] = dst;
+        band.computedRows++;
+    }
+}
+
+void IterativeFilter::apply(Film &film, const IterativeFilterSettings &settings,
+                            IterativeFilterStats *stats) const
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    size_t width = film.getWidth(), height = film.getHeight();
+    size_t iterations = settings.iterations;
+    if(iterations == 0 || width == 0 || height == 0)
+        return;
+
+    // Automatic settings: the rings of the fused iterations (kernel height
+    // rows each) should fit in settings.cacheBytes. Fusing is nearly free
+    // (only the halo rows at the band borders are computed twice), so at
+    // least two iterations are fused even when a single ring is larger
+    size_t halo = rowsAbove + rowsBelow;
+    size_t ringRows = halo + 1;
+    size_t fused = settings.fusedIterations;
+    if(fused == 0)
+    {
+        fused = settings.cacheBytes / (ringRows * width * sizeof(Vector3D));
+        fused = std::min(std::max(fused, (size_t)2), maxAutoFusedIterations);
+    }
+    fused = std::min(fused, iterations);
+
+    // One band per thread, as long as the halo rows (about fused * halo / 2
+    // extra rows per level and band) stay below a quarter of the work
+    size_t bandHeight = settings.bandHeight;
+    if(bandHeight == 0)
+    {
+        size_t nThreads = Parallel::getThreadCount();
+        bandHeight = (height + nThreads - 1) / nThreads;
+        bandHeight = std::max(bandHeight, 2 * fused * halo);
+    }
+    bandHeight = std::max(std::min(bandHeight, height), (size_t)1);
+    size_t nBands = (height + bandHeight - 1) / bandHeight;
+
+    Film other(width, height);
+    Film *src = &film, *dst = &other;
+    std::vector<size_t> bandRows(nBands, 0);
+    size_t nRounds = 0;
+
+    for(size_t done = 0; done < iterations; done += fused, nRounds++)
+    {
+        size_t steps = std::min(fused, iterations - done);
+        Film *roundSrc = src, *roundDst = dst;
+
+        Parallel::forRange(0, nBands, 1, [&](size_t begin, size_t end)
+        {
+            FusedBand band;
+            band.width = width;
+            band.height = height;
+            band.steps = steps;
+            band.ringRows = ringRows;
+            band.rows.assign((steps + 1) * height, nullptr);
+            band.next.resize(steps + 1);
+            band.end.resize(steps + 1);
+            band.ring.resize((steps - 1) * ringRows * width);
+            band.destination = roundDst;
+            std::vector<double> acc(3 * width);
+
+            for(size_t b = begin; b < end; b++)
+            {
+                size_t y0 = b * bandHeight;
+                size_t y1 = std::min(y0 + bandHeight, height);
+
+                // Level s must cover the rows that the (steps - s) levels
+                // above it reach
+                for(size_t level = 0; level <= steps; level++)
+                {
+                    size_t left = steps - level;
+                    band.next[level] = y0 > left * rowsAbove ? y0 - left * rowsAbove : 0;
+                    band.end[level]  = std::min(y1 + left * rowsBelow, height);
+                }
+                for(size_t y = band.next[0]; y < band.end[0]; y++)
+                    band.rows[y] = roundSrc->getRow(y);
+
+                band.computedRows = 0;
+                pullRows(band, steps, y1, acc.data());
+                bandRows[b] += band.computedRows;
+            }
+        });
+
+        std::swap(src, dst);
+    }
+
+    if(src != &film)
+    {
+        Parallel::forRange(0, height, 64, [&](size_t begin, size_t end)
+        {
+            for(size_t y = begin; y < end; y++)
+                std::memcpy(film.getRow(y), src->getRow(y), width * sizeof(Vector3D));
+        });
+    }
+
+    if(stats)
+    {
+        size_t computedRows = 0;
+        for(size_t b = 0; b < nBands; b++)
+            computedRows += bandRows[b];
+        stats->fusedIterations = fused;
+        stats->bandHeight = bandHeight;
+        stats->nBands = nBands;
+        stats->nRounds = nRounds;
+        stats->redundantRatio = (double)computedRows / (double)(iterations * height) - 1;
+        stats->seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef ITERATIVEFILTER_H
+#define ITERATIVEFILTER_H
+
+#include <vector>
+
+#include "kernel.h"
+#include "../core/film.h"
+
+/**
+ * @brief The IterativeFilterSettings struct
+ */
+struct IterativeFilterSettings
+{
+    size_t iterations;
+    size_t fusedIterations; // Iterations applied per band while it stays in
+                            //  cache (0: automatic)
+    size_t bandHeight;      // Output rows per band (0: automatic)
+    size_t cacheBytes;      // Working set aimed at by the automatic fusion
+                            //  depth (the rings of the fused iterations)
+
+    IterativeFilterSettings() : iterations(20), fusedIterations(0), bandHeight(0),
+                                cacheBytes(1 << 20)
+    { }
+};
+
+/**
+ * @brief The IterativeFilterStats struct
+ */
+struct IterativeFilterStats
+{
+    size_t fusedIterations;
+    size_t bandHeight;
+    size_t nBands;
+    size_t nRounds;         // Passes over the whole film
+    double redundantRatio;  // Rows computed / rows of the unfused loop - 1
+    double seconds;
+
+    IterativeFilterStats() : fusedIterations(0), bandHeight(0), nBands(0), nRounds(0),
+                             redundantRatio(0), seconds(0)
+    { }
+};
+
+/**
+ * @brief The IterativeFilter class
+ *
+ * Applies a stencil (a kernel of positive weights) to a film several times,
+ * as filteringAnImageExercise() does: pixels outside the film are ignored
+ * and every output pixel is divided by the sum of the weights it used.
+ *
+ * apply() uses temporal blocking. The film is split into bands of rows
+ * (one per thread by default), and each band runs several iterations in
+ * one sweep: rows are computed on demand, so that iteration s produces a
+ * row as soon as iteration s + 1 needs it. Each intermediate iteration
+ * thus only keeps its last (kernel rows) rows, in a small ring that stays
+ * in cache, and the film is read and written once per round of fused
+ * iterations instead of once per iteration. The rows of a band's halo
+ * (kernel rows - 1 per fused iteration) are computed again by the
+ * neighbouring band, which is what makes the bands independent. Every
+ * pixel goes through exactly the same arithmetic as in applyReference()
+ * (the unfused ping-pong loop), so both give bitwise identical results.
+ */
+class IterativeFilter
+{
+public:
+    // Constructor(s)
+    explicit IterativeFilter(const Kernel &kernel_);
+    IterativeFilter() = delete;
+
+    // Filters film in place
+    void apply(Film &film, const IterativeFilterSettings &settings = IterativeFilterSettings(),
+               IterativeFilterStats *stats = nullptr) const;
+
+    // Unfused reference: one full pass over the film per iteration
+    void applyReference(Film &film, size_t iterations) const;
+
+private:
+    struct FusedBand;
+
+    // Computes the rows of "level" (iteration of the round) of the band up
+    // to row upTo (excluded), first pulling the rows they need from the
+    // level below
+    void pullRows(FusedBand &band, size_t level, size_t upTo, double *acc) const;
+
+    // One iteration of output row y. srcRows[r] points to image row r (only
+    // the rows the stencil reaches are accessed); "acc" holds 3 * width doubles
+    void filterRow(const Vector3D *const *srcRows, size_t width, size_t height,
+                   size_t y, Vector3D *dst, double *acc) const;
+
+    // Sum of the weights (i, j) with i in [i0, i1) and j in [j0, j1)
+    double getWeightSum(size_t i0, size_t j0, size_t i1, size_t j1) const;
+
+    Kernel kernel;
+    size_t rowsAbove;  // Rows of the source used above / below the output row
+    size_t rowsBelow;
+    std::vector<double> weightTable; // Summed-area table of the weights
+};
+
+#endif // ITERATIVEFILTER_H
@@ -0,0 +1,153 @@
+#include "kernel.h"
+
+#include <cmath>
+#include <iostream>
+
+Kernel::Kernel(size_t width_, size_t height_)
+    : width(width_), height(height_), weights(width_ * height_, 0.0)
+{ }
+
+Kernel::Kernel(size_t width_, size_t height_, const std::vector<double> &weights_)
+    : width(width_), height(height_), weights(weights_)
+{
+    if(weights.size() != width * height)
+    {
+        std::cout << "Problem at Kernel::Kernel() : expected " << width * height
+                  << " weights, got " << weights.size() << std::endl;
+        weights.resize(width * height, 0.0);
+    }
+}
+
+size_t Kernel::getWidth() const
+{
+    return width;
+}
+
+size_t Kernel::getHeight() const
+{
+    return height;
+}
+
+size_t Kernel::getCenterX() const
+{
+    return width / 2;
+}
+
+size_t Kernel::getCenterY() const
+{
+    return height / 2;
+}
+
+double Kernel::getWeight(size_t i, size_t j) const
+{
+    return weights[j * width + i];
+}
+
+const double *Kernel::getWeights() const
+{
+    return weights.data();
+}
+
+double Kernel::getSum() const
+{
+    double sum = 0;
+    for(size_t k = 0; k < weights.size(); k++)
+        sum += weights[k];
+    return sum;
+}
+
+void Kernel::setWeight(size_t i, size_t j, double value)
+{
+    weights[j * width + i] = value;
+}
+
+void Kernel::normalize()
+{
+    double sum = getSum();
+    if(sum == 0)
+        return;
+    for(size_t k = 0; k < weights.size(); k++)
+        weights[k] /= sum;
+}
+
+bool Kernel::isSeparable(std::vector<double> &row, std::vector<double> &column,
+                         double tolerance) const
+{
+    // Pivot on the largest weight: if the kernel is rank 1, its row and
+    // column (the latter divided by the pivot) are the two factors
+    size_t pi = 0, pj = 0;
+    double pivot = 0;
+    for(size_t j = 0; j < height; j++)
+    {
+        for(size_t i = 0; i < width; i++)
+        {
+            if(std::fabs(getWeight(i, j)) > std::fabs(pivot))
+            {
+                pivot = getWeight(i, j);
+                pi = i;
+                pj = j;
+            }
+        }
+    }
+    if(pivot == 0)
+        return false;
+
+    std::vector<double> r(width), c(height);
+    for(size_t i = 0; i < width; i++)
+        r[i] = getWeight(i, pj);
+    for(size_t j = 0; j < height; j++)
+        c[j] = getWeight(pi, j) / pivot;
+
+    double maxError = tolerance * std::fabs(pivot);
+    for(size_t j = 0; j < height; j++)
+        for(size_t i = 0; i < width; i++)
+            if(std::fabs(r[i] * c[j] - getWeight(i, j)) > maxError)
+                return false;
+
+    row.swap(r);
+    column.swap(c);
+    return true;
+}
+
+Kernel Kernel::box(size_t radius)
+{
+    size_t size = 2 * radius + 1;
+    Kernel kernel(size, size, std::vector<double>(size * size, 1.0));
+    kernel.normalize();
+    return kernel;
+}
+
+Kernel Kernel::gaussian(double sigma, size_t radius)
+{
+    size_t size = 2 * radius + 1;
+    Kernel kernel(size, size);
+    double r = (double)radius;
+    for(size_t j = 0; j < size; j++)
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            double dx = i - r, dy = j - r;
+            kernel.setWeight(i, j, std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma)));
+        }
+    }
+    kernel.normalize();
+    return kernel;
+}
+
+Kernel Kernel::disk(double radius)
+{
+    size_t r = (size_t)std::ceil(radius);
+    size_t size = 2 * r + 1;
+    Kernel kernel(size, size);
+    for(size_t j = 0; j < size; j++)
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            double dx = i - (double)r, dy = j - (double)r;
+            if(dx * dx + dy * dy <= radius * radius)
+                kernel.setWeight(i, j, 1.0);
+        }
+    }
+    kernel.normalize();
+    return kernel;
+}
@@ -0,0 +1,56 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The Kernel class
+ *
+ * Rectangular convolution kernel of arbitrary (not necessarily odd) size.
+ * Weight (i, j) lies at column i and row j; the kernel is centered at
+ * (width / 2, height / 2).
+ */
+class Kernel
+{
+public:
+    // Constructor(s). Weights are given row by row; if none are given the
+    // kernel is all zeros
+    Kernel(size_t width_, size_t height_);
+    Kernel(size_t width_, size_t height_, const std::vector<double> &weights_);
+    Kernel() = delete;
+
+    // Getters
+    size_t getWidth() const;
+    size_t getHeight() const;
+    size_t getCenterX() const;
+    size_t getCenterY() const;
+    double getWeight(size_t i, size_t j) const;
+    const double *getWeights() const;
+    double getSum() const;
+
+    // Setters
+    void setWeight(size_t i, size_t j, double value);
+
+    // Other functions
+    void normalize();
+
+    // Rank-1 test: if every weight (i, j) equals row[i] * column[j] (up to
+    // "tolerance" times the largest weight), fills both factors and
+    // returns true
+    bool isSeparable(std::vector<double> &row, std::vector<double> &column,
+                     double tolerance = 1e-9) const;
+
+    // Factories (normalized kernels)
+    static Kernel box(size_t radius);
+    static Kernel gaussian(double sigma, size_t radius);
+    // Filled circle, not separable (e.g., a defocus/bokeh PSF)
+    static Kernel disk(double radius);
+
+private:
+    size_t width;
+    size_t height;
+    std::vector<double> weights;
+};
+
+#endif // KERNEL_H
@@ -0,0 +1,168 @@
+#include "summedareatable.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "../core/parallel.h"
+
+SummedAreaTable::SummedAreaTable() : width(0), height(0)
+{ }
+
+SummedAreaTable::SummedAreaTable(const Film &film) : width(0), height(0)
+{
+    build(film);
+}
+
+void SummedAreaTable::build(const Film &film)
+{
+    width  = film.getWidth();
+    height = film.getHeight();
+    size_t stride = width + 1;
+    table.assign(stride * (height + 1), Vector3D());
+
+    // Mean of the film (per row first, so that rows sum in parallel)
+    std::vector<Vector3D> rowSums(height);
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t y = begin; y < end; y++)
+        {
+            const Vector3D *src = film.getRow(y);
+            Vector3D sum;
+            for(size_t x = 0; x < width; x++)
+                sum += src[x];
+            rowSums[y] = sum;
+        }
+    });
+    mean = Vector3D();
+    for(size_t y = 0; y < height; y++)
+        mean += rowSums[y];
+    if(width * height > 0)
+        mean /= (double)(width * height);
+
+    // Prefix sums along the rows (rows are independent)...
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t y = begin; y < end; y++)
+        {
+            const Vector3D *src = film.getRow(y);
+            Vector3D *dst = &table[(y + 1) * stride];
+            Vector3D sum;
+            for(size_t x = 0; x < width; x++)
+            {
+                sum += src[x] - mean;
+                dst[x + 1] = sum;
+            }
+        }
+    });
+
+    // ... then down the columns, in bands of columns so that each thread
+    // reads and writes contiguous runs of every row
+    Parallel::forRange(1, stride, 256, [&](size_t begin, size_t end)
+    {
+        for(size_t y = 2; y <= height; y++)
+        {
+            const Vector3D *above = &table[(y - 1) * stride];
+            Vector3D *row = &table[y * stride];
+            for(size_t x = begin; x < end; x++)
+                row[x] += above[x];
+        }
+    });
+}
+
+size_t SummedAreaTable::getWidth() const
+{
+    return width;
+}
+
+size_t SummedAreaTable::getHeight() const
+{
+    return height;
+}
+
+Vector3D SummedAreaTable::getSum(long x0, long y0, long x1, long y1) const
+{
+    x0 = std::max(x0, 0L);
+    y0 = std::max(y0, 0L);
+    x1 = std::min(x1, (long)width);
+    y1 = std::min(y1, (long)height);
+    if(x1 <= x0 || y1 <= y0)
+        return Vector3D();
+
+    size_t stride = width + 1;
+    const Vector3D &a = table[y0 * stride + x0];
+    const Vector3D &b = table[y0 * stride + x1];
+    const Vector3D &c = table[y1 * stride + x0];
+    const Vector3D &d = table[y1 * stride + x1];
+    double area = (double)((x1 - x0) * (y1 - y0));
+    return (d - b) - (c - a) + mean * area;
+}
+
+Vector3D SummedAreaTable::getAverage(long x0, long y0, long x1, long y1) const
+{
+    x0 = std::max(x0, 0L);
+    y0 = std::max(y0, 0L);
+    x1 = std::min(x1, (long)width);
+    y1 = std::min(y1, (long)height);
+    if(x1 <= x0 || y1 <= y0)
+        return Vector3D();
+    return getSum(x0, y0, x1, y1) / (double)((x1 - x0) * (y1 - y0));
+}
+
+Vector3D SummedAreaTable::boxAverage(size_t x, size_t y, size_t r) const
+{
+    long lr = (long)r;
+    return getAverage((long)x - lr, (long)y - lr, (long)x + lr + 1, (long)y + lr + 1);
+}
+
+void SummedAreaTable::boxFilter(size_t radius, Film &out) const
+{
+    if(out.getWidth() != width || out.getHeight() != height)
+    {
+        std::cout << "Problem at SummedAreaTable::boxFilter() : output film is "
+                  << out.getWidth() << "x" << out.getHeight() << ", expected "
+                  << width << "x" << height << std::endl;
+        return;
+    }
+
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t y = begin; y < end; y++)
+        {
+            Vector3D *dst = out.getRow(y);
+            for(size_t x = 0; x < width; x++)
+                dst[x] = boxAverage(x, y, radius);
+        }
+    });
+}
+
+void SummedAreaTable::boxFilter(const std::vector<float> &radii, Film &out) const
+{
+    if(out.getWidth() != width || out.getHeight() != height || radii.size() != width * height)
+    {
+        std::cout << "Problem at SummedAreaTable::boxFilter() : expected a "
+                  << width << "x" << height << " film and radius map" << std::endl;
+        return;
+    }
+
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t y = begin; y < end; y++)
+        {
+            Vector3D *dst = out.getRow(y);
+            const float *r = &radii[y * width];
+            for(size_t x = 0; x < width; x++)
+            {
+                // Negative and NaN radii mean 0; beyond the film size the
+                // box covers the whole film anyway
+                double radius = r[x] > 0 ? (double)r[x] : 0.0;
+                radius = std::min(radius, (double)std::max(width, height));
+                size_t r0 = (size_t)radius;
+                double t = radius - (double)r0;
+                Vector3D value = boxAverage(x, y, r0);
+                if(t > 0)
+                    value = value * (1 - t) + boxAverage(x, y, r0 + 1) * t;
+                dst[x] = value;
+            }
+        }
+    });
+}
@@ -0,0 +1,55 @@
+#ifndef SUMMEDAREATABLE_H
+#define SUMMEDAREATABLE_H
+
+#include <vector>
+
+#include "../core/film.h"
+
+/**
+ * @brief The SummedAreaTable class
+ *
+ * Table S(x, y) = sum of the film pixels in [0, x) x [0, y), kept in double
+ * precision, so that the sum over any rectangle costs four lookups. The
+ * film mean is subtracted before summing: the table then holds sums of
+ * values centered on zero, which keeps their magnitude (and the rounding
+ * error of the differences) small on large images.
+ */
+class SummedAreaTable
+{
+public:
+    // Constructor(s)
+    SummedAreaTable();
+    explicit SummedAreaTable(const Film &film);
+
+    // (Re)builds the table from film, in parallel
+    void build(const Film &film);
+
+    // Getters
+    size_t getWidth() const;
+    size_t getHeight() const;
+
+    // Sum and mean of the pixels in [x0, x1) x [y0, y1). The rectangle is
+    // clamped to the film; the mean of an empty rectangle is 0
+    Vector3D getSum(long x0, long y0, long x1, long y1) const;
+    Vector3D getAverage(long x0, long y0, long x1, long y1) const;
+
+    // Box filters. Each output pixel is the mean of the (2r+1)^2 pixels
+    // around it (fewer near the borders, as the box is clamped), in O(1)
+    // per pixel whatever the radius. With a radius per pixel (width *
+    // height values, row by row) a fractional radius blends the boxes of
+    // the two nearest integer radii. "out" has the size of the table, and
+    // may be the film the table was built from
+    void boxFilter(size_t radius, Film &out) const;
+    void boxFilter(const std::vector<float> &radii, Film &out) const;
+
+private:
+    // Returns the box mean of radius r around (x, y)
+    Vector3D boxAverage(size_t x, size_t y, size_t r) const;
+
+    size_t width;
+    size_t height;
+    Vector3D mean;
+    std::vector<Vector3D> table; // (width + 1) x (height + 1), row by row
+};
+
+#endif // SUMMEDAREATABLE_H
@@ -1,7 +1,10 @@
 #include <iostream>
-#include <stdlib.h> /* srand, rand */
+#include <stdlib.h> /* atoi */
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 #define _USE_MATH_DEFINES
 
@@ -9,11 +12,28 @@
 
 #include "core/film.h"
 #include "core/matrix4x4.h"
+#include "core/memoryarena.h"
+#include "core/parallel.h"
+#include "core/rng.h"
+#include "core/tester.h"
+#include "core/tiledfilm.h"
 #include "core/ray.h"
 #include "core/utils.h"
 #include "shapes/sphere.h"
 #include "cameras/ortographic.h"
 #include "cameras/perspective.h"
+#include "filters/convolution.h"
+#include "filters/iterativefilter.h"
+#include "filters/summedareatable.h"
+#include "render/renderer.h"
+#include "render/batchrenderer.h"
+#include "render/distributedrenderer.h"
+#include "render/progressive.h"
+#include "render/renderdaemon.h"
+#include "render/scenegraph.h"
+#include "render/wavefront.h"
+#include "textures/mippyramid.h"
+#include "textures/texturecache.h"
 
 void transformationsExercise()
 {
@@ -256,12 +276,175 @@ void filteringAnImageExercise(bool isGaussian)
 }
 
 Sphere createSphere() {
-	Matrix4x4 objectToWorld = Matrix4x4();
-	objectToWorld = objectToWorld.translate(Vector3D(0, 0, 3));
+	// Fixed transform, folded at compile time
+	constexpr Matrix4x4 objectToWorld = Matrix4x4::translate(Vector3D(0, 0, 3));
 	double sRadius = 1.0;
 	return Sphere(sRadius, objectToWorld);
 }
 
+void convolutionExercise(double radius)
+{
+    // Same circle as filteringAnImageExercise(), blurred with a disk of the
+    // given radius (a defocus PSF, which is not separable)
+    int resX = 512, resY = 512;
+    Film f1(resX, resY);
+    generateSphere(std::min(resX, resY) / 4, resX / 2, resY / 2, &f1);
+
+    Film f2(resX, resY);
+    ConvolutionStats stats;
+    Convolution::convolve(f1, Kernel::disk(radius), f2, ConvolutionSettings(), &stats);
+    f2.save("convolved");
+
+    std::cout << "Convolution path: " << Convolution::getMethodName(stats.method)
+              << " (estimated cost per pixel: direct " << stats.costDirect
+              << ", FFT " << stats.costFft << " with " << stats.nBlocks << " blocks of "
+              << stats.fftWidth << "x" << stats.fftHeight << ")" << std::endl;
+    std::cout << "Time: " << stats.seconds << " s" << std::endl;
+}
+
+void boxFilterExercise(size_t radius)
+{
+    // Box blur of the filtering exercise image through a summed-area table:
+    // the cost per pixel does not depend on the radius
+    int resX = 512, resY = 512;
+    Film f1(resX, resY);
+    generateSphere(std::min(resX, resY) / 4, resX / 2, resY / 2, &f1);
+
+    SummedAreaTable sat(f1);
+    Film f2(resX, resY);
+    sat.boxFilter(radius, f2);
+    f2.save("box filtered");
+
+    // Depth-of-field-like blur: sharp at the center, with a radius that
+    // grows up to "radius" at the corners
+    std::vector<float> radii(resX * resY);
+    double maxDistance = std::sqrt(0.5) * resX;
+    for(int y = 0; y < resY; y++)
+    {
+        for(int x = 0; x < resX; x++)
+        {
+            double dx = x - resX * .5, dy = y - resY * .5;
+            radii[y * resX + x] = (float)(radius * std::sqrt(dx * dx + dy * dy) / maxDistance);
+        }
+    }
+    sat.boxFilter(radii, f2);
+    f2.save("variable box filtered");
+}
+
+void iterativeFilterExercise(size_t iterations)
+{
+    // filteringAnImageExercise() with the 9x9 box filter, on the stencil
+    // engine: fused (temporal blocking) and unfused, which must match
+    int resX = 512, resY = 512;
+    Film fused(resX, resY), reference(resX, resY);
+    generateSphere(std::min(resX, resY) / 4, resX / 2, resY / 2, &fused);
+    generateSphere(std::min(resX, resY) / 4, resX / 2, resY / 2, &reference);
+
+    IterativeFilter filter(Kernel::box(4));
+    IterativeFilterSettings settings;
+    settings.iterations = iterations;
+    IterativeFilterStats stats;
+    filter.apply(fused, settings, &stats);
+    fused.save("iterated");
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    filter.applyReference(reference, iterations);
+    double referenceSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    bool same = true;
+    for(int y = 0; y < resY && same; y++)
+        same = std::memcmp(fused.getRow(y), reference.getRow(y), resX * sizeof(Vector3D)) == 0;
+
+    std::cout << "Fused " << stats.fusedIterations << " iterations per band of "
+              << stats.bandHeight << " rows (" << stats.nBands << " bands, "
+              << stats.redundantRatio * 100 << "% redundant rows): " << stats.seconds
+              << " s; unfused: " << referenceSeconds << " s; results "
+              << (same ? "match" : "DIFFER") << std::endl;
+}
+
+void mipmapExercise(std::string fileName, std::string filterName)
+{
+    // Pyramid of a BMP image: every level is saved, plus a thumbnail (the
+    // finest level that fits in 128x128)
+    Vector3D **data = nullptr;
+    size_t width, height;
+    if(BitMap::read(data, width, height, fileName) != 0)
+        return;
+
+    MipSettings settings;
+    if(filterName == "lanczos")
+        settings.filter = MipFilter::Lanczos;
+    else if(filterName == "kaiser")
+        settings.filter = MipFilter::Kaiser;
+
+    MipPyramid pyramid(data, width, height, settings);
+    for(size_t i = 0; i < height; i++)
+        delete[] data[i];
+    delete[] data;
+
+    for(size_t level = 1; level < pyramid.getLevelCount(); level++)
+    {
+        Film film(pyramid.getLevelWidth(level), pyramid.getLevelHeight(level));
+        pyramid.toFilm(level, film);
+        film.save("mip level " + std::to_string(level));
+    }
+    size_t thumbnail = pyramid.getLevelForSize(128, 128);
+    Film film(pyramid.getLevelWidth(thumbnail), pyramid.getLevelHeight(thumbnail));
+    pyramid.toFilm(thumbnail, film);
+    film.save("thumbnail");
+
+    std::cout << pyramid.getLevelCount() << " levels, " << pyramid.getTotalTexels()
+              << " texels; thumbnail is level " << thumbnail << std::endl;
+}
+
+void textureCacheExercise(std::string fileName, size_t budgetKB)
+{
+    // The same random bilinear lookups, on many threads, through the BMP
+    // and through its pre-tiled copy; both must return the same colors
+    std::string tiledName = fileName + ".tiles";
+    if(TextureCache::convertToTiled(fileName, tiledName) != 0)
+        return;
+
+    TextureCacheSettings settings;
+    settings.memoryBudget = budgetKB << 10;
+    const size_t nLookups = 1 << 20;
+
+    std::vector<Vector3D> colors[2];
+    for(int pass = 0; pass < 2; pass++)
+    {
+        TextureCache cache(settings);
+        int texture = cache.addTexture(pass == 0 ? fileName : tiledName);
+        if(texture < 0)
+            return;
+
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        colors[pass].resize(nLookups);
+        Parallel::forRange(0, nLookups, 4096, [&](size_t begin, size_t end)
+        {
+            Philox rng(11);
+            for(size_t i = begin; i < end; i++)
+                colors[pass][i] = cache.sample(texture, rng.uniformDouble(i, 0, 0),
+                                               rng.uniformDouble(i, 0, 1));
+        });
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        TextureCacheStats stats = cache.getStats();
+        std::cout << (pass == 0 ? "BMP" : "Tiled") << ": " << nLookups / seconds * 1e-6
+                  << " Mlookups/s, hits " << stats.hits << ", misses " << stats.misses
+                  << ", evictions " << stats.evictions << ", read " << (stats.bytesRead >> 10)
+                  << " KB, peak resident " << (stats.peakResident >> 10) << " KB" << std::endl;
+    }
+
+    size_t mismatches = 0;
+    for(size_t i = 0; i < nLookups; i++)
+        if((colors[0][i] - colors[1][i]).lengthSq() > 0)
+            mismatches++;
+    std::cout << "Mismatches between BMP and tiled lookups: " << mismatches << std::endl;
+    std::remove(tiledName.c_str());
+}
+
 void printColision(bool impact, string number) 
 {
 	std::cout << "El rayo " << number;
@@ -319,7 +502,6 @@ void raytrace(bool option )
     resY = 512;
     Film film(resX, resY);
 
-	Vector3D color = Vector3D();
 	Sphere sphere = createSphere();
 
     /* ******************* */
@@ -341,22 +523,555 @@ void raytrace(bool option )
 	else 	
 		camera = &camOrtho;
 
-	for (size_t i = 0; i < resX; ++i)
-		for (size_t j = 0; j < resY; ++j)
-		{
-			color.x = sphere.rayIntersectP(camera->generateRay((i+.5)/resX, (j+.5)/resY));
-			film.setPixelValue(i, j, color);
-		}
+	std::vector<Shape*> objects;
+	objects.push_back(&sphere);
+	Renderer renderer(*camera, objects);
+	renderer.render(film);
 
     film.save((option ? "Perspective" : "Ortographic") + (string) " Camera");
 }
 
-int main()
+void distributedRaytrace(size_t nWorkers)
+{
+    // Same scene as raytrace(), with the perspective camera
+    size_t resX, resY;
+    resX = 512;
+    resY = 512;
+    Film film(resX, resY);
+
+    Sphere sphere = createSphere();
+    std::vector<Shape*> objects;
+    objects.push_back(&sphere);
+
+    Matrix4x4 cameraToWorld;
+    double fovRadians = Utils::degreesToRadians(60);
+    PerspectiveCamera camera(cameraToWorld, fovRadians, film);
+
+    Renderer renderer(camera, objects);
+    DistributedSettings settings;
+    settings.nWorkers = nWorkers;
+    DistributedRenderer coordinator(renderer, settings);
+
+    DistributedStats stats;
+    if(coordinator.render(film, &stats) != 0)
+        return;
+
+    std::cout << "Rendered " << stats.nTiles << " tiles with " << nWorkers
+              << " workers in " << stats.seconds << " s ("
+              << stats.nReassigned << " reassigned, "
+              << stats.nWorkerFailures << " worker failures, "
+              << stats.nLocalTiles << " rendered locally)" << std::endl;
+    for(size_t w=0; w<stats.workerTiles.size(); w++)
+    {
+        std::cout << "  worker " << w << ": " << stats.workerTiles[w] << " tiles" << std::endl;
+    }
+
+    film.save("Distributed Camera");
+}
+
+void sampledRaytrace(size_t samplesPerPixel, bool resume)
+{
+    // Same scene as raytrace(), with the perspective camera and several
+    // samples per pixel. Progress is checkpointed to "Sampled Camera.rtck"
+    size_t resX, resY;
+    resX = 512;
+    resY = 512;
+    Film film(resX, resY);
+
+    Sphere sphere = createSphere();
+    std::vector<Shape*> objects;
+    objects.push_back(&sphere);
+
+    Matrix4x4 cameraToWorld;
+    double fovRadians = Utils::degreesToRadians(60);
+    PerspectiveCamera camera(cameraToWorld, fovRadians, film);
+
+    CheckpointSettings checkpoint;
+    checkpoint.fileName = "Sampled Camera.rtck";
+    checkpoint.interval = 10.0;
+    checkpoint.resume   = resume;
+
+    Renderer renderer(camera, objects);
+    if(renderer.renderSamples(film, samplesPerPixel, &checkpoint) != 0)
+        return;
+
+    ArenaStats stats = MemoryArena::getStats();
+    std::cout << "Arena block mallocs: " << stats.arenaMallocs << ", arena allocations: "
+              << stats.arenaAllocations << ", reserved: " << stats.bytesReserved
+              << " bytes" << std::endl;
+
+    film.save("Sampled Camera");
+}
+
+void tiledRaytrace(size_t resX, size_t resY)
+{
+    // Same scene as raytrace(), with the perspective camera, at any
+    // resolution: the image is kept in a file, not in memory
+    Sphere sphere = createSphere();
+    std::vector<Shape*> objects;
+    objects.push_back(&sphere);
+
+    Matrix4x4 cameraToWorld;
+    double fovRadians = Utils::degreesToRadians(60);
+    PerspectiveCamera camera(cameraToWorld, fovRadians, resX, resY);
+
+    TiledFilm film(resX, resY, "Tiled Camera.tiles");
+    if(!film.isOpen())
+        return;
+
+    Renderer renderer(camera, objects);
+    if(renderer.render(film) != 0)
+        return;
+    film.save("Tiled Camera");
+
+    TiledFilmStats stats = film.getStats();
+    std::cout << "Tiles stored: " << stats.tileStores << ", loaded: " << stats.tileLoads
+              << ", peak resident: " << stats.peakResident << std::endl;
+}
+
+void progressiveRaytrace()
+{
+    // Same scene as raytrace(), with the perspective camera, rendered coarse
+    // to fine. Every published preview is saved to its own file
+    size_t resX, resY;
+    resX = 512;
+    resY = 512;
+    Film film(resX, resY);
+
+    Sphere sphere = createSphere();
+    std::vector<Shape*> objects;
+    objects.push_back(&sphere);
+
+    Matrix4x4 cameraToWorld;
+    double fovRadians = Utils::degreesToRadians(60);
+    PerspectiveCamera camera(cameraToWorld, fovRadians, film);
+
+    Renderer renderer(camera, objects);
+    ProgressiveRenderer progressive(renderer);
+
+    ProgressiveStats stats;
+    progressive.render(film, [](const Film &preview, size_t stride)
+    {
+        preview.save("Progressive Camera " + std::to_string(stride));
+    }, &stats);
+
+    for(size_t level = 0; level < stats.tracedPerLevel.size(); level++)
+    {
+        std::cout << "Level " << level << ": " << stats.tracedPerLevel[level]
+                  << " pixels traced, ready at " << stats.secondsPerLevel[level] << " s" << std::endl;
+    }
+}
+
+void croppedRaytrace(const CropWindow &window)
+{
+    // Region of the raytrace() scene (perspective camera). The camera maps
+    // the full 512x512 frame, but only the crop is allocated and saved
+    size_t resX, resY;
+    resX = 512;
+    resY = 512;
+
+    Sphere sphere = createSphere();
+    std::vector<Shape*> objects;
+    objects.push_back(&sphere);
+
+    Matrix4x4 cameraToWorld;
+    double fovRadians = Utils::degreesToRadians(60);
+    PerspectiveCamera camera(cameraToWorld, fovRadians, resX, resY);
+
+    Renderer renderer(camera, objects);
+    renderer.setCropWindow(window);
+    const CropWindow &crop = renderer.getCropWindow();
+    if(crop.isEmpty())
+    {
+        std::cout << "The crop window is empty" << std::endl;
+        return;
+    }
+
+    Film film(crop.getWidth(), crop.getHeight());
+    if(renderer.render(film) != 0)
+        return;
+
+    film.save("Cropped Camera");
+    crop.saveMetadata("Cropped Camera", resX, resY);
+}
+
+void wavefrontRaytrace(size_t maxDepth)
+{
+    // A glass sphere in front of a mirror sphere, between two opaque ones
+    size_t resX, resY;
+    resX = 512;
+    resY = 512;
+    Film film(resX, resY);
+
+    Sphere glass(0.8, Matrix4x4::translate(Vector3D(0, 0, 3)));
+    Sphere mirror(1.2, Matrix4x4::translate(Vector3D(0.5, 0.3, 6)));
+    Sphere red(0.6, Matrix4x4::translate(Vector3D(-1.4, -0.4, 4)));
+    Sphere blue(0.6, Matrix4x4::translate(Vector3D(1.6, -0.8, 3.5)));
+    glass.setMaterial(Material(Vector3D(1, 1, 1), 0, 0.95, 1.5));
+    mirror.setMaterial(Material(Vector3D(1, 1, 1), 0.9));
+    red.setMaterial(Material(Vector3D(1, 0.2, 0.2)));
+    blue.setMaterial(Material(Vector3D(0.2, 0.3, 1)));
+
+    std::vector<Shape*> objects;
+    objects.push_back(&glass);
+    objects.push_back(&mirror);
+    objects.push_back(&red);
+    objects.push_back(&blue);
+
+    Matrix4x4 cameraToWorld;
+    double fovRadians = Utils::degreesToRadians(60);
+    PerspectiveCamera camera(cameraToWorld, fovRadians, film);
+
+    WavefrontSettings settings;
+    settings.maxDepth   = maxDepth;
+    settings.background = Vector3D(0.1, 0.1, 0.15);
+    WavefrontRenderer renderer(camera, objects, settings);
+
+    WavefrontStats stats;
+    renderer.render(film, &stats);
+
+    std::cout << "Rendered " << stats.nWaves << " waves in " << stats.seconds << " s ("
+              << stats.intersectSeconds << " s intersecting, " << stats.sortSeconds
+              << " s sorting " << stats.nSortedRays << " rays in " << stats.nSortedQueues
+              << " queues)" << std::endl;
+    for(size_t depth = 0; depth < stats.raysPerDepth.size(); depth++)
+    {
+        std::cout << "  depth " << depth << ": " << stats.raysPerDepth[depth] << " rays" << std::endl;
+    }
+
+    film.save("Wavefront Camera");
+}
+
+void batchRaytrace(std::string manifest, size_t maxConcurrentJobs)
+{
+    // Every job of the manifest (see BatchJob) in this process
+    std::vector<BatchJob> jobs;
+    if(BatchRenderer::readManifest(manifest, jobs) != 0)
+        return;
+
+    BatchSettings settings;
+    settings.maxConcurrentJobs = maxConcurrentJobs;
+    BatchRenderer batch(settings);
+
+    BatchStats stats;
+    batch.run(jobs, &stats);
+
+    std::cout << "Rendered " << stats.nJobs - stats.nFailed << " of " << stats.nJobs
+              << " jobs in " << stats.seconds << " s (" << stats.jobsPerSecond << " jobs/s, "
+              << stats.pixelsPerSecond * 1e-6 << " Msamples/s, " << stats.nScenesLoaded
+              << " scenes loaded)" << std::endl;
+    std::cout << "Latency: mean " << stats.meanLatency << " s, median " << stats.medianLatency
+              << " s, 95% " << stats.p95Latency << " s, max " << stats.maxLatency << " s" << std::endl;
+}
+
+void renderClient(std::string socketPath, std::string jobLine, size_t repeat, bool sharedMemory)
+{
+    // Sends the job (a manifest line) "repeat" times to a running daemon
+    // and saves the last image
+    BatchJob job;
+    if(BatchRenderer::parseJob(jobLine, job) != 0)
+    {
+        std::cout << "Bad job \"" << jobLine << "\"" << std::endl;
+        return;
+    }
+
+    RenderClient client;
+    if(client.connect(socketPath) != 0)
+        return;
+
+    std::vector<float> image;
+    for(size_t i = 0; i < repeat; i++)
+    {
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point start = Clock::now();
+        DaemonProtocol::RenderReply reply;
+        if(client.render(job, sharedMemory, image, &reply) != 0)
+        {
+            std::cout << "Render request failed" << std::endl;
+            return;
+        }
+        std::cout << "Request " << i << ": " << std::chrono::duration<double>(Clock::now() - start).count()
+                  << " s (setup " << reply.setupSeconds << " s, render " << reply.renderSeconds
+                  << " s, " << (reply.cachedView ? "cached view" : "new view") << ", image "
+                  << (sharedMemory ? "in shared memory" : "in-band") << ")" << std::endl;
+    }
+
+    Film film(job.width, job.height);
+    for(size_t y = 0; y < job.height; y++)
+    {
+        for(size_t x = 0; x < job.width; x++)
+        {
+            const float *p = &image[3 * (y * job.width + x)];
+            film.setPixelValue(x, y, Vector3D(p[0], p[1], p[2]));
+        }
+    }
+    film.save(job.output);
+
+    DaemonStats stats;
+    if(client.getStats(stats) == 0)
+    {
+        std::cout << "Daemon: " << stats.nRequests << " requests, " << stats.nViewHits
+                  << " view hits, " << stats.nViewMisses << " view misses, " << stats.nSceneLoads
+                  << " scene loads" << std::endl;
+    }
+}
+
+void sceneGraphExercise(size_t nObjects)
+{
+    // A grid of small spheres, all children of one group node, rendered
+    // before and after turning the group
+    typedef std::chrono::steady_clock Clock;
+    size_t side = (size_t)std::ceil(std::sqrt((double)nObjects));
+    double spacing = 4.0 / side;
+
+    SceneGraph graph;
+    int group = graph.addNode(-1, Matrix4x4::translate(Vector3D(0, 0, 6)));
+    std::vector<Sphere> spheres;
+    spheres.reserve(nObjects);
+    std::vector<int> sphereNodes;
+    for(size_t i = 0; i < nObjects; i++)
+    {
+        Vector3D offset(((i % side) + 0.5) * spacing - 2, ((i / side) + 0.5) * spacing - 2, 0);
+        sphereNodes.push_back(graph.addNode(group, Matrix4x4::translate(offset)));
+        spheres.push_back(Sphere(0.35 * spacing, Matrix4x4()));
+    }
+    std::vector<Shape*> objects;
+    for(size_t i = 0; i < nObjects; i++)
+    {
+        graph.attachShape(sphereNodes[i], &spheres[i]);
+        objects.push_back(&spheres[i]);
+    }
+
+    Matrix4x4 cameraToWorld;
+    PerspectiveCamera camera(cameraToWorld, Utils::degreesToRadians(60), 256, 256);
+    Renderer renderer(camera, objects);
+    Film film(256, 256);
+    renderer.render(film);
+    film.save("Scene graph 0");
+
+    // Turning the group: one inversion and one traversal of the tree...
+    SceneGraphStats before = graph.getStats();
+    Clock::time_point start = Clock::now();
+    graph.setLocal(group, Matrix4x4::translate(Vector3D(0, 0, 6)) *
+                          Matrix4x4::rotate(Utils::degreesToRadians(50), Vector3D(0.3, 1, 0)));
+    graph.update();
+    double graphSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    SceneGraphStats after = graph.getStats();
+
+    // ... against recomputing and inverting every world matrix
+    start = Clock::now();
+    std::vector<Matrix4x4> inverses(nObjects);
+    const Matrix4x4 &groupWorld = graph.getWorld(group);
+    for(size_t i = 0; i < nObjects; i++)
+        (groupWorld * graph.getLocal(sphereNodes[i])).inverse(inverses[i]);
+    double naiveSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double maxError = 0;
+    for(size_t i = 0; i < nObjects; i++)
+    {
+        const Matrix4x4 &cached = spheres[i].getWorldToObject();
+        for(size_t lin = 0; lin < 4; lin++)
+            for(size_t col = 0; col < 4; col++)
+                maxError = std::max(maxError, std::fabs(cached.data[lin][col] - inverses[i].data[lin][col]));
+    }
+
+    std::cout << "Scene graph update: " << graphSeconds << " s (" << after.nNodesUpdated - before.nNodesUpdated
+              << " nodes, " << after.nInversions - before.nInversions << " inversion), per-object inversions: "
+              << naiveSeconds << " s (max difference of the inverses: " << maxError << ")" << std::endl;
+
+    renderer.render(film);
+    film.save("Scene graph 1");
+}
+
+int main(int argc, char *argv[])
 {
     std::string separator = "\n----------------------------------------------\n";
 
     std::cout << separator << "RTIS - Ray Tracer for \"Imatge Sintetica\"" << separator << std::endl;
 
+    // Command line modes
+    //  --workers N            : render the raytrace() scene on N worker processes
+    //  --samples N [--resume] : render it with N samples per pixel, with
+    //                         checkpoints (--resume continues the last one)
+    //  --tiled W H            : render it at W x H on an out-of-core film
+    //  --progressive          : render it coarse to fine, saving the previews
+    //  --crop x0 y0 x1 y1     : render only the pixels [x0, x1) x [y0, y1)
+    //                         of the raytrace() scene
+    //  --regression [--update] [dir] : compare the reference scenes with
+    //                         their golden images and time budgets (in
+    //                         "output/golden" by default), or record them.
+    //                         The exit code is 1 if some scene fails
+    //  --wavefront N          : render a reflective/refractive scene with up
+    //                         to N bounces on the wavefront pipeline
+    //  --convolve R           : blur the filtering exercise image with a disk
+    //                         of radius R, printing the convolution path used
+    //  --boxfilter R          : box blur it (fixed and variable radius up to
+    //                         R) with a summed-area table
+    //  --iterate N            : apply its 9x9 box filter N times, fused and
+    //                         unfused, comparing times and results
+    //  --mipmap FILE [box|lanczos|kaiser] : save the mip levels and a
+    //                         thumbnail of a BMP image
+    //  --rngtest              : Philox known answers, batch vs scalar values
+    //                         and generator throughput
+    //  --arenatest            : arena and pool checks, and the heap
+    //                         allocations of warm render loops (in test
+    //                         builds, see HeapCounter)
+    //  --texbench             : texture lookup throughput per layout/format
+    //  --matbench             : matrix product and batch transform throughput
+    //  --filtertest           : fused against unfused iterative filtering
+    //                         over film sizes, kernels and band settings
+    //  --occlusiontest        : batch against scalar occlusion queries
+    //  --scenegraph N         : move a group of N spheres through the scene
+    //                         graph, against re-inverting every transform
+    //  --texcache FILE [KB]   : random lookups of a BMP through the tile
+    //                         cache with a budget of KB kilobytes
+    //  --batch FILE [K]       : render the jobs of a manifest, K at a time
+    //                         (one per thread by default)
+    //  --daemon [SOCKET]      : serve render requests on a Unix-domain socket
+    //                         ("rtis.sock" by default) until told to stop
+    //  --client SOCKET [--shm] [--repeat N] JOB : send a job (the fields of
+    //                         a manifest line) to the daemon N times
+    //  --client SOCKET --stop : stop the daemon
+    if(argc > 2 && std::string(argv[1]) == "--workers")
+    {
+        distributedRaytrace((size_t)atoi(argv[2]));
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--samples")
+    {
+        bool resume = argc > 3 && std::string(argv[3]) == "--resume";
+        sampledRaytrace((size_t)atoi(argv[2]), resume);
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--regression")
+    {
+        RegressionSettings settings;
+        for(int i = 2; i < argc; i++)
+        {
+            if(std::string(argv[i]) == "--update")
+                settings.update = true;
+            else
+                settings.goldenDir = argv[i];
+        }
+        return Tester::runRegressionTests(settings) == 0 ? 0 : 1;
+    }
+    if(argc > 3 && std::string(argv[1]) == "--tiled")
+    {
+        tiledRaytrace((size_t)atoi(argv[2]), (size_t)atoi(argv[3]));
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--progressive")
+    {
+        progressiveRaytrace();
+        return 0;
+    }
+    if(argc > 5 && std::string(argv[1]) == "--crop")
+    {
+        croppedRaytrace(CropWindow((size_t)atoi(argv[2]), (size_t)atoi(argv[3]),
+                                   (size_t)atoi(argv[4]), (size_t)atoi(argv[5])));
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--wavefront")
+    {
+        wavefrontRaytrace((size_t)atoi(argv[2]));
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--convolve")
+    {
+        convolutionExercise(atof(argv[2]));
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--boxfilter")
+    {
+        boxFilterExercise((size_t)atoi(argv[2]));
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--iterate")
+    {
+        iterativeFilterExercise((size_t)atoi(argv[2]));
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--mipmap")
+    {
+        mipmapExercise(argv[2], argc > 3 ? argv[3] : "box");
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--rngtest")
+    {
+        Tester::testRandomGenerator();
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--arenatest")
+    {
+        Tester::testMemoryArena();
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--texbench")
+    {
+        Tester::testTextureSampling();
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--scenegraph")
+    {
+        sceneGraphExercise((size_t)atoi(argv[2]));
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--matbench")
+    {
+        Tester::testMatrixKernels();
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--filtertest")
+    {
+        Tester::testIterativeFilter();
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--occlusiontest")
+    {
+        Tester::testOcclusionQueries();
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--texcache")
+    {
+        textureCacheExercise(argv[2], argc > 3 ? (size_t)atoi(argv[3]) : 1024);
+        return 0;
+    }
+    if(argc > 2 && std::string(argv[1]) == "--batch")
+    {
+        batchRaytrace(argv[2], argc > 3 ? (size_t)atoi(argv[3]) : 0);
+        return 0;
+    }
+    if(argc > 1 && std::string(argv[1]) == "--daemon")
+    {
+        DaemonSettings settings;
+        if(argc > 2)
+            settings.socketPath = argv[2];
+        return RenderDaemon(settings).serve() == 0 ? 0 : 1;
+    }
+    if(argc > 3 && std::string(argv[1]) == "--client")
+    {
+        if(std::string(argv[3]) == "--stop")
+        {
+            RenderClient client;
+            return client.connect(argv[2]) == 0 && client.shutdown() == 0 ? 0 : 1;
+        }
+
+        bool sharedMemory = false;
+        size_t repeat = 1;
+        std::string jobLine;
+        for(int i = 3; i < argc; i++)
+        {
+            if(std::string(argv[i]) == "--shm")
+                sharedMemory = true;
+            else if(std::string(argv[i]) == "--repeat" && i + 1 < argc)
+                repeat = (size_t)atoi(argv[++i]);
+            else
+                jobLine += std::string(argv[i]) + " ";
+        }
+        renderClient(argv[2], jobLine, repeat, sharedMemory);
+        return 0;
+    }
+
     // ASSIGNMENT 1
     //transformationsExercise();
     //normalTransformExercise();
@@ -0,0 +1,22 @@
+#include "material.h"
+
+// By default, surfaces are opaque and red (the color the renderer has
+// always used for hits)
+Material::Material() : color(1, 0, 0), reflectivity(0), transmissivity(0), eta(1.5)
+{ }
+
+Material::Material(const Vector3D &color_, double reflectivity_,
+                   double transmissivity_, double eta_)
+    : color(color_), reflectivity(reflectivity_),
+      transmissivity(transmissivity_), eta(eta_)
+{ }
+
+bool Material::hasSpecular() const
+{
+    return reflectivity > 0;
+}
+
+bool Material::hasTransmission() const
+{
+    return transmissivity > 0;
+}
@@ -0,0 +1,35 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include "../core/vector3d.h"
+
+/**
+ * @brief The Material class
+ *
+ * Minimal surface description for the secondary-ray pipeline. A path that
+ * reaches the surface keeps (1 - reflectivity - transmissivity) of its
+ * throughput as the flat "color" of the surface, and continues along the
+ * mirror direction with weight "reflectivity" and through the surface with
+ * weight "transmissivity" (a dielectric interface of index "eta", whose
+ * split between reflection and refraction follows the Fresnel equations).
+ */
+class Material
+{
+public:
+    // Constructors
+    Material();
+    Material(const Vector3D &color_, double reflectivity_ = 0,
+             double transmissivity_ = 0, double eta_ = 1.5);
+
+    // Member functions
+    bool hasSpecular() const;
+    bool hasTransmission() const;
+
+    // Material public data
+    Vector3D color;
+    double reflectivity;
+    double transmissivity;
+    double eta; // Index of refraction (the outside medium is assumed to be air)
+};
+
+#endif // MATERIAL_H
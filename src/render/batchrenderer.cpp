@@ -0,0 +1,206 @@
+#include "batchrenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "renderer.h"
+#include "../cameras/ortographic.h"
+#include "../cameras/perspective.h"
+#include "../core/parallel.h"
+#include "../core/utils.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Value below which a fraction q of the (sorted) values lie
+static double percentile(const std::vector<double> &sorted, double q)
+{
+    if(sorted.empty())
+        return 0;
+    size_t rank = (size_t)std::ceil(q * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+BatchRenderer::BatchRenderer(const BatchSettings &settings_) : settings(settings_)
+{ }
+
+SceneCache &BatchRenderer::getSceneCache()
+{
+    return scenes;
+}
+
+int BatchRenderer::parseJob(const std::string &line, BatchJob &job)
+{
+    std::istringstream fields(line);
+    std::string camera;
+    long width, height, samples;
+    if(!(fields >> job.scene >> camera >> width >> height >> samples) ||
+       width <= 0 || height <= 0 || samples <= 0)
+        return -1;
+
+    job.width   = (size_t)width;
+    job.height  = (size_t)height;
+    job.samples = (size_t)samples;
+
+    if(camera == "ortographic")
+    {
+        job.perspective = false;
+    }
+    else if(camera.compare(0, 11, "perspective") == 0)
+    {
+        job.perspective = true;
+        job.fovDegrees = 60;
+        if(camera.size() > 11)
+        {
+            if(camera[11] != ':')
+                return -1;
+            char *end;
+            job.fovDegrees = std::strtod(camera.c_str() + 12, &end);
+            if(*end != '\0' || !(job.fovDegrees > 0 && job.fovDegrees < 180))
+                return -1;
+        }
+    }
+    else
+    {
+        return -1;
+    }
+
+    // The output name is the rest of the line (it may contain spaces)
+    std::getline(fields >> std::ws, job.output);
+    while(!job.output.empty() && std::isspace((unsigned char)job.output.back()))
+        job.output.pop_back();
+    return job.output.empty() ? -1 : 0;
+}
+
+int BatchRenderer::readManifest(const std::string &fileName, std::vector<BatchJob> &jobs)
+{
+    std::ifstream inputFile(fileName);
+    if(!inputFile.is_open())
+    {
+        std::cout << "Problem at BatchRenderer::readManifest() : cannot open \""
+                  << fileName << "\"" << std::endl;
+        return -1;
+    }
+
+    jobs.clear();
+    std::string line;
+    size_t lineNumber = 0;
+    while(std::getline(inputFile, line))
+    {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t\r");
+        if(first == std::string::npos || line[first] == '#')
+            continue;
+
+        BatchJob job;
+        if(parseJob(line, job) != 0)
+        {
+            std::cout << "Problem at BatchRenderer::readManifest() : bad job at line "
+                      << lineNumber << " of \"" << fileName << "\"" << std::endl;
+            return -1;
+        }
+        jobs.push_back(job);
+    }
+    return 0;
+}
+
+int BatchRenderer::runJob(const BatchJob &job)
+{
+    std::shared_ptr<const Scene> scene = scenes.get(job.scene);
+    if(!scene)
+        return -1;
+
+    // Cameras and films are per job; the scene is shared
+    Matrix4x4 cameraToWorld;
+    std::unique_ptr<Camera> camera;
+    if(job.perspective)
+        camera.reset(new PerspectiveCamera(cameraToWorld, Utils::degreesToRadians(job.fovDegrees),
+                                           job.width, job.height));
+    else
+        camera.reset(new OrtographicCamera(cameraToWorld, job.width, job.height));
+
+    Film film(job.width, job.height);
+    Renderer renderer(*camera, scene->getObjects());
+    int result = job.samples > 1 ? renderer.renderSamples(film, job.samples, nullptr, settings.tileSize)
+                                 : renderer.render(film, settings.tileSize);
+    if(result != 0)
+        return -1;
+
+    if(settings.save)
+        return film.save(job.output);
+    return 0;
+}
+
+int BatchRenderer::run(const std::vector<BatchJob> &jobs, BatchStats *stats)
+{
+    Clock::time_point start = Clock::now();
+    size_t loadsBefore = scenes.getLoadCount();
+    std::vector<BatchJobResult> results(jobs.size());
+
+    size_t nRunners = settings.maxConcurrentJobs > 0 ? settings.maxConcurrentJobs
+                                                     : Parallel::getThreadCount();
+    nRunners = std::min(std::max(nRunners, (size_t)1), jobs.size());
+
+    // Each runner takes the next job of the manifest until none is left
+    std::atomic<size_t> nextJob(0);
+    Parallel::forRange(0, nRunners, 1, [&](size_t, size_t)
+    {
+        size_t j;
+        while((j = nextJob.fetch_add(1)) < jobs.size())
+        {
+            BatchJobResult &result = results[j];
+            result.startSeconds = secondsSince(start);
+            result.status = runJob(jobs[j]);
+            result.latencySeconds = secondsSince(start);
+            result.renderSeconds = result.latencySeconds - result.startSeconds;
+            if(result.status != 0)
+            {
+                std::cout << "Problem at BatchRenderer::run() : job " << j << " (\""
+                          << jobs[j].output << "\") failed" << std::endl;
+            }
+        }
+    });
+
+    int nFailed = 0;
+    double pixels = 0, latencySum = 0;
+    std::vector<double> latencies;
+    for(size_t j = 0; j < jobs.size(); j++)
+    {
+        if(results[j].status != 0)
+        {
+            nFailed++;
+            continue;
+        }
+        pixels += (double)jobs[j].width * jobs[j].height * jobs[j].samples;
+        latencies.push_back(results[j].latencySeconds);
+        latencySum += results[j].latencySeconds;
+    }
+
+    if(stats)
+    {
+        std::sort(latencies.begin(), latencies.end());
+        stats->nJobs = jobs.size();
+        stats->nFailed = (size_t)nFailed;
+        stats->nScenesLoaded = scenes.getLoadCount() - loadsBefore;
+        stats->seconds = secondsSince(start);
+        stats->jobsPerSecond = stats->seconds > 0 ? latencies.size() / stats->seconds : 0;
+        stats->pixelsPerSecond = stats->seconds > 0 ? pixels / stats->seconds : 0;
+        stats->meanLatency = latencies.empty() ? 0 : latencySum / latencies.size();
+        stats->medianLatency = percentile(latencies, 0.5);
+        stats->p95Latency = percentile(latencies, 0.95);
+        stats->maxLatency = latencies.empty() ? 0 : latencies.back();
+        stats->jobs = results;
+    }
+    return nFailed;
+}
@@ -0,0 +1,119 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <string>
+#include <vector>
+
+#include "scene.h"
+
+/**
+ * @brief The BatchJob struct
+ *
+ * One render of a manifest. Manifest files hold one job per line:
+ *
+ *     # comment
+ *     <scene> <camera> <width> <height> <samples> <output>
+ *
+ * where <scene> is a name accepted by Scene::load(), <camera> is
+ * "ortographic", "perspective" or "perspective:<fov in degrees>" and
+ * <output> (the rest of the line) is the name of the saved image.
+ */
+struct BatchJob
+{
+    std::string scene;
+    bool perspective;
+    double fovDegrees;
+    size_t width;
+    size_t height;
+    size_t samples;     // Samples per pixel (1: pixel centers only)
+    std::string output;
+
+    BatchJob() : perspective(true), fovDegrees(60), width(512), height(512),
+                 samples(1)
+    { }
+};
+
+/**
+ * @brief The BatchSettings struct
+ */
+struct BatchSettings
+{
+    size_t maxConcurrentJobs; // Jobs in flight at once (0: one per thread)
+    size_t tileSize;
+    bool save;                // Write the images (disable to time renders)
+
+    BatchSettings() : maxConcurrentJobs(0), tileSize(32), save(true)
+    { }
+};
+
+/**
+ * @brief The BatchJobResult struct
+ */
+struct BatchJobResult
+{
+    int status;            // 0 on success
+    double startSeconds;   // Since the start of the batch
+    double renderSeconds;  // Render (and save) time of the job alone
+    double latencySeconds; // From the start of the batch to its end
+
+    BatchJobResult() : status(-1), startSeconds(0), renderSeconds(0), latencySeconds(0)
+    { }
+};
+
+/**
+ * @brief The BatchStats struct
+ */
+struct BatchStats
+{
+    size_t nJobs;
+    size_t nFailed;
+    size_t nScenesLoaded;   // Distinct scenes loaded (shared by their jobs)
+    double seconds;
+    double jobsPerSecond;
+    double pixelsPerSecond; // Samples of every successful job
+    double meanLatency;
+    double medianLatency;
+    double p95Latency;
+    double maxLatency;
+    std::vector<BatchJobResult> jobs;
+
+    BatchStats() : nJobs(0), nFailed(0), nScenesLoaded(0), seconds(0),
+                   jobsPerSecond(0), pixelsPerSecond(0), meanLatency(0),
+                   medianLatency(0), p95Latency(0), maxLatency(0)
+    { }
+};
+
+/**
+ * @brief The BatchRenderer class
+ *
+ * Renders a list of jobs in one process, on the global thread pool. Up to
+ * maxConcurrentJobs jobs run at once, taken in manifest order; each one
+ * renders its tiles with Parallel::forRange(), so a job left alone at the
+ * end of the batch still gets the idle threads. Scenes are loaded once,
+ * on first use, and shared (read-only) by every job that names them.
+ */
+class BatchRenderer
+{
+public:
+    // Constructor(s)
+    BatchRenderer(const BatchSettings &settings_ = BatchSettings());
+
+    // Renders every job. Returns the number of failed jobs
+    int run(const std::vector<BatchJob> &jobs, BatchStats *stats = nullptr);
+
+    // Scenes loaded by previous runs are kept here
+    SceneCache &getSceneCache();
+
+    // Static methods
+    // Reads the jobs of a manifest file. Returns 0 on success
+    static int readManifest(const std::string &fileName, std::vector<BatchJob> &jobs);
+    static int parseJob(const std::string &line, BatchJob &job);
+
+private:
+    int runJob(const BatchJob &job);
+
+    BatchSettings settings;
+    SceneCache scenes;
+};
+
+#endif // BATCHRENDERER_H
@@ -0,0 +1,220 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Version 1 had no crop window: such files are rejected, as they cannot tell
+// which region their sums belong to
+static const char checkpointMagic[8] = { 'R', 'T', 'I', 'S', 'C', 'K', 'P', '2' };
+
+// 64-bit FNV-1a hash, used to detect corrupted or truncated files
+static uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for(size_t i=0; i<size; i++)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Fixed header of the file (56 bytes)
+struct CheckpointHeader
+{
+    char     magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t fullWidth;
+    uint32_t fullHeight;
+    uint32_t samplesDone;
+    uint32_t samplesTotal;
+    uint64_t seed;
+    uint64_t payloadSize; // In bytes
+};
+
+Checkpoint::Checkpoint()
+{ }
+
+bool Checkpoint::save(const std::string &fileName, const CheckpointState &state)
+{
+    CheckpointHeader header;
+    memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.width        = state.width;
+    header.height       = state.height;
+    header.x0           = state.x0;
+    header.y0           = state.y0;
+    header.fullWidth    = state.fullWidth;
+    header.fullHeight   = state.fullHeight;
+    header.samplesDone  = state.samplesDone;
+    header.samplesTotal = state.samplesTotal;
+    header.seed         = state.seed;
+    header.payloadSize  = state.sums.size() * sizeof(double);
+
+    uint64_t checksum = fnv1a(&header, sizeof(header));
+    checksum = fnv1a(state.sums.data(), (size_t)header.payloadSize, checksum);
+
+    std::string tmpName = fileName + ".tmp";
+    FILE *file = fopen(tmpName.c_str(), "wb");
+    if(!file)
+    {
+        std::cout << "Problem at Checkpoint::save() : Could not open file \""
+                  << tmpName << "\"" << std::endl;
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(state.sums.data(), 1, (size_t)header.payloadSize, file) == header.payloadSize &&
+              fwrite(&checksum, sizeof(checksum), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok)
+    {
+        std::cout << "Problem at Checkpoint::save() : Could not write \""
+                  << tmpName << "\"" << std::endl;
+        remove(tmpName.c_str());
+        return false;
+    }
+
+    // rename() does not replace an existing file on Windows
+#ifdef _WIN32
+    remove(fileName.c_str());
+#endif
+    return rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+bool Checkpoint::load(const std::string &fileName, CheckpointState &state)
+{
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if(!file)
+        return false;
+
+    CheckpointHeader header;
+    uint64_t checksum = 0;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, checkpointMagic, sizeof(header.magic)) == 0 &&
+              header.payloadSize == (uint64_t)header.width * header.height * 3 * sizeof(double);
+
+    if(ok)
+    {
+        state.sums.resize((size_t)(header.payloadSize / sizeof(double)));
+        ok = fread(state.sums.data(), 1, (size_t)header.payloadSize, file) == header.payloadSize &&
+             fread(&checksum, sizeof(checksum), 1, file) == 1;
+    }
+    fclose(file);
+
+    if(!ok || checksum != fnv1a(state.sums.data(), (size_t)header.payloadSize,
+                                fnv1a(&header, sizeof(header))))
+    {
+        std::cout << "Problem at Checkpoint::load() : \"" << fileName
+                  << "\" is not a valid checkpoint" << std::endl;
+        state.sums.clear();
+        return false;
+    }
+
+    state.width        = header.width;
+    state.height       = header.height;
+    state.x0           = header.x0;
+    state.y0           = header.y0;
+    state.fullWidth    = header.fullWidth;
+    state.fullHeight   = header.fullHeight;
+    state.samplesDone  = header.samplesDone;
+    state.samplesTotal = header.samplesTotal;
+    state.seed         = header.seed;
+    return true;
+}
+
+void Checkpoint::capture(const Film &accumulation, CheckpointState &state)
+{
+    state.width  = (uint32_t)accumulation.getWidth();
+    state.height = (uint32_t)accumulation.getHeight();
+    state.sums.resize((size_t)state.width * state.height * 3);
+
+    // Vector3D is trivially copyable and tightly packed: rows are copied as
+    // raw blocks of doubles
+    for(size_t h=0; h<accumulation.getHeight(); h++)
+    {
+        memcpy(&state.sums[h * state.width * 3], accumulation.getRow(h),
+               state.width * sizeof(Vector3D));
+    }
+}
+
+void Checkpoint::restore(const CheckpointState &state, Film &accumulation)
+{
+    for(size_t h=0; h<accumulation.getHeight(); h++)
+    {
+        memcpy((void*)accumulation.getRow(h), &state.sums[h * state.width * 3],
+               state.width * sizeof(Vector3D));
+    }
+}
+
+CheckpointWriter::CheckpointWriter(const std::string &fileName_)
+    : fileName(fileName_), hasPending(false), writing(false),
+      stopping(false), nWritten(0)
+{
+    writer = std::thread(&CheckpointWriter::writerLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    writer.join();
+}
+
+void CheckpointWriter::submit(CheckpointState &state)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Swapping keeps the (large) sums buffer from being copied
+        std::swap(pending, state);
+        hasPending = true;
+    }
+    condition.notify_all();
+}
+
+void CheckpointWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return !hasPending && !writing; });
+}
+
+size_t CheckpointWriter::getCheckpointsWritten() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nWritten;
+}
+
+void CheckpointWriter::writerLoop()
+{
+    CheckpointState current;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            writing = false;
+            condition.notify_all();
+            condition.wait(lock, [this] { return stopping || hasPending; });
+
+            if(!hasPending)
+                return;
+
+            std::swap(current, pending);
+            hasPending = false;
+            writing = true;
+        }
+
+        if(Checkpoint::save(fileName, current))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            nWritten++;
+        }
+    }
+}
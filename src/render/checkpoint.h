@@ -0,0 +1,109 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../core/film.h"
+
+/**
+ * @brief The CheckpointSettings struct
+ */
+struct CheckpointSettings
+{
+    std::string fileName; // Checkpoint file (written atomically)
+    double interval;      // Minimum number of seconds between two checkpoints
+    bool resume;          // Continue from fileName, if it exists
+
+    CheckpointSettings() : fileName("render.rtck"), interval(30.0), resume(false)
+    { }
+};
+
+/**
+ * @brief The CheckpointState struct
+ *
+ * Everything needed to continue a render: the per-pixel sums of the samples
+ * taken so far and the sampler position. Samples are a pure function of
+ * (pixel, sample index, seed) through the counter-based generator, so the
+ * sampler state is just the number of completed passes and the seed.
+ * The sums cover the crop window (x0, y0, width, height) of a fullWidth x
+ * fullHeight image.
+ */
+struct CheckpointState
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t fullWidth;
+    uint32_t fullHeight;
+    uint32_t samplesDone;
+    uint32_t samplesTotal;
+    uint64_t seed;
+    std::vector<double> sums; // width * height * 3, row by row
+
+    CheckpointState() : width(0), height(0), x0(0), y0(0), fullWidth(0), fullHeight(0),
+                        samplesDone(0), samplesTotal(0), seed(0)
+    { }
+};
+
+class Checkpoint
+{
+public:
+    Checkpoint();
+
+    // Binary format: 56-byte header, the sums as raw doubles and a 64-bit
+    // FNV-1a checksum of everything before it. save() writes to a temporary
+    // file and renames it, so a crash never leaves a truncated checkpoint
+    static bool save(const std::string &fileName, const CheckpointState &state);
+    static bool load(const std::string &fileName, CheckpointState &state);
+
+    // Film <-> state conversions
+    static void capture(const Film &accumulation, CheckpointState &state);
+    static void restore(const CheckpointState &state, Film &accumulation);
+};
+
+/**
+ * @brief The CheckpointWriter class
+ *
+ * Background thread that writes the snapshots submitted by the render loop.
+ * Only the latest snapshot is kept: if the disk is slower than the render,
+ * intermediate checkpoints are skipped instead of queued.
+ */
+class CheckpointWriter
+{
+public:
+    // Constructor(s)
+    explicit CheckpointWriter(const std::string &fileName_);
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    // Destructor (writes the pending snapshot, if any)
+    ~CheckpointWriter();
+
+    // Takes ownership of the state contents (the caller's copy is emptied)
+    void submit(CheckpointState &state);
+    // Blocks until every submitted snapshot is on disk
+    void flush();
+
+    size_t getCheckpointsWritten() const;
+
+private:
+    void writerLoop();
+
+    std::string fileName;
+    CheckpointState pending;
+    bool hasPending;
+    bool writing;
+    bool stopping;
+    size_t nWritten;
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+    std::thread writer;
+};
+
+#endif // CHECKPOINT_H
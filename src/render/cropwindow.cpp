@@ -0,0 +1,67 @@
+#include "cropwindow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+CropWindow::CropWindow() : x0(0), y0(0), x1(0), y1(0)
+{ }
+
+CropWindow::CropWindow(size_t x0_, size_t y0_, size_t x1_, size_t y1_)
+    : x0(x0_), y0(y0_), x1(x1_), y1(y1_)
+{ }
+
+size_t CropWindow::getWidth() const
+{
+    return x1 > x0 ? x1 - x0 : 0;
+}
+
+size_t CropWindow::getHeight() const
+{
+    return y1 > y0 ? y1 - y0 : 0;
+}
+
+bool CropWindow::isEmpty() const
+{
+    return getWidth() == 0 || getHeight() == 0;
+}
+
+CropWindow CropWindow::clamped(size_t width, size_t height) const
+{
+    return CropWindow(std::min(x0, width), std::min(y0, height),
+                      std::min(x1, width), std::min(y1, height));
+}
+
+int CropWindow::saveMetadata(std::string name, size_t fullWidth, size_t fullHeight) const
+{
+    std::ofstream outputFile(name + ".crop");
+    if(!outputFile.is_open())
+    {
+        std::cout << "Problem at CropWindow::saveMetadata() : Could not open file \""
+                  << name << ".crop" << "\"" << std::endl;
+        return 1;
+    }
+
+    outputFile << "full " << fullWidth << " " << fullHeight << "\n"
+               << "offset " << x0 << " " << y0 << "\n"
+               << "size " << getWidth() << " " << getHeight() << "\n";
+    return outputFile.good() ? 0 : 1;
+}
+
+CropWindow CropWindow::fullFrame(size_t width, size_t height)
+{
+    return CropWindow(0, 0, width, height);
+}
+
+// A pixel belongs to the crop when its center lies inside the rectangle
+CropWindow CropWindow::fromNdc(double u0, double v0, double u1, double v1,
+                               size_t width, size_t height)
+{
+    double w = (double)width, h = (double)height;
+    double cx0 = std::ceil(std::min(u0, u1) * w - .5), cx1 = std::floor(std::max(u0, u1) * w - .5) + 1;
+    double cy0 = std::ceil(std::min(v0, v1) * h - .5), cy1 = std::floor(std::max(v0, v1) * h - .5) + 1;
+
+    return CropWindow((size_t)std::min(std::max(cx0, 0.0), w), (size_t)std::min(std::max(cy0, 0.0), h),
+                      (size_t)std::min(std::max(cx1, 0.0), w), (size_t)std::min(std::max(cy1, 0.0), h));
+}
@@ -0,0 +1,44 @@
+#ifndef CROPWINDOW_H
+#define CROPWINDOW_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief The CropWindow struct
+ *
+ * Region [x0, x1) x [y0, y1) of the full image, in pixel coordinates, that
+ * a render is restricted to. The camera keeps mapping the full image, so
+ * every pixel of the crop gets exactly the value it has in a full-frame
+ * render; only the film (of getWidth() x getHeight() pixels) is smaller.
+ */
+struct CropWindow
+{
+    // Constructors
+    CropWindow();
+    CropWindow(size_t x0_, size_t y0_, size_t x1_, size_t y1_);
+
+    // Member functions
+    size_t getWidth()  const;
+    size_t getHeight() const;
+    bool isEmpty() const;
+    // Intersection with a width x height image
+    CropWindow clamped(size_t width, size_t height) const;
+    // Writes "<name>.crop", a small text file with the position of the
+    // crop in the full image, next to the "<name>.bmp" of the crop.
+    // Returns 0 on success
+    int saveMetadata(std::string name, size_t fullWidth, size_t fullHeight) const;
+
+    // Static methods
+    static CropWindow fullFrame(size_t width, size_t height);
+    // Pixels of a width x height image inside the NDC rectangle
+    // [u0, u1] x [v0, v1]
+    static CropWindow fromNdc(double u0, double v0, double u1, double v1,
+                              size_t width, size_t height);
+
+    // Structure data
+    size_t x0, y0;
+    size_t x1, y1;
+};
+
+#endif // CROPWINDOW_H
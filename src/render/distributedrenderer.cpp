@@ -0,0 +1,384 @@
+#include "distributedrenderer.h"
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+DistributedRenderer::DistributedRenderer(const Renderer &renderer_,
+                                         const DistributedSettings &settings_)
+    : renderer(renderer_), settings(settings_)
+{ }
+
+#ifdef _WIN32
+
+int DistributedRenderer::render(Film &film, DistributedStats *stats) const
+{
+    // No fork() nor socketpair(): fall back to the local thread pool
+    if(renderer.checkFilmSize(film.getWidth(), film.getHeight(), "DistributedRenderer::render()") != 0)
+        return -1;
+
+    std::cout << "DistributedRenderer: multi-process rendering is not available "
+                 "on this platform, rendering locally" << std::endl;
+    renderer.render(film, settings.tileSize);
+    if(stats)
+    {
+        *stats = DistributedStats();
+        const CropWindow &crop = renderer.getCropWindow();
+        stats->nTiles = Tile::split(crop.x0, crop.y0, crop.x1, crop.y1,
+                                    settings.tileSize).size();
+        stats->nLocalTiles = stats->nTiles;
+    }
+    return 0;
+}
+
+#else
+
+// Wire format (both ends run the same binary, so native layout is fine)
+static const uint32_t tileMagic = 0x52544953; // "RTIS"
+
+struct TileMessage
+{
+    uint32_t magic;
+    uint32_t pad;
+    uint64_t tileIndex;
+    uint64_t x0, y0, x1, y1;
+};
+
+static bool writeAll(int fd, const void *buffer, size_t size)
+{
+    const char *p = (const char *)buffer;
+    while(size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *buffer, size_t size)
+{
+    char *p = (char *)buffer;
+    while(size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// Worker process main loop: render every tile received until the
+// coordinator closes the socket
+static void workerLoop(const Renderer &renderer, int fd)
+{
+    TileMessage msg;
+    std::vector<Vector3D> pixels;
+
+    while(readAll(fd, &msg, sizeof(msg)) && msg.magic == tileMagic)
+    {
+        Tile tile((size_t)msg.tileIndex, (size_t)msg.x0, (size_t)msg.y0,
+                  (size_t)msg.x1, (size_t)msg.y1);
+
+        pixels.resize(tile.getPixelCount());
+        renderer.renderTile(tile, pixels.data());
+
+        // Vector3D is trivially copyable: the pixels go out as raw doubles
+        if(!writeAll(fd, &msg, sizeof(msg)) ||
+           !writeAll(fd, pixels.data(), pixels.size() * sizeof(Vector3D)))
+        {
+            return;
+        }
+    }
+}
+
+// Coordinator-side view of a worker process
+struct WorkerState
+{
+    pid_t pid;
+    int fd;
+    bool alive;
+    bool busy;
+    size_t tile;
+    std::chrono::steady_clock::time_point start;
+};
+
+int DistributedRenderer::render(Film &film, DistributedStats *stats) const
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point renderStart = Clock::now();
+
+    // Results are copied into the film at their place in the crop window
+    if(renderer.checkFilmSize(film.getWidth(), film.getHeight(), "DistributedRenderer::render()") != 0)
+        return -1;
+
+    const CropWindow &crop = renderer.getCropWindow();
+    std::vector<Tile> tiles = Tile::split(crop.x0, crop.y0, crop.x1, crop.y1,
+                                          settings.tileSize);
+    std::vector<bool> done(tiles.size(), false);
+    std::vector<size_t> inFlight(tiles.size(), 0); // Copies being rendered
+    std::deque<size_t> pending;
+    for(size_t t=0; t<tiles.size(); t++)
+        pending.push_back(t);
+
+    DistributedStats localStats;
+    localStats.nTiles = tiles.size();
+    localStats.workerTiles.assign(settings.nWorkers, 0);
+
+    // A write to a worker that just died must fail, not kill us
+    void (*oldSigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+
+    // Spawn the workers
+    std::vector<WorkerState> workers;
+    for(size_t w=0; w<settings.nWorkers; w++)
+    {
+        int fds[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        {
+            std::cout << "DistributedRenderer: socketpair() failed" << std::endl;
+            break;
+        }
+
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            // Worker: drop the coordinator ends inherited so far
+            close(fds[0]);
+            for(size_t k=0; k<workers.size(); k++)
+                close(workers[k].fd);
+
+            workerLoop(renderer, fds[1]);
+            close(fds[1]);
+            // Skip the destructors of the state copied from the coordinator
+            _exit(0);
+        }
+
+        close(fds[1]);
+        if(pid < 0)
+        {
+            std::cout << "DistributedRenderer: fork() failed" << std::endl;
+            close(fds[0]);
+            break;
+        }
+
+        WorkerState state;
+        state.pid = pid;
+        state.fd = fds[0];
+        state.alive = true;
+        state.busy = false;
+        state.tile = 0;
+        workers.push_back(state);
+    }
+
+    size_t nDone = 0;
+    std::vector<double> payload;
+
+    while(nDone < tiles.size())
+    {
+        // Hand work to the idle workers
+        size_t nAlive = 0;
+        for(size_t w=0; w<workers.size(); w++)
+        {
+            WorkerState &worker = workers[w];
+            if(!worker.alive)
+                continue;
+            nAlive++;
+            if(worker.busy)
+                continue;
+
+            // Next pending tile (skipping the ones a duplicate already delivered)
+            long next = -1;
+            while(!pending.empty() && next < 0)
+            {
+                size_t t = pending.front();
+                pending.pop_front();
+                if(!done[t])
+                    next = (long)t;
+            }
+
+            // Nothing pending: duplicate the oldest straggler, if any
+            if(next < 0)
+            {
+                Clock::time_point now = Clock::now();
+                double oldest = settings.tileTimeout;
+                for(size_t k=0; k<workers.size(); k++)
+                {
+                    if(!workers[k].alive || !workers[k].busy || inFlight[workers[k].tile] > 1)
+                        continue;
+                    double elapsed = std::chrono::duration<double>(now - workers[k].start).count();
+                    if(elapsed > oldest)
+                    {
+                        oldest = elapsed;
+                        next = (long)workers[k].tile;
+                    }
+                }
+                if(next < 0)
+                    continue;
+                localStats.nReassigned++;
+            }
+
+            const Tile &tile = tiles[(size_t)next];
+            TileMessage msg;
+            msg.magic = tileMagic;
+            msg.pad = 0;
+            msg.tileIndex = (uint64_t)next;
+            msg.x0 = tile.x0; msg.y0 = tile.y0;
+            msg.x1 = tile.x1; msg.y1 = tile.y1;
+
+            if(writeAll(worker.fd, &msg, sizeof(msg)))
+            {
+                worker.busy = true;
+                worker.tile = (size_t)next;
+                worker.start = Clock::now();
+                inFlight[(size_t)next]++;
+            }
+            else
+            {
+                // Broken socket: the worker is gone
+                worker.alive = false;
+                close(worker.fd);
+                localStats.nWorkerFailures++;
+                pending.push_front((size_t)next);
+                nAlive--;
+            }
+        }
+
+        // Every worker is lost: finish the job here
+        if(nAlive == 0)
+        {
+            while(!pending.empty())
+            {
+                size_t t = pending.front();
+                pending.pop_front();
+                if(done[t])
+                    continue;
+                renderer.renderTile(tiles[t], film);
+                done[t] = true;
+                nDone++;
+                localStats.nLocalTiles++;
+            }
+            // Tiles lost together with their worker
+            for(size_t t=0; t<tiles.size(); t++)
+            {
+                if(!done[t])
+                {
+                    renderer.renderTile(tiles[t], film);
+                    done[t] = true;
+                    nDone++;
+                    localStats.nLocalTiles++;
+                }
+            }
+            break;
+        }
+
+        // Wait for results (with a timeout, to notice stragglers)
+        std::vector<pollfd> fds;
+        std::vector<size_t> fdWorker;
+        for(size_t w=0; w<workers.size(); w++)
+        {
+            if(workers[w].alive && workers[w].busy)
+            {
+                pollfd p;
+                p.fd = workers[w].fd;
+                p.events = POLLIN;
+                p.revents = 0;
+                fds.push_back(p);
+                fdWorker.push_back(w);
+            }
+        }
+
+        int timeoutMs = (int)(settings.tileTimeout * 250) + 1;
+        if(poll(fds.data(), fds.size(), timeoutMs) <= 0)
+            continue;
+
+        for(size_t i=0; i<fds.size(); i++)
+        {
+            if(fds[i].revents == 0)
+                continue;
+
+            WorkerState &worker = workers[fdWorker[i]];
+            const Tile &tile = tiles[worker.tile];
+            payload.resize(tile.getPixelCount() * 3);
+
+            TileMessage msg;
+            bool ok = readAll(worker.fd, &msg, sizeof(msg)) &&
+                      msg.magic == tileMagic && msg.tileIndex == worker.tile &&
+                      readAll(worker.fd, payload.data(), payload.size() * sizeof(double));
+
+            worker.busy = false;
+            inFlight[worker.tile]--;
+
+            if(!ok)
+            {
+                // The worker crashed (or sent garbage): requeue its tile
+                worker.alive = false;
+                close(worker.fd);
+                localStats.nWorkerFailures++;
+                if(!done[worker.tile])
+                {
+                    pending.push_front(worker.tile);
+                    localStats.nReassigned++;
+                }
+                continue;
+            }
+
+            // Merge the tile, unless a duplicate got here first
+            if(!done[worker.tile])
+            {
+                const double *p = payload.data();
+                for(size_t row = tile.y0; row < tile.y1; row++)
+                {
+                    Vector3D *out = film.getRow(row - crop.y0) + tile.x0 - crop.x0;
+                    for(size_t x = 0; x < tile.getWidth(); x++, p += 3)
+                        out[x] = Vector3D(p[0], p[1], p[2]);
+                }
+                done[worker.tile] = true;
+                nDone++;
+                localStats.workerTiles[fdWorker[i]]++;
+            }
+        }
+    }
+
+    // Closing the sockets makes the workers leave their loop; the ones still
+    // busy with a redundant copy are stopped right away
+    for(size_t w=0; w<workers.size(); w++)
+    {
+        if(workers[w].alive)
+        {
+            close(workers[w].fd);
+            if(workers[w].busy)
+                kill(workers[w].pid, SIGTERM);
+        }
+        waitpid(workers[w].pid, nullptr, 0);
+    }
+
+    signal(SIGPIPE, oldSigpipe);
+
+    localStats.seconds = std::chrono::duration<double>(Clock::now() - renderStart).count();
+    if(stats)
+        *stats = localStats;
+
+    return 0;
+}
+
+#endif // _WIN32
@@ -0,0 +1,67 @@
+#ifndef DISTRIBUTEDRENDERER_H
+#define DISTRIBUTEDRENDERER_H
+
+#include <vector>
+
+#include "renderer.h"
+
+/**
+ * @brief The DistributedSettings struct
+ */
+struct DistributedSettings
+{
+    size_t nWorkers;     // Number of worker processes
+    size_t tileSize;     // Tile side, in pixels
+    double tileTimeout;  // Seconds after which a tile still in flight is
+                         //  also handed to an idle worker
+
+    DistributedSettings() : nWorkers(4), tileSize(32), tileTimeout(2.0)
+    { }
+};
+
+/**
+ * @brief The DistributedStats struct
+ */
+struct DistributedStats
+{
+    size_t nTiles;
+    size_t nReassigned;           // Tiles re-sent after a failure or timeout
+    size_t nWorkerFailures;
+    size_t nLocalTiles;           // Tiles rendered by the coordinator itself
+    std::vector<size_t> workerTiles; // Tiles delivered by each worker
+    double seconds;
+
+    DistributedStats() : nTiles(0), nReassigned(0), nWorkerFailures(0),
+                         nLocalTiles(0), seconds(0)
+    { }
+};
+
+/**
+ * @brief The DistributedRenderer class
+ *
+ * Coordinator that forks nWorkers processes, connected through local
+ * sockets, and hands them tiles to render on demand. Workers inherit the
+ * scene through fork(), so only tile coordinates and pixel values travel
+ * through the sockets. The tile of a worker that dies is requeued, and a
+ * tile that takes longer than tileTimeout is duplicated on an idle worker
+ * (the first copy to arrive wins). If every worker is lost, the coordinator
+ * finishes the remaining tiles itself.
+ */
+class DistributedRenderer
+{
+public:
+    // Constructor(s)
+    DistributedRenderer(const Renderer &renderer_,
+                        const DistributedSettings &settings_ = DistributedSettings());
+    DistributedRenderer() = delete;
+
+    // Renders the crop window of the renderer (by default, the full image)
+    // into film. Returns 0 on success
+    int render(Film &film, DistributedStats *stats = nullptr) const;
+
+private:
+    const Renderer &renderer;
+    DistributedSettings settings;
+};
+
+#endif // DISTRIBUTEDRENDERER_H
@@ -0,0 +1,51 @@
+#include "frustum.h"
+
+Frustum::Frustum(const Camera &camera, double u0, double v0, double u1, double v1)
+{
+    // Corner rays, in order around the rectangle
+    Ray corner[4] = { camera.generateRay(u0, v0), camera.generateRay(u1, v0),
+                      camera.generateRay(u1, v1), camera.generateRay(u0, v1) };
+    Ray center = camera.generateRay((u0 + u1) * .5, (v0 + v1) * .5);
+    Vector3D inside = center.o + center.d;
+
+    for(int i = 0; i < 4; i++)
+    {
+        // Plane through the rays of edge (i, i+1): p1 and p2 on the first
+        // ray, p3 on the second. For a perspective camera both rays share
+        // the origin, so p1 and p3 are not taken at the origins
+        const Ray &a = corner[i];
+        const Ray &b = corner[(i + 1) % 4];
+        Vector3D p1 = a.o;
+        Vector3D p2 = a.o + a.d;
+        Vector3D p3 = b.o + b.d;
+
+        Vector3D n = cross(p2 - p1, p3 - p1);
+        if(dot(n, inside - p1) < 0)
+            n = -n;
+        normal[i] = n;
+        offset[i] = -dot(n, p1);
+    }
+
+    // Near plane: nothing behind the camera is visible
+    normal[4] = center.d;
+    offset[4] = -dot(center.d, center.o);
+}
+
+bool Frustum::intersects(const Bounds3D &bounds) const
+{
+    if(bounds.isEmpty())
+        return false;
+
+    for(int i = 0; i < 5; i++)
+    {
+        // Corner of the box farthest along the plane normal: if even that
+        // one is outside, the whole box is
+        const Vector3D &n = normal[i];
+        Vector3D p(n.x >= 0 ? bounds.pMax.x : bounds.pMin.x,
+                   n.y >= 0 ? bounds.pMax.y : bounds.pMin.y,
+                   n.z >= 0 ? bounds.pMax.z : bounds.pMin.z);
+        if(dot(n, p) + offset[i] < 0)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "../core/bounds3d.h"
+#include "../cameras/camera.h"
+
+/**
+ * @brief The Frustum class
+ *
+ * Region of space covered by the camera rays through the image rectangle
+ * [u0, u1] x [v0, v1] (in NDC), bounded by four side planes and a near plane
+ * at the camera. Each side plane contains the corner rays of one edge of
+ * the rectangle, so the same construction serves perspective cameras (a
+ * pyramid) and orthographic ones (a prism).
+ */
+class Frustum
+{
+public:
+    // Constructors
+    Frustum(const Camera &camera, double u0, double v0, double u1, double v1);
+    Frustum() = delete;
+
+    // Conservative test: false only if the box is completely outside
+    bool intersects(const Bounds3D &bounds) const;
+
+private:
+    // Planes dot(normal[i], p) + offset[i] >= 0 for every p inside
+    Vector3D normal[5];
+    double offset[5];
+};
+
+#endif // FRUSTUM_H
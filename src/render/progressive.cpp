@@ -0,0 +1,151 @@
+#include "progressive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdint.h>
+
+#include "../core/memoryarena.h"
+#include "../core/parallel.h"
+
+ProgressiveRenderer::ProgressiveRenderer(const Renderer &renderer_,
+                                         const ProgressiveSettings &settings_)
+    : renderer(renderer_), settings(settings_)
+{
+    // Levels must go from coarse to fine, and the last one must trace the
+    // pixels that are still missing
+    std::vector<size_t> &strides = settings.strides;
+    strides.erase(std::remove(strides.begin(), strides.end(), 0), strides.end());
+    std::sort(strides.begin(), strides.end(), std::greater<size_t>());
+    strides.erase(std::unique(strides.begin(), strides.end()), strides.end());
+    if(strides.empty() || strides.back() != 1)
+        strides.push_back(1);
+}
+
+int ProgressiveRenderer::render(Film &film, const PublishCallback &publish,
+                                ProgressiveStats *stats) const
+{
+    if(renderer.checkFilmSize(film.getWidth(), film.getHeight(), "ProgressiveRenderer::render()") != 0)
+        return -1;
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point lastPublish = start;
+    bool published = false;
+
+    const CropWindow &crop = renderer.getCropWindow();
+    size_t width  = crop.getWidth();
+    size_t height = crop.getHeight();
+
+    // Pixels traced so far are kept (and never traced again) in "traced"
+    Film traced(width, height);
+    std::vector<uint8_t> isTraced(width * height, 0);
+    std::vector<Tile> tiles = Tile::split(crop.x0, crop.y0, crop.x1, crop.y1,
+                                          settings.tileSize);
+
+    if(stats)
+        *stats = ProgressiveStats();
+
+    for(size_t level = 0; level < settings.strides.size(); level++)
+    {
+        size_t stride = settings.strides[level];
+        std::vector<size_t> tileTraced(tiles.size(), 0);
+
+        Parallel::forRange(0, tiles.size(), 1, [&](size_t begin, size_t end)
+        {
+            MemoryArena &arena = MemoryArena::forThread(ArenaLifetime::Tile);
+            for(size_t t = begin; t < end; t++)
+            {
+                const Tile &tile = tiles[t];
+                ArenaScope scope(arena);
+                ShapeList candidates = renderer.getTileCandidates(tile, arena);
+
+                // First row and column of the tile on the grid of the level
+                size_t y = tile.y0 - crop.y0, x = tile.x0 - crop.x0;
+                size_t firstY = (y + stride - 1) / stride * stride;
+                size_t firstX = (x + stride - 1) / stride * stride;
+
+                for(y = firstY; y < tile.y1 - crop.y0; y += stride)
+                {
+                    for(x = firstX; x < tile.x1 - crop.x0; x += stride)
+                    {
+                        if(isTraced[y * width + x])
+                            continue;
+                        Vector3D color = renderer.computePixel(x + crop.x0, y + crop.y0, candidates);
+                        traced.setPixelValue(x, y, color);
+                        isTraced[y * width + x] = 1;
+                        tileTraced[t]++;
+                    }
+                }
+            }
+        });
+
+        upsample(traced, stride, film);
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if(stats)
+        {
+            size_t nTraced = 0;
+            for(size_t t = 0; t < tiles.size(); t++)
+                nTraced += tileTraced[t];
+            stats->tracedPerLevel.push_back(nTraced);
+            stats->secondsPerLevel.push_back(seconds);
+        }
+
+        bool last = level + 1 == settings.strides.size();
+        if(publish && (last || !published ||
+           std::chrono::duration<double>(Clock::now() - lastPublish).count() >= settings.publishInterval))
+        {
+            publish(film, stride);
+            lastPublish = Clock::now();
+            published = true;
+            if(stats)
+                stats->nPublished++;
+        }
+    }
+    return 0;
+}
+
+void ProgressiveRenderer::upsample(const Film &traced, size_t stride, Film &film) const
+{
+    size_t width  = traced.getWidth();
+    size_t height = traced.getHeight();
+    if(width == 0 || height == 0)
+        return;
+
+    // Last grid column / row inside the image: pixels beyond them
+    // are extended from them
+    size_t lastX = (width - 1) / stride * stride;
+    size_t lastY = (height - 1) / stride * stride;
+
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t y = begin; y < end; y++)
+        {
+            size_t y0 = std::min(y / stride * stride, lastY);
+            size_t y1 = std::min(y0 + stride, lastY);
+            double ty = y1 > y0 ? (double)(y - y0) / (y1 - y0) : 0;
+
+            const Vector3D *row0 = traced.getRow(y0);
+            const Vector3D *row1 = traced.getRow(y1);
+            Vector3D *out = film.getRow(y);
+
+            for(size_t x = 0; x < width; x++)
+            {
+                size_t x0 = std::min(x / stride * stride, lastX);
+                size_t x1 = std::min(x0 + stride, lastX);
+
+                if(settings.filter == UpsampleFilter::Nearest)
+                {
+                    size_t nx = (x - x0) * 2 < stride || x1 == x0 ? x0 : x1;
+                    out[x] = (y - y0) * 2 < stride || y1 == y0 ? row0[nx] : row1[nx];
+                    continue;
+                }
+
+                double tx = x1 > x0 ? (double)(x - x0) / (x1 - x0) : 0;
+                Vector3D top    = row0[x0] * (1 - tx) + row0[x1] * tx;
+                Vector3D bottom = row1[x0] * (1 - tx) + row1[x1] * tx;
+                out[x] = top * (1 - ty) + bottom * ty;
+            }
+        }
+    });
+}
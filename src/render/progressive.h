@@ -0,0 +1,85 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include <functional>
+#include <vector>
+
+#include "renderer.h"
+
+/**
+ * @brief The UpsampleFilter enum
+ *
+ * How the pixels not traced yet are filled from the traced ones
+ */
+enum class UpsampleFilter { Nearest, Bilinear };
+
+/**
+ * @brief The ProgressiveSettings struct
+ */
+struct ProgressiveSettings
+{
+    std::vector<size_t> strides; // Pixel spacing of each level (coarse to fine)
+    UpsampleFilter filter;
+    double publishInterval;      // Minimum seconds between two published
+                                 //  images (the last level is always published)
+    size_t tileSize;
+
+    ProgressiveSettings() : filter(UpsampleFilter::Bilinear), publishInterval(0),
+                            tileSize(32)
+    {
+        strides.push_back(16);
+        strides.push_back(4);
+        strides.push_back(1);
+    }
+};
+
+/**
+ * @brief The ProgressiveStats struct
+ */
+struct ProgressiveStats
+{
+    std::vector<size_t> tracedPerLevel;   // Pixels traced by each level
+    std::vector<double> secondsPerLevel;  // Time at which each level was ready
+    size_t nPublished;
+
+    ProgressiveStats() : nPublished(0)
+    { }
+};
+
+/**
+ * @brief The ProgressiveRenderer class
+ *
+ * Coarse-to-fine preview. Level i traces the pixels whose coordinates
+ * (relative to the crop window of the renderer) are multiples of
+ * strides[i], skipping those already traced by previous levels, and fills
+ * the rest of the film by upsampling the traced ones. A usable image is
+ * thus available after tracing 1/256 of the pixels (stride 16), and the
+ * last level (stride 1) gives exactly the image of Renderer::render().
+ */
+class ProgressiveRenderer
+{
+public:
+    // Called with the film after a level is complete; "stride" is the
+    // pixel spacing of that level
+    typedef std::function<void(const Film &film, size_t stride)> PublishCallback;
+
+    // Constructor(s)
+    ProgressiveRenderer(const Renderer &renderer_,
+                        const ProgressiveSettings &settings_ = ProgressiveSettings());
+    ProgressiveRenderer() = delete;
+
+    // Renders into film (of the size of the crop window of the renderer).
+    // Returns 0 on success
+    int render(Film &film, const PublishCallback &publish = PublishCallback(),
+               ProgressiveStats *stats = nullptr) const;
+
+private:
+    // Fills every pixel of film from the pixels traced so far, which lie
+    // (at least) on the grid of the given stride
+    void upsample(const Film &traced, size_t stride, Film &film) const;
+
+    const Renderer &renderer;
+    ProgressiveSettings settings;
+};
+
+#endif // PROGRESSIVE_H
@@ -0,0 +1,101 @@
+#include "raysort.h"
+
+#include <algorithm>
+
+RaySort::RaySort()
+{ }
+
+// Cell of a [0, 1] coordinate on a 2^mortonBits grid
+static uint32_t quantize(double value)
+{
+    const double cells = (double)((1u << RaySort::mortonBits) - 1);
+    return (uint32_t)(std::min(std::max(value, 0.0), 1.0) * cells);
+}
+
+uint32_t RaySort::computeKey(const Ray &ray, RaySortMode mode,
+                             const Vector3D &originMin, const Vector3D &originScale)
+{
+    uint32_t octant = directionOctant(ray.d);
+    if(mode != RaySortMode::Morton)
+        return octant;
+
+    // Quantize the origin on a 2^mortonBits grid over the queue bounds
+    Vector3D p = ray.o - originMin;
+    uint32_t x = quantize(p.x * originScale.x);
+    uint32_t y = quantize(p.y * originScale.y);
+    uint32_t z = quantize(p.z * originScale.z);
+
+    return (octant << (3 * mortonBits)) | mortonCode(x, y, z);
+}
+
+unsigned RaySort::getKeyBits(RaySortMode mode)
+{
+    switch(mode)
+    {
+    case RaySortMode::None:   return 0;
+    case RaySortMode::Octant: return 3;
+    default:                  return 3 + 3 * mortonBits;
+    }
+}
+
+uint32_t RaySort::directionOctant(const Vector3D &d)
+{
+    return (d.x < 0 ? 1u : 0u) | (d.y < 0 ? 2u : 0u) | (d.z < 0 ? 4u : 0u);
+}
+
+// Spreads the lowest 10 bits of v so that there are two zeros between them
+static uint32_t expandBits(uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v <<  8)) & 0x0300f00f;
+    v = (v | (v <<  4)) & 0x030c30c3;
+    v = (v | (v <<  2)) & 0x09249249;
+    return v;
+}
+
+uint32_t RaySort::mortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+    return (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+}
+
+void RaySort::sortOrder(const std::vector<uint32_t> &keys, unsigned keyBits,
+                        std::vector<uint32_t> &order, std::vector<uint32_t> &scratch)
+{
+    order.resize(keys.size());
+    scratch.resize(keys.size());
+    sortOrder(keys.data(), keys.size(), keyBits, order.data(), scratch.data());
+}
+
+void RaySort::sortOrder(const uint32_t *keys, size_t n, unsigned keyBits,
+                        uint32_t *order, uint32_t *scratch)
+{
+    uint32_t *result = order;
+    for(size_t i = 0; i < n; i++)
+    {
+        result[i] = (uint32_t)i;
+    }
+
+    for(unsigned shift = 0; shift < keyBits; shift += 8)
+    {
+        size_t counts[257] = {0};
+        for(size_t i = 0; i < n; i++)
+        {
+            counts[((keys[i] >> shift) & 0xff) + 1]++;
+        }
+        for(size_t b = 0; b < 256; b++)
+        {
+            counts[b + 1] += counts[b];
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+            uint32_t index = result[i];
+            scratch[counts[(keys[index] >> shift) & 0xff]++] = index;
+        }
+        std::swap(result, scratch);
+    }
+
+    // An odd number of passes leaves the order in the scratch array
+    if(result != order)
+        std::copy(result, result + n, order);
+}
@@ -0,0 +1,49 @@
+#ifndef RAYSORT_H
+#define RAYSORT_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "../core/ray.h"
+
+/**
+ * @brief The RaySortMode enum
+ *
+ * Key used to reorder a queue of rays before intersecting it:
+ *  - None:   keep the queue order
+ *  - Octant: group rays by direction octant (sign of d.x, d.y, d.z)
+ *  - Morton: group by octant, then by the Morton (Z-order) code of the
+ *            origin within the bounds of the queue, so rays that start
+ *            close to each other and travel the same way end up adjacent
+ */
+enum class RaySortMode { None, Octant, Morton };
+
+class RaySort
+{
+public:
+    RaySort();
+
+    // Sort key of a ray. originMin / originScale map the origins of the
+    // queue to [0, 1]^3 (only used in Morton mode)
+    static uint32_t computeKey(const Ray &ray, RaySortMode mode,
+                               const Vector3D &originMin, const Vector3D &originScale);
+    // Number of significant bits of the keys of a mode
+    static unsigned getKeyBits(RaySortMode mode);
+
+    // Octant index in [0, 8): bit i is set when component i of d is negative
+    static uint32_t directionOctant(const Vector3D &d);
+    // Interleaves the lowest mortonBits bits of x, y and z
+    static uint32_t mortonCode(uint32_t x, uint32_t y, uint32_t z);
+
+    // Stable LSD radix sort (8-bit digits) of the indices 0..n-1 by key.
+    // Ties keep their original order, so the result is deterministic
+    static void sortOrder(const std::vector<uint32_t> &keys, unsigned keyBits,
+                          std::vector<uint32_t> &order, std::vector<uint32_t> &scratch);
+    // Same, on caller-provided arrays of n entries
+    static void sortOrder(const uint32_t *keys, size_t n, unsigned keyBits,
+                          uint32_t *order, uint32_t *scratch);
+
+    static const unsigned mortonBits = 9; // Per axis
+};
+
+#endif // RAYSORT_H
@@ -0,0 +1,631 @@
+#include "renderdaemon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "../cameras/ortographic.h"
+#include "../cameras/perspective.h"
+#include "../core/utils.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+const uint32_t DaemonProtocol::magic;
+const uint64_t DaemonProtocol::maxPayload;
+
+// Largest image side and scene name accepted in a request
+static const uint32_t maxImageSide = 16384;
+static const size_t maxSceneName = 4096;
+
+// Per-connection buffers, kept from one request to the next
+struct RenderDaemon::Connection
+{
+    int fd;
+    std::unique_ptr<Film> film;
+    std::vector<float> image;
+    std::vector<char> payload;
+};
+
+RenderDaemon::RenderDaemon(const DaemonSettings &settings_)
+    : settings(settings_), stopping(false)
+{ }
+
+void RenderDaemon::stop()
+{
+    stopping = true;
+}
+
+DaemonStats RenderDaemon::getStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    DaemonStats copy = stats;
+    copy.nSceneLoads = scenes.getLoadCount();
+    return copy;
+}
+
+std::shared_ptr<RenderDaemon::View> RenderDaemon::getView(const BatchJob &job, bool &cached)
+{
+    // Full precision: views whose angles only differ in the last digits
+    // must not share a camera
+    std::ostringstream key;
+    key << job.scene << '|' << std::setprecision(17) << (job.perspective ? job.fovDegrees : 0.0)
+        << '|' << job.width << 'x' << job.height;
+
+    {
+        std::lock_guard<std::mutex> lock(viewMutex);
+        for(std::list<std::shared_ptr<View>>::iterator it = views.begin(); it != views.end(); ++it)
+        {
+            if((*it)->key == key.str())
+            {
+                views.splice(views.begin(), views, it);
+                cached = true;
+                return views.front();
+            }
+        }
+    }
+
+    // Prepared with no lock held (two requests for a new view may both
+    // prepare it; the extra copy is simply evicted later)
+    cached = false;
+    std::shared_ptr<View> view = std::make_shared<View>();
+    view->key = key.str();
+    view->scene = scenes.get(job.scene);
+    if(!view->scene)
+        return std::shared_ptr<View>();
+
+    Matrix4x4 cameraToWorld;
+    if(job.perspective)
+        view->camera.reset(new PerspectiveCamera(cameraToWorld, Utils::degreesToRadians(job.fovDegrees),
+                                                 job.width, job.height));
+    else
+        view->camera.reset(new OrtographicCamera(cameraToWorld, job.width, job.height));
+    view->renderer.reset(new Renderer(*view->camera, view->scene->getObjects()));
+    view->renderer->setRasterizedVisibility(true);
+
+    std::lock_guard<std::mutex> lock(viewMutex);
+    views.push_front(view);
+    while(views.size() > std::max<size_t>(settings.maxViews, 1))
+        views.pop_back();
+    return view;
+}
+
+#ifdef _WIN32
+
+int RenderDaemon::serve()
+{
+    std::cout << "Problem at RenderDaemon::serve() : Unix-domain sockets are not "
+                 "available on this platform" << std::endl;
+    return -1;
+}
+
+void RenderDaemon::serveConnection(int)
+{ }
+
+int RenderDaemon::render(const DaemonProtocol::RenderRequest &, const std::string &,
+                         Connection &, DaemonProtocol::RenderReply &)
+{
+    return -1;
+}
+
+RenderClient::RenderClient() : fd(-1)
+{ }
+
+RenderClient::~RenderClient()
+{ }
+
+int RenderClient::connect(const std::string &)
+{
+    std::cout << "Problem at RenderClient::connect() : Unix-domain sockets are not "
+                 "available on this platform" << std::endl;
+    return -1;
+}
+
+void RenderClient::disconnect()
+{ }
+
+int RenderClient::render(const BatchJob &, bool, std::vector<float> &,
+                         DaemonProtocol::RenderReply *)
+{
+    return -1;
+}
+
+int RenderClient::getStats(DaemonStats &)
+{
+    return -1;
+}
+
+int RenderClient::shutdown()
+{
+    return -1;
+}
+
+#else
+
+static bool writeAll(int fd, const void *buffer, size_t size)
+{
+    const char *p = (const char *)buffer;
+    while(size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void *buffer, size_t size)
+{
+    char *p = (char *)buffer;
+    while(size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool writeFrame(int fd, uint32_t type, const void *payload, size_t size,
+                       const void *extra = nullptr, size_t extraSize = 0)
+{
+    DaemonProtocol::FrameHeader header;
+    header.magic = DaemonProtocol::magic;
+    header.type = type;
+    header.size = size + extraSize;
+    return writeAll(fd, &header, sizeof(header)) &&
+           (size == 0 || writeAll(fd, payload, size)) &&
+           (extraSize == 0 || writeAll(fd, extra, extraSize));
+}
+
+static bool readFrameHeader(int fd, DaemonProtocol::FrameHeader &header)
+{
+    return readAll(fd, &header, sizeof(header)) && header.magic == DaemonProtocol::magic;
+}
+
+// Reads the payload of a frame whose header has been read. The size is
+// checked against what the reader expects before anything is allocated,
+// so a bad or hostile peer cannot make it reserve gigabytes
+static bool readPayload(int fd, const DaemonProtocol::FrameHeader &header, uint64_t maxSize,
+                        std::vector<char> &payload)
+{
+    if(header.size > maxSize || header.size > DaemonProtocol::maxPayload)
+        return false;
+    payload.resize((size_t)header.size);
+    return header.size == 0 || readAll(fd, payload.data(), payload.size());
+}
+
+// Reads a frame that must be of the given type, with at most maxSize bytes
+static bool readFrame(int fd, uint32_t type, uint64_t maxSize, std::vector<char> &payload)
+{
+    DaemonProtocol::FrameHeader header;
+    return readFrameHeader(fd, header) && header.type == type &&
+           readPayload(fd, header, maxSize, payload);
+}
+
+static bool fillAddress(const std::string &socketPath, sockaddr_un &address)
+{
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+    return true;
+}
+
+// Copies the image into a new shared memory object. Returns its name, or
+// an empty string on failure
+static std::string publishImage(const std::vector<float> &image)
+{
+    static std::atomic<uint64_t> counter(0);
+    std::string name = "/rtis-" + std::to_string((long)getpid()) + "-" +
+                       std::to_string((unsigned long long)counter.fetch_add(1));
+    size_t bytes = image.size() * sizeof(float);
+
+    int shm = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(shm < 0)
+        return std::string();
+    void *mapping = MAP_FAILED;
+    if(ftruncate(shm, (off_t)bytes) == 0)
+        mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, shm, 0);
+    close(shm);
+    if(mapping == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return std::string();
+    }
+    memcpy(mapping, image.data(), bytes);
+    munmap(mapping, bytes);
+    return name;
+}
+
+int RenderDaemon::render(const DaemonProtocol::RenderRequest &request, const std::string &sceneName,
+                         Connection &connection, DaemonProtocol::RenderReply &reply)
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    if(request.width == 0 || request.height == 0 || request.width > maxImageSide ||
+       request.height > maxImageSide || request.samples == 0 ||
+       ((request.flags & DaemonProtocol::Perspective) &&
+        !(request.fovDegrees > 0 && request.fovDegrees < 180)))
+    {
+        return -1;
+    }
+
+    BatchJob job;
+    job.scene = sceneName;
+    job.perspective = (request.flags & DaemonProtocol::Perspective) != 0;
+    job.fovDegrees = request.fovDegrees;
+    job.width = request.width;
+    job.height = request.height;
+    job.samples = request.samples;
+
+    bool cached;
+    std::shared_ptr<View> view = getView(job, cached);
+    if(!view)
+        return -1;
+    reply.cachedView = cached ? 1 : 0;
+
+    if(!connection.film || connection.film->getWidth() != job.width ||
+       connection.film->getHeight() != job.height)
+    {
+        connection.film.reset(new Film(job.width, job.height));
+    }
+    Clock::time_point renderStart = Clock::now();
+    reply.setupSeconds = std::chrono::duration<double>(renderStart - start).count();
+
+    Film &film = *connection.film;
+    int result = job.samples > 1
+                 ? view->renderer->renderSamples(film, job.samples, nullptr, settings.tileSize)
+                 : view->renderer->render(film, settings.tileSize);
+    if(result != 0)
+        return -1;
+
+    connection.image.resize(3 * job.width * job.height);
+    float *out = connection.image.data();
+    for(size_t y = 0; y < job.height; y++)
+    {
+        const Vector3D *row = film.getRow(y);
+        for(size_t x = 0; x < job.width; x++)
+        {
+            *out++ = (float)row[x].x;
+            *out++ = (float)row[x].y;
+            *out++ = (float)row[x].z;
+        }
+    }
+    reply.renderSeconds = std::chrono::duration<double>(Clock::now() - renderStart).count();
+    reply.width = request.width;
+    reply.height = request.height;
+    reply.imageBytes = connection.image.size() * sizeof(float);
+
+    if(request.flags & DaemonProtocol::SharedMemory)
+    {
+        std::string name = publishImage(connection.image);
+        if(name.empty() || name.size() >= sizeof(reply.sharedMemory))
+            return -1;
+        memcpy(reply.sharedMemory, name.c_str(), name.size() + 1);
+    }
+    return 0;
+}
+
+void RenderDaemon::serveConnection(int fd)
+{
+    Connection connection;
+    connection.fd = fd;
+
+    DaemonProtocol::FrameHeader header;
+    while(!stopping && readFrameHeader(fd, header))
+    {
+        // Only render requests carry a payload
+        uint64_t maxSize = header.type == DaemonProtocol::Render ?
+                           sizeof(DaemonProtocol::RenderRequest) + maxSceneName : 0;
+        if(!readPayload(fd, header, maxSize, connection.payload))
+            break;
+
+        if(header.type == DaemonProtocol::Shutdown)
+        {
+            stop();
+            break;
+        }
+        if(header.type == DaemonProtocol::Stats)
+        {
+            DaemonStats current = getStats();
+            if(!writeFrame(fd, DaemonProtocol::Stats, &current, sizeof(current)))
+                break;
+            continue;
+        }
+        if(header.type != DaemonProtocol::Render ||
+           header.size < sizeof(DaemonProtocol::RenderRequest))
+        {
+            break;
+        }
+
+        DaemonProtocol::RenderRequest request;
+        memcpy(&request, connection.payload.data(), sizeof(request));
+        std::string sceneName(connection.payload.data() + sizeof(request),
+                              connection.payload.size() - sizeof(request));
+
+        DaemonProtocol::RenderReply reply;
+        memset(&reply, 0, sizeof(reply));
+        reply.status = render(request, sceneName, connection, reply);
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            stats.nRequests++;
+            if(reply.status != 0)
+                stats.nFailed++;
+            else if(reply.cachedView)
+                stats.nViewHits++;
+            else
+                stats.nViewMisses++;
+        }
+
+        bool inBand = reply.status == 0 && reply.sharedMemory[0] == '\0';
+        if(reply.status != 0)
+            reply.imageBytes = 0;
+        if(!writeFrame(fd, DaemonProtocol::Image, &reply, sizeof(reply),
+                       inBand ? connection.image.data() : nullptr,
+                       inBand ? (size_t)reply.imageBytes : 0))
+        {
+            // The client is gone: do not leave its image behind
+            if(reply.sharedMemory[0] != '\0')
+                shm_unlink(reply.sharedMemory);
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    openConnections.erase(std::remove(openConnections.begin(), openConnections.end(), fd),
+                          openConnections.end());
+    close(fd);
+    finishedThreads.push_back(std::this_thread::get_id());
+}
+
+int RenderDaemon::serve()
+{
+    sockaddr_un address;
+    if(!fillAddress(settings.socketPath, address))
+    {
+        std::cout << "Problem at RenderDaemon::serve() : invalid socket path \""
+                  << settings.socketPath << "\"" << std::endl;
+        return -1;
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0)
+    {
+        std::cout << "Problem at RenderDaemon::serve() : socket() failed" << std::endl;
+        return -1;
+    }
+
+    // A stale socket file of a previous daemon would make bind() fail
+    unlink(settings.socketPath.c_str());
+    if(bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+    {
+        std::cout << "Problem at RenderDaemon::serve() : cannot listen on \""
+                  << settings.socketPath << "\" (" << strerror(errno) << ")" << std::endl;
+        close(listener);
+        return -1;
+    }
+
+    // Writes to clients that hung up must fail, not kill the daemon
+    void (*oldSigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+    stopping = false;
+
+    // The listener is polled so that stop() is noticed within a poll period
+    while(!stopping)
+    {
+        pollfd pfd;
+        pfd.fd = listener;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ready = poll(&pfd, 1, 200);
+        if(ready < 0 && errno != EINTR)
+            break;
+        if(ready <= 0)
+            continue;
+
+        int fd = accept(listener, nullptr, nullptr);
+        if(fd < 0)
+            continue;
+
+        std::lock_guard<std::mutex> lock(connectionMutex);
+
+        // Threads of closed connections are joined as new ones arrive
+        for(std::list<std::thread>::iterator it = connectionThreads.begin();
+            it != connectionThreads.end(); )
+        {
+            if(std::find(finishedThreads.begin(), finishedThreads.end(), it->get_id()) !=
+               finishedThreads.end())
+            {
+                it->join();
+                it = connectionThreads.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        finishedThreads.clear();
+
+        openConnections.push_back(fd);
+        connectionThreads.push_back(std::thread(&RenderDaemon::serveConnection, this, fd));
+        std::lock_guard<std::mutex> statsLock(statsMutex);
+        stats.nConnections++;
+    }
+
+    close(listener);
+    unlink(settings.socketPath.c_str());
+
+    // Wake up the connections blocked on a read, then wait for them
+    std::list<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        for(size_t i = 0; i < openConnections.size(); i++)
+            ::shutdown(openConnections[i], SHUT_RDWR);
+        threads.swap(connectionThreads);
+        finishedThreads.clear();
+    }
+    for(std::list<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it)
+        it->join();
+
+    signal(SIGPIPE, oldSigpipe);
+    return 0;
+}
+
+RenderClient::RenderClient() : fd(-1)
+{ }
+
+RenderClient::~RenderClient()
+{
+    disconnect();
+}
+
+int RenderClient::connect(const std::string &socketPath)
+{
+    disconnect();
+
+    sockaddr_un address;
+    if(!fillAddress(socketPath, address))
+    {
+        std::cout << "Problem at RenderClient::connect() : invalid socket path \""
+                  << socketPath << "\"" << std::endl;
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || ::connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        std::cout << "Problem at RenderClient::connect() : cannot connect to \""
+                  << socketPath << "\" (" << strerror(errno) << ")" << std::endl;
+        disconnect();
+        return -1;
+    }
+    return 0;
+}
+
+void RenderClient::disconnect()
+{
+    if(fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+int RenderClient::render(const BatchJob &job, bool sharedMemory, std::vector<float> &image,
+                         DaemonProtocol::RenderReply *reply)
+{
+    DaemonProtocol::RenderRequest request;
+    memset(&request, 0, sizeof(request));
+    request.width = (uint32_t)job.width;
+    request.height = (uint32_t)job.height;
+    request.samples = (uint32_t)job.samples;
+    request.flags = (job.perspective ? (uint32_t)DaemonProtocol::Perspective : 0u) |
+                    (sharedMemory ? (uint32_t)DaemonProtocol::SharedMemory : 0u);
+    request.fovDegrees = job.fovDegrees;
+
+    // The reply holds at most the image that was asked for
+    uint64_t expectedBytes = (uint64_t)3 * job.width * job.height * sizeof(float);
+    std::vector<char> payload;
+    if(fd < 0 || !writeFrame(fd, DaemonProtocol::Render, &request, sizeof(request),
+                             job.scene.data(), job.scene.size()) ||
+       !readFrame(fd, DaemonProtocol::Image, sizeof(DaemonProtocol::RenderReply) + expectedBytes,
+                  payload) ||
+       payload.size() < sizeof(DaemonProtocol::RenderReply))
+    {
+        std::cout << "Problem at RenderClient::render() : connection lost" << std::endl;
+        return -1;
+    }
+
+    DaemonProtocol::RenderReply answer;
+    memcpy(&answer, payload.data(), sizeof(answer));
+    answer.sharedMemory[sizeof(answer.sharedMemory) - 1] = '\0';
+    if(reply)
+        *reply = answer;
+    if(answer.status != 0)
+        return answer.status;
+
+    if(answer.imageBytes != expectedBytes)
+    {
+        std::cout << "Problem at RenderClient::render() : got " << answer.imageBytes
+                  << " image bytes, expected " << expectedBytes << std::endl;
+        if(answer.sharedMemory[0] != '\0')
+            shm_unlink(answer.sharedMemory);
+        return -1;
+    }
+    size_t bytes = (size_t)expectedBytes;
+    image.resize(bytes / sizeof(float));
+    if(answer.sharedMemory[0] == '\0')
+    {
+        if(payload.size() != sizeof(answer) + bytes)
+            return -1;
+        memcpy(image.data(), payload.data() + sizeof(answer), bytes);
+        return 0;
+    }
+
+    int shm = shm_open(answer.sharedMemory, O_RDONLY, 0);
+    shm_unlink(answer.sharedMemory);
+    if(shm < 0)
+        return -1;
+    // Reading a mapping past the end of the object raises SIGBUS, so the
+    // object must really hold the image
+    struct stat info;
+    if(fstat(shm, &info) != 0 || info.st_size < 0 || (uint64_t)info.st_size < expectedBytes)
+    {
+        std::cout << "Problem at RenderClient::render() : shared memory object \""
+                  << answer.sharedMemory << "\" is smaller than the image" << std::endl;
+        close(shm);
+        return -1;
+    }
+    void *mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, shm, 0);
+    close(shm);
+    if(mapping == MAP_FAILED)
+        return -1;
+    memcpy(image.data(), mapping, bytes);
+    munmap(mapping, bytes);
+    return 0;
+}
+
+int RenderClient::getStats(DaemonStats &stats)
+{
+    std::vector<char> payload;
+    if(fd < 0 || !writeFrame(fd, DaemonProtocol::Stats, nullptr, 0) ||
+       !readFrame(fd, DaemonProtocol::Stats, sizeof(DaemonStats), payload) ||
+       payload.size() != sizeof(DaemonStats))
+    {
+        return -1;
+    }
+    memcpy(&stats, payload.data(), sizeof(stats));
+    return 0;
+}
+
+int RenderClient::shutdown()
+{
+    if(fd < 0 || !writeFrame(fd, DaemonProtocol::Shutdown, nullptr, 0))
+        return -1;
+    disconnect();
+    return 0;
+}
+
+#endif // _WIN32
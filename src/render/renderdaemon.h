@@ -0,0 +1,197 @@
+#ifndef RENDERDAEMON_H
+#define RENDERDAEMON_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batchrenderer.h"
+#include "renderer.h"
+#include "scene.h"
+#include "../cameras/camera.h"
+
+/**
+ * @brief The DaemonSettings struct
+ */
+struct DaemonSettings
+{
+    std::string socketPath; // Unix-domain socket the daemon listens on
+    size_t maxViews;        // Prepared (scene, camera) pairs kept for reuse
+    size_t tileSize;
+
+    DaemonSettings() : socketPath("rtis.sock"), maxViews(16), tileSize(32)
+    { }
+};
+
+/**
+ * @brief The DaemonStats struct
+ */
+struct DaemonStats
+{
+    uint64_t nConnections;
+    uint64_t nRequests;   // Render requests served
+    uint64_t nFailed;
+    uint64_t nSceneLoads; // Scene files parsed / built-in scenes built
+    uint64_t nViewHits;   // Requests that found their view prepared
+    uint64_t nViewMisses;
+
+    DaemonStats() : nConnections(0), nRequests(0), nFailed(0), nSceneLoads(0),
+                    nViewHits(0), nViewMisses(0)
+    { }
+};
+
+/**
+ * @brief The DaemonProtocol struct
+ *
+ * Wire format between RenderDaemon and RenderClient. Every message is a
+ * FrameHeader followed by "size" bytes of payload. Both ends run on the
+ * same machine, so the native byte order and layout are used.
+ *
+ *  - Render: RenderRequest followed by the scene name. Answered by an
+ *    Image frame: RenderReply followed, unless the image went through
+ *    shared memory, by width * height * 3 floats (RGB, row by row).
+ *  - Stats: no payload. Answered by a Stats frame holding a DaemonStats.
+ *  - Shutdown: no payload, no answer. The daemon stops accepting requests.
+ */
+struct DaemonProtocol
+{
+    static const uint32_t magic = 0x44534954; // "TISD"
+
+    enum Type : uint32_t { Render = 1, Image = 2, Stats = 3, Shutdown = 4 };
+
+    enum Flags : uint32_t
+    {
+        Perspective  = 1,
+        SharedMemory = 2 // Return the image in a shared memory object
+    };
+
+    struct FrameHeader
+    {
+        uint32_t magic;
+        uint32_t type;
+        uint64_t size;
+    };
+
+    struct RenderRequest
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t samples;
+        uint32_t flags;
+        double fovDegrees;
+    };
+
+    struct RenderReply
+    {
+        int32_t status;         // 0 on success
+        uint32_t width;
+        uint32_t height;
+        uint32_t cachedView;    // 1 if no setup was needed
+        uint64_t imageBytes;
+        double setupSeconds;    // Scene load and view preparation
+        double renderSeconds;
+        char sharedMemory[64];  // Name of the shared memory object (if used).
+                                //  The client unlinks it once read
+    };
+
+    // Largest payload accepted by either end (each reader also bounds the
+    // payload by what it expects for the frame type)
+    static const uint64_t maxPayload = (uint64_t)1 << 32;
+};
+
+/**
+ * @brief The RenderDaemon class
+ *
+ * Resident render server. It listens on a Unix-domain socket and serves
+ * each client connection on its own thread; the renders themselves run on
+ * the global thread pool. Scenes are kept loaded (see SceneCache), and the
+ * last maxViews "views" (scene + camera + resolution) keep their camera
+ * and renderer, with the rasterized visibility already built, so repeating
+ * a render of the same view skips every setup step. Films and image
+ * buffers are reused per connection, so steady-state requests do not fault
+ * in new memory either.
+ *
+ * Not available on Windows (serve() returns an error).
+ */
+class RenderDaemon
+{
+public:
+    // Constructor(s)
+    RenderDaemon(const DaemonSettings &settings_ = DaemonSettings());
+    RenderDaemon(const RenderDaemon &) = delete;
+    RenderDaemon &operator=(const RenderDaemon &) = delete;
+
+    // Serves requests until a Shutdown request arrives or stop() is
+    // called. Returns 0 on a clean shutdown
+    int serve();
+    void stop();
+
+    DaemonStats getStats() const;
+
+private:
+    // Everything a render of one view needs, prepared once
+    struct View
+    {
+        std::string key;
+        std::shared_ptr<const Scene> scene;
+        std::unique_ptr<Camera> camera;
+        std::unique_ptr<Renderer> renderer;
+    };
+
+    struct Connection;
+
+    void serveConnection(int fd);
+    // Renders a request into the image buffer of the connection
+    int render(const DaemonProtocol::RenderRequest &request, const std::string &sceneName,
+               Connection &connection, DaemonProtocol::RenderReply &reply);
+    std::shared_ptr<View> getView(const BatchJob &job, bool &cached);
+
+    DaemonSettings settings;
+    SceneCache scenes;
+    std::mutex viewMutex;
+    std::list<std::shared_ptr<View>> views; // Most recently used first
+    std::atomic<bool> stopping;
+    std::mutex connectionMutex;
+    std::vector<int> openConnections;
+    std::list<std::thread> connectionThreads;
+    std::vector<std::thread::id> finishedThreads; // Not joined yet
+
+    mutable std::mutex statsMutex;
+    DaemonStats stats;
+};
+
+/**
+ * @brief The RenderClient class
+ *
+ * Client side of the daemon protocol (one connection).
+ */
+class RenderClient
+{
+public:
+    // Constructor(s)
+    RenderClient();
+    RenderClient(const RenderClient &) = delete;
+    RenderClient &operator=(const RenderClient &) = delete;
+    ~RenderClient();
+
+    // Returns 0 on success
+    int connect(const std::string &socketPath);
+    void disconnect();
+
+    // Renders the job (its output name is ignored) and stores the image in
+    // "image", 3 floats per pixel. Returns 0 on success
+    int render(const BatchJob &job, bool sharedMemory, std::vector<float> &image,
+               DaemonProtocol::RenderReply *reply = nullptr);
+    int getStats(DaemonStats &stats);
+    int shutdown();
+
+private:
+    int fd;
+};
+
+#endif // RENDERDAEMON_H
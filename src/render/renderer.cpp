@@ -0,0 +1,382 @@
+#include "renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+#include "frustum.h"
+#include "../core/memoryarena.h"
+#include "../core/parallel.h"
+#include "../core/tiledfilm.h"
+#include "../core/utils.h"
+
+Renderer::Renderer(const Camera &camera_, const std::vector<Shape*> &objects_)
+    : camera(camera_), objects(objects_), sampler(0), frustumCulling(true),
+      crop(CropWindow::fullFrame(camera_.width, camera_.height))
+{ }
+
+size_t Renderer::getWidth() const
+{
+    return camera.width;
+}
+
+size_t Renderer::getHeight() const
+{
+    return camera.height;
+}
+
+uint64_t Renderer::getSeed() const
+{
+    return sampler.getSeed();
+}
+
+bool Renderer::getFrustumCulling() const
+{
+    return frustumCulling;
+}
+
+bool Renderer::getRasterizedVisibility() const
+{
+    return !visibility.isEmpty();
+}
+
+const CropWindow &Renderer::getCropWindow() const
+{
+    return crop;
+}
+
+void Renderer::setSeed(uint64_t seed)
+{
+    sampler = Philox(seed);
+}
+
+void Renderer::setFrustumCulling(bool enabled)
+{
+    frustumCulling = enabled;
+}
+
+void Renderer::setRasterizedVisibility(bool enabled)
+{
+    if(enabled)
+        visibility.build(camera, objects, getWidth(), getHeight());
+    else
+        visibility.clear();
+}
+
+void Renderer::setCropWindow(const CropWindow &crop_)
+{
+    crop = crop_.clamped(getWidth(), getHeight());
+}
+
+Vector3D Renderer::computePixel(size_t col, size_t row) const
+{
+    return computeSample(col, row, 0);
+}
+
+Vector3D Renderer::computePixel(size_t col, size_t row, const ShapeList &tileCandidates) const
+{
+    return traceTileSample(col, row, .5, .5, tileCandidates);
+}
+
+Vector3D Renderer::computeSample(size_t col, size_t row, size_t sampleIndex) const
+{
+    if(sampleIndex == 0)
+        return traceTileSample(col, row, .5, .5, getAllShapes());
+
+    // Same values as the batched path of renderPass()
+    uint64_t pixel = (uint64_t)row * getWidth() + col;
+    double dx = sampler.uniformFloat(pixel, (uint32_t)sampleIndex, 0);
+    double dy = sampler.uniformFloat(pixel, (uint32_t)sampleIndex, 1);
+    return traceTileSample(col, row, dx, dy, getAllShapes());
+}
+
+ShapeList Renderer::getAllShapes() const
+{
+    ShapeList all = { objects.data(), objects.size() };
+    return all;
+}
+
+Vector3D Renderer::traceTileSample(size_t col, size_t row, double dx, double dy,
+                                   const ShapeList &tileCandidates) const
+{
+    // The per-pixel lists are always at least as short as the tile ones
+    if(!visibility.isEmpty())
+        return traceSample(col, row, dx, dy, visibility.getCandidates(col, row),
+                           visibility.getCandidateCount(col, row));
+
+    return traceSample(col, row, dx, dy, tileCandidates.shapes, tileCandidates.size);
+}
+
+Vector3D Renderer::traceSample(size_t col, size_t row, double dx, double dy,
+                               Shape *const *candidates, size_t nCandidates) const
+{
+    double u = (col + dx) / getWidth();
+    double v = (row + dy) / getHeight();
+    Ray ray = camera.generateRay(u, v);
+
+    // Red where some object is hit, black elsewhere
+    return Utils::hasIntersection(ray, candidates, nCandidates) ? Vector3D(1, 0, 0) : Vector3D(0, 0, 0);
+}
+
+ShapeList Renderer::getTileCandidates(const Tile &tile, MemoryArena &arena) const
+{
+    if(!frustumCulling)
+        return getAllShapes();
+
+    // Every sample of the tile lies in the rectangle spanned by its pixels
+    Frustum frustum(camera, (double)tile.x0 / getWidth(), (double)tile.y0 / getHeight(),
+                    (double)tile.x1 / getWidth(), (double)tile.y1 / getHeight());
+
+    // Room for every shape: the unused tail goes back with the arena
+    Shape **candidates = static_cast<Shape **>(arena.alloc(objects.size() * sizeof(Shape *),
+                                                           alignof(Shape *)));
+    ShapeList list = { candidates, 0 };
+    for(size_t k = 0; k < objects.size(); k++)
+    {
+        if(frustum.intersects(objects[k]->getWorldBounds()))
+            candidates[list.size++] = objects[k];
+    }
+    return list;
+}
+
+void Renderer::renderTile(const Tile &tile, Vector3D *out) const
+{
+    // The caller may hold tile arena memory (e.g., "out"), so the arena is
+    // rewound rather than reset
+    MemoryArena &arena = MemoryArena::forThread(ArenaLifetime::Tile);
+    ArenaScope scope(arena);
+    ShapeList candidates = getTileCandidates(tile, arena);
+
+    for(size_t row = tile.y0; row < tile.y1; row++)
+    {
+        for(size_t col = tile.x0; col < tile.x1; col++)
+        {
+            *out++ = traceTileSample(col, row, .5, .5, candidates);
+        }
+    }
+}
+
+int Renderer::checkFilmSize(size_t filmWidth, size_t filmHeight, const char *caller) const
+{
+    // A film of another size would get pixels out of its range (or
+    // misplaced ones)
+    if(filmWidth != crop.getWidth() || filmHeight != crop.getHeight())
+    {
+        std::cout << "Problem at " << caller << " : film is " << filmWidth << "x" << filmHeight
+                  << ", expected " << crop.getWidth() << "x" << crop.getHeight() << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int Renderer::renderTile(const Tile &tile, Film &film) const
+{
+    if(checkFilmSize(film.getWidth(), film.getHeight(), "Renderer::renderTile()") != 0)
+        return -1;
+
+    MemoryArena &arena = MemoryArena::forThread(ArenaLifetime::Tile);
+    ArenaScope scope(arena);
+    ShapeList candidates = getTileCandidates(tile, arena);
+
+    for(size_t row = tile.y0; row < tile.y1; row++)
+    {
+        for(size_t col = tile.x0; col < tile.x1; col++)
+        {
+            Vector3D color = traceTileSample(col, row, .5, .5, candidates);
+            film.setPixelValue(col - crop.x0, row - crop.y0, color);
+        }
+    }
+    return 0;
+}
+
+int Renderer::render(Film &film, size_t tileSize) const
+{
+    if(checkFilmSize(film.getWidth(), film.getHeight(), "Renderer::render()") != 0)
+        return -1;
+
+    std::vector<Tile> tiles = Tile::split(crop.x0, crop.y0, crop.x1, crop.y1, tileSize);
+
+    // Tiles write to disjoint pixels, so no synchronization is needed
+    Parallel::forRange(0, tiles.size(), 1, [&](size_t begin, size_t end)
+    {
+        for(size_t t = begin; t < end; t++)
+        {
+            renderTile(tiles[t], film);
+        }
+    });
+    return 0;
+}
+
+int Renderer::render(TiledFilm &film) const
+{
+    // Tiles are addressed on the grid of the film: a film of another size
+    // would get tiles out of its range (or clipped ones, not whole)
+    if(checkFilmSize(film.getWidth(), film.getHeight(), "Renderer::render()") != 0)
+        return -1;
+
+    size_t tileSize = film.getTileSize();
+    std::vector<Tile> tiles = Tile::split(crop.x0, crop.y0, crop.x1, crop.y1, tileSize);
+
+    Parallel::forRange(0, tiles.size(), 1, [&](size_t begin, size_t end)
+    {
+        MemoryArena &arena = MemoryArena::forThread(ArenaLifetime::Tile);
+        for(size_t t = begin; t < end; t++)
+        {
+            const Tile &tile = tiles[t];
+            ArenaScope scope(arena);
+            Vector3D *pixels = arena.alloc<Vector3D>(tile.getPixelCount());
+            renderTile(tile, pixels);
+            film.writeTile((tile.x0 - crop.x0) / tileSize, (tile.y0 - crop.y0) / tileSize, pixels);
+        }
+    });
+    return 0;
+}
+
+int Renderer::renderPass(Film &accumulation, size_t sampleIndex, size_t tileSize) const
+{
+    std::vector<Tile> tiles = Tile::split(crop.x0, crop.y0, crop.x1, crop.y1, tileSize);
+    return renderPass(accumulation, tiles, sampleIndex);
+}
+
+int Renderer::renderPass(Film &accumulation, const std::vector<Tile> &tiles,
+                         size_t sampleIndex) const
+{
+    if(checkFilmSize(accumulation.getWidth(), accumulation.getHeight(),
+                     "Renderer::renderPass()") != 0)
+        return -1;
+
+    Parallel::forRange(0, tiles.size(), 1, [&](size_t begin, size_t end)
+    {
+        // Per-tile scratch memory comes from the thread arena, so once the
+        // arenas are warm the loop below never reaches the heap
+        MemoryArena &arena = MemoryArena::forThread(ArenaLifetime::Tile);
+
+        for(size_t t = begin; t < end; t++)
+        {
+            const Tile &tile = tiles[t];
+            ArenaScope scope(arena);
+            ShapeList candidates = getTileCandidates(tile, arena);
+            float *dx = arena.alloc<float>(tile.getWidth());
+            float *dy = arena.alloc<float>(tile.getWidth());
+            std::fill(dx, dx + tile.getWidth(), .5f);
+            std::fill(dy, dy + tile.getWidth(), .5f);
+
+            for(size_t row = tile.y0; row < tile.y1; row++)
+            {
+                // Jitter of the whole tile row in two batched calls
+                if(sampleIndex > 0)
+                {
+                    uint64_t firstPixel = (uint64_t)row * getWidth() + tile.x0;
+                    sampler.uniformFloatRow(firstPixel, (uint32_t)sampleIndex, 0, dx, tile.getWidth());
+                    sampler.uniformFloatRow(firstPixel, (uint32_t)sampleIndex, 1, dy, tile.getWidth());
+                }
+
+                for(size_t col = tile.x0; col < tile.x1; col++)
+                {
+                    Vector3D sum = accumulation.getPixelValue(col - crop.x0, row - crop.y0) +
+                                   traceTileSample(col, row, dx[col - tile.x0], dy[col - tile.x0],
+                                                   candidates);
+                    accumulation.setPixelValue(col - crop.x0, row - crop.y0, sum);
+                }
+            }
+        }
+    });
+    return 0;
+}
+
+int Renderer::renderSamples(Film &film, size_t samplesPerPixel,
+                            const CheckpointSettings *checkpoint,
+                            size_t tileSize) const
+{
+    typedef std::chrono::steady_clock Clock;
+
+    if(checkFilmSize(film.getWidth(), film.getHeight(), "Renderer::renderSamples()") != 0)
+        return -1;
+
+    Film accumulation(crop.getWidth(), crop.getHeight());
+    size_t firstSample = 0;
+
+    // Snapshot of the sums after samplesDone passes, with what identifies
+    // the render: the crop within the full image, the sample count and the
+    // seed
+    auto capture = [&](CheckpointState &state, size_t samplesDone)
+    {
+        Checkpoint::capture(accumulation, state);
+        state.x0           = (uint32_t)crop.x0;
+        state.y0           = (uint32_t)crop.y0;
+        state.fullWidth    = (uint32_t)getWidth();
+        state.fullHeight   = (uint32_t)getHeight();
+        state.samplesDone  = (uint32_t)samplesDone;
+        state.samplesTotal = (uint32_t)samplesPerPixel;
+        state.seed         = getSeed();
+    };
+
+    if(checkpoint && checkpoint->resume)
+    {
+        CheckpointState state;
+        if(Checkpoint::load(checkpoint->fileName, state))
+        {
+            if(state.width == crop.getWidth() && state.height == crop.getHeight() &&
+               state.x0 == crop.x0 && state.y0 == crop.y0 &&
+               state.fullWidth == getWidth() && state.fullHeight == getHeight() &&
+               state.samplesTotal == samplesPerPixel && state.seed == getSeed())
+            {
+                Checkpoint::restore(state, accumulation);
+                firstSample = state.samplesDone;
+                std::cout << "Resuming from \"" << checkpoint->fileName << "\" at sample "
+                          << firstSample << "/" << samplesPerPixel << std::endl;
+            }
+            else
+            {
+                std::cout << "Checkpoint \"" << checkpoint->fileName
+                          << "\" belongs to a different render, starting over" << std::endl;
+            }
+        }
+    }
+
+    // Only created when needed, so that plain renders spawn no thread
+    std::unique_ptr<CheckpointWriter> writer;
+    if(checkpoint)
+        writer.reset(new CheckpointWriter(checkpoint->fileName));
+    Clock::time_point lastCheckpoint = Clock::now();
+    std::vector<Tile> tiles = Tile::split(crop.x0, crop.y0, crop.x1, crop.y1, tileSize);
+
+    for(size_t s = firstSample; s < samplesPerPixel; s++)
+    {
+        renderPass(accumulation, tiles, s);
+
+        // The snapshot is taken here, between passes, so it is consistent;
+        // the (slow) file write happens on the writer thread
+        if(writer && s + 1 < samplesPerPixel &&
+           std::chrono::duration<double>(Clock::now() - lastCheckpoint).count() >= checkpoint->interval)
+        {
+            CheckpointState state;
+            capture(state, s + 1);
+            writer->submit(state);
+            lastCheckpoint = Clock::now();
+        }
+    }
+
+    if(writer)
+    {
+        // Leave a final checkpoint: a later --resume just reproduces the image
+        CheckpointState state;
+        capture(state, samplesPerPixel);
+        writer->submit(state);
+        writer->flush();
+    }
+
+    // Average of the samples
+    double invSamples = 1.0 / std::max<size_t>(samplesPerPixel, 1);
+    for(size_t row = 0; row < crop.getHeight(); row++)
+    {
+        for(size_t col = 0; col < crop.getWidth(); col++)
+        {
+            Vector3D value = accumulation.getPixelValue(col, row) * invSamples;
+            film.setPixelValue(col, row, value);
+        }
+    }
+    return 0;
+}
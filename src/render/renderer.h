@@ -0,0 +1,129 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <vector>
+
+#include "tile.h"
+#include "checkpoint.h"
+#include "cropwindow.h"
+#include "visibilitybuffer.h"
+#include "../core/film.h"
+#include "../core/rng.h"
+#include "../cameras/camera.h"
+#include "../shapes/shape.h"
+
+class MemoryArena;
+class TiledFilm;
+
+// Shapes that may be visible through a tile (see
+// Renderer::getTileCandidates). It does not own the array
+struct ShapeList
+{
+    Shape *const *shapes;
+    size_t size;
+};
+
+/**
+ * @brief The Renderer class
+ *
+ * Traces one primary ray through the center of every pixel of the camera
+ * film. Rendering is organized in tiles so that the image can be split among
+ * threads (render) or processes (DistributedRenderer). Each tile only tests
+ * the shapes whose bounds reach the camera sub-frustum of the tile (see
+ * Frustum), so small objects cost nothing to the tiles they do not cover.
+ * Optionally, primary visibility is rasterized first (see VisibilityBuffer)
+ * and each pixel only tests the shapes whose projection covers it.
+ *
+ * A crop window restricts rendering to a region of the image. The films
+ * given to render(), renderPass() and renderSamples() then hold just that
+ * region: pixel (col, row) of the image goes to (col - x0, row - y0).
+ */
+class Renderer
+{
+public:
+    // Constructor(s)
+    Renderer(const Camera &camera_, const std::vector<Shape*> &objects_);
+    Renderer() = delete;
+
+    // Getters (full image resolution)
+    size_t getWidth()  const;
+    size_t getHeight() const;
+    uint64_t getSeed() const;
+    bool getFrustumCulling() const;
+    bool getRasterizedVisibility() const;
+    const CropWindow &getCropWindow() const;
+
+    // Setters
+    void setSeed(uint64_t seed);
+    void setFrustumCulling(bool enabled);
+    // Builds (or releases) the visibility buffer. It is a snapshot of the
+    // camera and shapes, so it must be rebuilt if they move
+    void setRasterizedVisibility(bool enabled);
+    // Clamped to the image. Defaults to the full frame
+    void setCropWindow(const CropWindow &crop_);
+
+    // Member functions
+    // Films given to the renderer hold the crop window, whose pixel (x0, y0)
+    // is their pixel (0, 0). Returns 0 if a film of the given size does, and
+    // otherwise prints a problem on behalf of "caller" and returns -1
+    int checkFilmSize(size_t filmWidth, size_t filmHeight, const char *caller) const;
+    Vector3D computePixel(size_t col, size_t row) const;
+    // Same, for a pixel of a tile whose candidates are already known (see
+    // getTileCandidates)
+    Vector3D computePixel(size_t col, size_t row, const ShapeList &tileCandidates) const;
+    // Radiance along the ray through the sampleIndex-th position of the
+    // pixel. Sample 0 is the pixel center, so computeSample(c, r, 0) equals
+    // computePixel(c, r); the others are jittered with the counter-based
+    // generator, keyed by (pixel, sample index, dimension)
+    Vector3D computeSample(size_t col, size_t row, size_t sampleIndex) const;
+
+    // Shapes that may be visible through the tile. The list is allocated
+    // from "arena" (normally the tile arena of the thread), so it is valid
+    // until the arena is reset. With frustum culling disabled it is the
+    // scene list itself, and nothing is allocated
+    ShapeList getTileCandidates(const Tile &tile, MemoryArena &arena) const;
+
+    // Renders the tile into "out", which must hold tile.getPixelCount()
+    // values stored row by row
+    void renderTile(const Tile &tile, Vector3D *out) const;
+    // Renders the tile straight into its location in "film" (a film of the
+    // size of the crop window). Returns 0 on success
+    int renderTile(const Tile &tile, Film &film) const;
+    // Renders the whole crop window on the global thread pool. Returns 0 on
+    // success
+    int render(Film &film, size_t tileSize = 32) const;
+    // Same, into an out-of-core film, which must have the size of the crop.
+    // Render tiles match the film tiles and go out in scanline order, so
+    // each film tile is written once, whole, and nothing is paged back in.
+    // Returns 0 on success
+    int render(TiledFilm &film) const;
+    // Adds the sampleIndex-th sample of every pixel to "accumulation" (of
+    // the size of the crop window). Returns 0 on success
+    int renderPass(Film &accumulation, size_t sampleIndex, size_t tileSize = 32) const;
+    int renderPass(Film &accumulation, const std::vector<Tile> &tiles, size_t sampleIndex) const;
+    // Renders samplesPerPixel samples per pixel and stores their average in
+    // film. With checkpoint settings, the sums are periodically saved in the
+    // background and, if requested, the render resumes from the saved state
+    // (giving the same result, bit by bit, as an uninterrupted render).
+    // Returns 0 on success
+    int renderSamples(Film &film, size_t samplesPerPixel,
+                      const CheckpointSettings *checkpoint = nullptr,
+                      size_t tileSize = 32) const;
+
+private:
+    Vector3D traceSample(size_t col, size_t row, double dx, double dy,
+                         Shape *const *candidates, size_t nCandidates) const;
+    // Traces a sample of a pixel of a tile whose candidate list is known
+    Vector3D traceTileSample(size_t col, size_t row, double dx, double dy,
+                             const ShapeList &tileCandidates) const;
+    ShapeList getAllShapes() const;
+
+    const Camera &camera;
+    const std::vector<Shape*> &objects;
+    Philox sampler;
+    bool frustumCulling;
+    VisibilityBuffer visibility;
+    CropWindow crop;
+};
+
+#endif // RENDERER_H
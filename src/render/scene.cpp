@@ -0,0 +1,145 @@
+#include "scene.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "../shapes/sphere.h"
+
+Scene::Scene()
+{ }
+
+int Scene::load(const std::string &name_)
+{
+    name = name_;
+    shapes.clear();
+    objects.clear();
+
+    if(name == "sphere")
+    {
+        addShape(new Sphere(1.0, Matrix4x4::translate(Vector3D(0, 0, 3))));
+        return 0;
+    }
+    if(name == "spheres")
+    {
+        Sphere *glass  = new Sphere(0.8, Matrix4x4::translate(Vector3D(0, 0, 3)));
+        Sphere *mirror = new Sphere(1.2, Matrix4x4::translate(Vector3D(0.5, 0.3, 6)));
+        Sphere *red    = new Sphere(0.6, Matrix4x4::translate(Vector3D(-1.4, -0.4, 4)));
+        Sphere *blue   = new Sphere(0.6, Matrix4x4::translate(Vector3D(1.6, -0.8, 3.5)));
+        glass->setMaterial(Material(Vector3D(1, 1, 1), 0, 0.95, 1.5));
+        mirror->setMaterial(Material(Vector3D(1, 1, 1), 0.9));
+        red->setMaterial(Material(Vector3D(1, 0.2, 0.2)));
+        blue->setMaterial(Material(Vector3D(0.2, 0.3, 1)));
+        addShape(glass);
+        addShape(mirror);
+        addShape(red);
+        addShape(blue);
+        return 0;
+    }
+
+    return loadFile(name);
+}
+
+int Scene::loadFile(const std::string &fileName)
+{
+    std::ifstream inputFile(fileName);
+    if(!inputFile.is_open())
+    {
+        std::cout << "Problem at Scene::load() : \"" << fileName
+                  << "\" is neither a built-in scene nor a readable file" << std::endl;
+        return -1;
+    }
+
+    std::string line;
+    size_t lineNumber = 0;
+    while(std::getline(inputFile, line))
+    {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string type;
+        if(!(fields >> type) || type[0] == '#')
+            continue;
+
+        double radius, x, y, z;
+        if(type != "sphere" || !(fields >> radius >> x >> y >> z) || !(radius > 0))
+        {
+            std::cout << "Problem at Scene::load() : bad shape at line " << lineNumber
+                      << " of \"" << fileName << "\"" << std::endl;
+            shapes.clear();
+            objects.clear();
+            return -1;
+        }
+
+        // Optional material fields, in order
+        Material material;
+        double r, g, b;
+        if(fields >> r >> g >> b)
+        {
+            material.color = Vector3D(r, g, b);
+            fields >> material.reflectivity >> material.transmissivity >> material.eta;
+        }
+
+        Sphere *sphere = new Sphere(radius, Matrix4x4::translate(Vector3D(x, y, z)));
+        sphere->setMaterial(material);
+        addShape(sphere);
+    }
+    return 0;
+}
+
+const std::string &Scene::getName() const
+{
+    return name;
+}
+
+const std::vector<Shape*> &Scene::getObjects() const
+{
+    return objects;
+}
+
+void Scene::addShape(Shape *shape)
+{
+    shapes.push_back(std::unique_ptr<Shape>(shape));
+    objects.push_back(shape);
+}
+
+SceneCache::SceneCache() : nLoads(0)
+{ }
+
+std::shared_ptr<const Scene> SceneCache::get(const std::string &name)
+{
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<Entry> &slot = entries[name];
+        if(!slot)
+            slot = std::make_shared<Entry>();
+        entry = slot;
+    }
+
+    // Only the threads asking for this scene wait for its load
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if(!entry->scene)
+    {
+        std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+        if(scene->load(name) != 0)
+            return std::shared_ptr<const Scene>();
+        entry->scene = scene;
+
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        nLoads++;
+    }
+    return entry->scene;
+}
+
+size_t SceneCache::getLoadCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nLoads;
+}
+
+void SceneCache::clear()
+{
+    // Scenes still in use stay alive through their shared pointers
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+}
@@ -0,0 +1,85 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../shapes/shape.h"
+
+/**
+ * @brief The Scene class
+ *
+ * Set of shapes owned by the scene, in the form taken by the renderers.
+ * A scene is either one of the built-in ones ("sphere": the scene of the
+ * camera exercises, "spheres": the scene of the wavefront exercise) or a
+ * text file with one shape per line:
+ *
+ *     # comment
+ *     sphere <radius> <x> <y> <z> [<r> <g> <b> [<reflectivity> [<transmissivity> [<eta>]]]]
+ *
+ * Once loaded, a scene is never modified, so it can be rendered by any
+ * number of threads (and jobs) at the same time.
+ */
+class Scene
+{
+public:
+    // Constructor(s)
+    Scene();
+    Scene(const Scene &) = delete;
+    Scene &operator=(const Scene &) = delete;
+
+    // Loads a built-in scene or a scene file. Returns 0 on success
+    int load(const std::string &name);
+
+    // Getters
+    const std::string &getName() const;
+    const std::vector<Shape*> &getObjects() const;
+
+    // Member functions
+    void addShape(Shape *shape); // Takes ownership
+
+private:
+    int loadFile(const std::string &fileName);
+
+    std::string name;
+    std::vector<std::unique_ptr<Shape>> shapes;
+    std::vector<Shape*> objects;
+};
+
+/**
+ * @brief The SceneCache class
+ *
+ * Scenes shared by name between renders (thread-safe). Each scene is
+ * loaded once, by the first thread that asks for it; threads asking for it
+ * meanwhile wait for that load instead of repeating it.
+ */
+class SceneCache
+{
+public:
+    // Constructor(s)
+    SceneCache();
+    SceneCache(const SceneCache &) = delete;
+    SceneCache &operator=(const SceneCache &) = delete;
+
+    // The scene, or null if it cannot be loaded (failures are not cached)
+    std::shared_ptr<const Scene> get(const std::string &name);
+
+    size_t getLoadCount() const;
+    void clear();
+
+private:
+    struct Entry
+    {
+        std::mutex mutex;
+        std::shared_ptr<const Scene> scene;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+    size_t nLoads;
+};
+
+#endif // SCENE_H
@@ -0,0 +1,174 @@
+#include "scenegraph.h"
+
+#include <algorithm>
+#include <iostream>
+
+SceneGraph::SceneGraph() : stamp(0)
+{ }
+
+bool SceneGraph::isValid(int node) const
+{
+    return node >= 0 && (size_t)node < nodes.size();
+}
+
+int SceneGraph::addNode(int parent, const Matrix4x4 &local)
+{
+    Matrix4x4 localInverse;
+    if(!local.inverse(localInverse))
+        return -1;
+    stats.nInversions++;
+    return addNode(parent, local, localInverse);
+}
+
+int SceneGraph::addNode(int parent, const Matrix4x4 &local, const Matrix4x4 &localInverse)
+{
+    if(parent != -1 && !isValid(parent))
+    {
+        std::cout << "Problem at SceneGraph::addNode() : no node " << parent << std::endl;
+        return -1;
+    }
+
+    // Parents always have smaller ids than their children
+    int id = (int)nodes.size();
+    nodes.push_back(Node());
+    Node &node = nodes.back();
+    node.parent = parent;
+    node.local = local;
+    node.localInverse = localInverse;
+    node.dirty = false;
+    node.updateStamp = 0;
+    if(parent != -1)
+        nodes[parent].children.push_back(id);
+
+    markDirty(id);
+    return id;
+}
+
+void SceneGraph::attachShape(int node, Shape *shape)
+{
+    if(!isValid(node))
+    {
+        std::cout << "Problem at SceneGraph::attachShape() : no node " << node << std::endl;
+        return;
+    }
+    nodes[node].shapes.push_back(shape);
+    shape->setTransform(getWorld(node), getWorldInverse(node));
+}
+
+size_t SceneGraph::getNodeCount() const
+{
+    return nodes.size();
+}
+
+int SceneGraph::getParent(int node) const
+{
+    return isValid(node) ? nodes[node].parent : -1;
+}
+
+const Matrix4x4 &SceneGraph::getLocal(int node) const
+{
+    return nodes[node].local;
+}
+
+const Matrix4x4 &SceneGraph::getWorld(int node)
+{
+    if(isDirty())
+        update();
+    return nodes[node].world;
+}
+
+const Matrix4x4 &SceneGraph::getWorldInverse(int node)
+{
+    if(isDirty())
+        update();
+    return nodes[node].worldInverse;
+}
+
+const SceneGraphStats &SceneGraph::getStats() const
+{
+    return stats;
+}
+
+int SceneGraph::setLocal(int node, const Matrix4x4 &local)
+{
+    Matrix4x4 localInverse;
+    if(!isValid(node) || !local.inverse(localInverse))
+        return -1;
+    stats.nInversions++;
+    return setLocal(node, local, localInverse);
+}
+
+int SceneGraph::setLocal(int node, const Matrix4x4 &local, const Matrix4x4 &localInverse)
+{
+    if(!isValid(node))
+        return -1;
+    nodes[node].local = local;
+    nodes[node].localInverse = localInverse;
+    markDirty(node);
+    return 0;
+}
+
+bool SceneGraph::isDirty() const
+{
+    return !dirtyNodes.empty();
+}
+
+void SceneGraph::markDirty(int node)
+{
+    if(!nodes[node].dirty)
+    {
+        nodes[node].dirty = true;
+        dirtyNodes.push_back(node);
+    }
+}
+
+void SceneGraph::update()
+{
+    if(dirtyNodes.empty())
+        return;
+    stamp++;
+    stats.nUpdates++;
+
+    // Ancestors first (smaller ids): the traversal of a changed node also
+    // refreshes the changed nodes below it, which are then skipped
+    std::sort(dirtyNodes.begin(), dirtyNodes.end());
+    for(size_t i = 0; i < dirtyNodes.size(); i++)
+    {
+        if(nodes[dirtyNodes[i]].updateStamp != stamp)
+            updateSubtree(dirtyNodes[i]);
+    }
+    for(size_t i = 0; i < dirtyNodes.size(); i++)
+        nodes[dirtyNodes[i]].dirty = false;
+    dirtyNodes.clear();
+}
+
+void SceneGraph::updateSubtree(int root)
+{
+    // Depth first: a node is reached after its parent, whose world
+    // transform is thus already up to date
+    stack.clear();
+    stack.push_back(root);
+    while(!stack.empty())
+    {
+        Node &node = nodes[stack.back()];
+        stack.pop_back();
+
+        if(node.parent == -1)
+        {
+            node.world = node.local;
+            node.worldInverse = node.localInverse;
+        }
+        else
+        {
+            const Node &parent = nodes[node.parent];
+            Matrix4x4::multiply(parent.world, node.local, node.world);
+            Matrix4x4::multiply(node.localInverse, parent.worldInverse, node.worldInverse);
+        }
+        node.updateStamp = stamp;
+        stats.nNodesUpdated++;
+
+        for(size_t s = 0; s < node.shapes.size(); s++)
+            node.shapes[s]->setTransform(node.world, node.worldInverse);
+        stack.insert(stack.end(), node.children.begin(), node.children.end());
+    }
+}
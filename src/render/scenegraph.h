@@ -0,0 +1,102 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "../core/matrix4x4.h"
+#include "../shapes/shape.h"
+
+/**
+ * @brief The SceneGraphStats struct
+ */
+struct SceneGraphStats
+{
+    uint64_t nUpdates;      // update() calls that found changes
+    uint64_t nNodesUpdated; // World matrices recomputed
+    uint64_t nInversions;   // Local transforms inverted
+
+    SceneGraphStats() : nUpdates(0), nNodesUpdated(0), nInversions(0)
+    { }
+};
+
+/**
+ * @brief The SceneGraph class
+ *
+ * Tree of transform nodes. Each node has a local transform (relative to its
+ * parent) and, once updated, its world transform and inverse:
+ *
+ *     world(n)        = world(parent) * local(n)
+ *     worldInverse(n) = localInverse(n) * worldInverse(parent)
+ *
+ * so inverting a changed local transform (one 4x4 inversion) is the only
+ * inversion ever done, and moving a node costs one traversal of its
+ * subtree, made of matrix products. Changes only flag the node; the world
+ * matrices of the flagged subtrees are recomputed on the next update(),
+ * which the world getters call when needed.
+ *
+ * Shapes attached to a node get its world transform (and inverse) pushed
+ * by every update that touches the node, so a group of shapes moves with
+ * its parent. Updates are not thread-safe: apply them between renders.
+ */
+class SceneGraph
+{
+public:
+    // Constructor(s)
+    SceneGraph();
+
+    // Adds a node below "parent" (-1 for a root) and returns its id, or -1
+    // if the parent does not exist or the local transform is singular
+    int addNode(int parent, const Matrix4x4 &local = Matrix4x4());
+    // Same, with a known inverse of the local transform
+    int addNode(int parent, const Matrix4x4 &local, const Matrix4x4 &localInverse);
+
+    // The shape follows the node (it is not owned by the graph)
+    void attachShape(int node, Shape *shape);
+
+    // Getters
+    size_t getNodeCount() const;
+    int getParent(int node) const;
+    const Matrix4x4 &getLocal(int node) const;
+    // World transforms, brought up to date first if needed
+    const Matrix4x4 &getWorld(int node);
+    const Matrix4x4 &getWorldInverse(int node);
+    const SceneGraphStats &getStats() const;
+
+    // Setters (the subtree of the node is updated lazily). Return 0 on
+    // success
+    int setLocal(int node, const Matrix4x4 &local);
+    int setLocal(int node, const Matrix4x4 &local, const Matrix4x4 &localInverse);
+
+    // Member functions
+    bool isDirty() const;
+    // Recomputes the world transforms of every changed subtree and moves
+    // their shapes
+    void update();
+
+private:
+    struct Node
+    {
+        int parent;
+        std::vector<int> children;
+        std::vector<Shape*> shapes;
+        Matrix4x4 local;
+        Matrix4x4 localInverse;
+        Matrix4x4 world;
+        Matrix4x4 worldInverse;
+        bool dirty;           // Local transform changed since the last update
+        uint64_t updateStamp; // Last update() that recomputed the node
+    };
+
+    bool isValid(int node) const;
+    void markDirty(int node);
+    void updateSubtree(int root);
+
+    std::vector<Node> nodes;
+    std::vector<int> dirtyNodes; // Nodes whose local transform changed
+    std::vector<int> stack;      // Traversal scratch
+    uint64_t stamp;
+    SceneGraphStats stats;
+};
+
+#endif // SCENEGRAPH_H
@@ -0,0 +1,49 @@
+#include "tile.h"
+
+#include <algorithm>
+
+Tile::Tile() : id(0), x0(0), y0(0), x1(0), y1(0)
+{ }
+
+Tile::Tile(size_t id_, size_t x0_, size_t y0_, size_t x1_, size_t y1_)
+    : id(id_), x0(x0_), y0(y0_), x1(x1_), y1(y1_)
+{ }
+
+size_t Tile::getWidth() const
+{
+    return x1 - x0;
+}
+
+size_t Tile::getHeight() const
+{
+    return y1 - y0;
+}
+
+size_t Tile::getPixelCount() const
+{
+    return getWidth() * getHeight();
+}
+
+std::vector<Tile> Tile::split(size_t width, size_t height, size_t tileSize)
+{
+    return split(0, 0, width, height, tileSize);
+}
+
+std::vector<Tile> Tile::split(size_t x0, size_t y0, size_t x1, size_t y1,
+                              size_t tileSize)
+{
+    std::vector<Tile> tiles;
+    tileSize = std::max<size_t>(tileSize, 1);
+
+    for(size_t y = y0; y < y1; y += tileSize)
+    {
+        for(size_t x = x0; x < x1; x += tileSize)
+        {
+            tiles.push_back(Tile(tiles.size(), x, y,
+                                 std::min(x + tileSize, x1),
+                                 std::min(y + tileSize, y1)));
+        }
+    }
+
+    return tiles;
+}
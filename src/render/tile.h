@@ -0,0 +1,38 @@
+#ifndef TILE_H
+#define TILE_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief The Tile struct
+ *
+ * Rectangular block of pixels [x0, x1) x [y0, y1) of the image, in pixel
+ * coordinates (x = column, y = row).
+ */
+struct Tile
+{
+    // Constructors
+    Tile();
+    Tile(size_t id_, size_t x0_, size_t y0_, size_t x1_, size_t y1_);
+
+    // Member functions
+    size_t getWidth()      const;
+    size_t getHeight()     const;
+    size_t getPixelCount() const;
+
+    // Static methods
+    // Splits a width x height image in tiles of (at most) tileSize x tileSize
+    // pixels, in scanline order
+    static std::vector<Tile> split(size_t width, size_t height, size_t tileSize);
+    // Same for the region [x0, x1) x [y0, y1) of an image
+    static std::vector<Tile> split(size_t x0, size_t y0, size_t x1, size_t y1,
+                                   size_t tileSize);
+
+    // Structure data
+    size_t id;
+    size_t x0, y0;
+    size_t x1, y1;
+};
+
+#endif // TILE_H
@@ -0,0 +1,146 @@
+#include "visibilitybuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "frustum.h"
+#include "../core/parallel.h"
+
+VisibilityBuffer::VisibilityBuffer() : width(0), height(0)
+{ }
+
+// Pixel rectangle [x0, x1) x [y0, y1) covered by a shape
+struct ScreenRect
+{
+    size_t x0, y0, x1, y1;
+};
+
+// Converts an NDC interval to a clamped pixel interval, one pixel wider on
+// each side so that rounding never loses a covered pixel
+static void ndcToPixels(double ndcMin, double ndcMax, size_t resolution,
+                        size_t &first, size_t &last)
+{
+    double res = (double)resolution;
+    double lo = std::floor(ndcMin * res) - 1;
+    double hi = std::ceil(ndcMax * res) + 1;
+    first = (size_t)std::min(std::max(lo, 0.0), res);
+    last  = (size_t)std::min(std::max(hi, 0.0), res);
+}
+
+void VisibilityBuffer::build(const Camera &camera, const std::vector<Shape*> &objects,
+                             size_t width_, size_t height_)
+{
+    width  = width_;
+    height = height_;
+
+    // Screen rectangle of every shape. Shapes out of the view get an empty
+    // one; those that cannot be projected (some corner of the bounds lies
+    // behind the camera) conservatively cover the whole image
+    Frustum view(camera, 0, 0, 1, 1);
+    std::vector<ScreenRect> rects(objects.size());
+    for(size_t k = 0; k < objects.size(); k++)
+    {
+        ScreenRect &rect = rects[k];
+        rect.x0 = rect.y0 = rect.x1 = rect.y1 = 0;
+
+        Bounds3D bounds = objects[k]->getWorldBounds();
+        if(!view.intersects(bounds))
+            continue;
+
+        double uMin = INFINITY, vMin = INFINITY, uMax = -INFINITY, vMax = -INFINITY;
+        bool projected = true;
+        for(int i = 0; i < 8 && projected; i++)
+        {
+            double u, v;
+            projected = camera.worldToNdc(bounds.getCorner(i), u, v);
+            uMin = std::min(uMin, u); uMax = std::max(uMax, u);
+            vMin = std::min(vMin, v); vMax = std::max(vMax, v);
+        }
+
+        if(projected)
+        {
+            ndcToPixels(uMin, uMax, width, rect.x0, rect.x1);
+            ndcToPixels(vMin, vMax, height, rect.y0, rect.y1);
+        }
+        else
+        {
+            rect.x1 = width;
+            rect.y1 = height;
+        }
+    }
+
+    // Rows are independent: count the candidates of every pixel, turn the
+    // counts into offsets, then fill the lists (in shape order)
+    offsets.assign(width * height + 1, 0);
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t row = begin; row < end; row++)
+        {
+            size_t *rowCounts = &offsets[row * width + 1];
+            for(size_t k = 0; k < rects.size(); k++)
+            {
+                const ScreenRect &rect = rects[k];
+                if(row < rect.y0 || row >= rect.y1)
+                    continue;
+                for(size_t col = rect.x0; col < rect.x1; col++)
+                {
+                    rowCounts[col]++;
+                }
+            }
+        }
+    });
+
+    for(size_t p = 0; p < width * height; p++)
+    {
+        offsets[p + 1] += offsets[p];
+    }
+
+    shapes.resize(offsets[width * height]);
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        // Next free slot of each pixel of the row
+        std::vector<size_t> next(width);
+        for(size_t row = begin; row < end; row++)
+        {
+            std::copy(&offsets[row * width], &offsets[row * width] + width, next.begin());
+            for(size_t k = 0; k < rects.size(); k++)
+            {
+                const ScreenRect &rect = rects[k];
+                if(row < rect.y0 || row >= rect.y1)
+                    continue;
+                for(size_t col = rect.x0; col < rect.x1; col++)
+                {
+                    shapes[next[col]++] = objects[k];
+                }
+            }
+        }
+    });
+}
+
+void VisibilityBuffer::clear()
+{
+    width = height = 0;
+    offsets.clear();
+    shapes.clear();
+}
+
+bool VisibilityBuffer::isEmpty() const
+{
+    return offsets.empty();
+}
+
+size_t VisibilityBuffer::getCandidateCount(size_t col, size_t row) const
+{
+    size_t p = row * width + col;
+    return offsets[p + 1] - offsets[p];
+}
+
+Shape *const *VisibilityBuffer::getCandidates(size_t col, size_t row) const
+{
+    return shapes.data() + offsets[row * width + col];
+}
+
+size_t VisibilityBuffer::getTotalCandidates() const
+{
+    return shapes.size();
+}
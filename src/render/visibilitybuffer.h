@@ -0,0 +1,49 @@
+#ifndef VISIBILITYBUFFER_H
+#define VISIBILITYBUFFER_H
+
+#include <vector>
+
+#include "../cameras/camera.h"
+#include "../shapes/shape.h"
+
+/**
+ * @brief The VisibilityBuffer class
+ *
+ * Rasterized primary visibility. The world bounds of every shape are
+ * projected through the camera, and the shape is added to the candidate
+ * list of each pixel covered by the projected rectangle (plus a one pixel
+ * margin). A pixel then only needs the exact ray-shape test against its
+ * own candidates, so the cost is proportional to the covered area instead
+ * of pixels x shapes. The lists are stored compressed (CSR): the
+ * candidates of pixel p are shapes[offsets[p] .. offsets[p + 1]).
+ *
+ * The rectangle covers whole pixels, so the lists are valid for any sample
+ * position inside the pixel.
+ */
+class VisibilityBuffer
+{
+public:
+    // Constructor(s)
+    VisibilityBuffer();
+
+    // Rasterizes the bounds of "objects" seen from "camera" on a
+    // width x height grid
+    void build(const Camera &camera, const std::vector<Shape*> &objects,
+               size_t width, size_t height);
+    void clear();
+
+    // Getters
+    bool isEmpty() const;
+    size_t getCandidateCount(size_t col, size_t row) const;
+    Shape *const *getCandidates(size_t col, size_t row) const;
+    // Sum of the list lengths over all the pixels
+    size_t getTotalCandidates() const;
+
+private:
+    size_t width;
+    size_t height;
+    std::vector<size_t> offsets;
+    std::vector<Shape*> shapes;
+};
+
+#endif // VISIBILITYBUFFER_H
@@ -0,0 +1,434 @@
+#include "wavefront.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "../core/parallel.h"
+#include "../core/utils.h"
+
+WavefrontRenderer::WavefrontRenderer(const Camera &camera_, const std::vector<Shape*> &objects_,
+                                     const WavefrontSettings &settings_)
+    : camera(camera_), objects(objects_), settings(settings_),
+      crop(CropWindow::fullFrame(camera_.width, camera_.height))
+{
+    settings.waveSize  = std::max<size_t>(settings.waveSize, 1);
+    settings.batchSize = std::max<size_t>(settings.batchSize, 1);
+}
+
+const CropWindow &WavefrontRenderer::getCropWindow() const
+{
+    return crop;
+}
+
+void WavefrontRenderer::setCropWindow(const CropWindow &crop_)
+{
+    crop = crop_.clamped(camera.width, camera.height);
+}
+
+// Makes room for n entries in an array of the frame arena. The contents
+// are not kept: the old array is simply left to the arena
+template<typename T>
+static T *reserve(MemoryArena &arena, T *array, size_t &capacity, size_t n)
+{
+    if(n <= capacity)
+        return array;
+
+    capacity = std::max(n, 2 * capacity);
+    return static_cast<T *>(arena.alloc(capacity * sizeof(T), alignof(T)));
+}
+
+void WavefrontRenderer::Queue::allocate(size_t n, Workspace &workspace)
+{
+    size_t nBlocks = (n + blockRays - 1) >> blockShift;
+    blocks = reserve(workspace.arena, blocks, blockCapacity, nBlocks);
+    for(size_t b = 0; b < nBlocks; b++)
+    {
+        blocks[b] = workspace.pool.alloc();
+    }
+    size = n;
+}
+
+void WavefrontRenderer::Queue::release(Workspace &workspace)
+{
+    size_t nBlocks = (size + blockRays - 1) >> blockShift;
+    for(size_t b = 0; b < nBlocks; b++)
+    {
+        workspace.pool.free(blocks[b]);
+    }
+    size = 0;
+}
+
+ObjectPool<WavefrontRenderer::RayBlock> &WavefrontRenderer::getBlockPool()
+{
+    static thread_local ObjectPool<RayBlock> pool(8);
+    return pool;
+}
+
+int WavefrontRenderer::render(Film &film, WavefrontStats *stats) const
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    if(film.getWidth() != crop.getWidth() || film.getHeight() != crop.getHeight())
+    {
+        std::cout << "Problem at WavefrontRenderer::render() : film is "
+                  << film.getWidth() << "x" << film.getHeight() << ", expected "
+                  << crop.getWidth() << "x" << crop.getHeight() << std::endl;
+        return -1;
+    }
+
+    // Pixels are numbered within the crop window
+    size_t width   = crop.getWidth();
+    size_t nPixels = width * crop.getHeight();
+
+    // Everything taken from the frame arena is released when the render
+    // returns; the arena keeps its blocks for the next one
+    Workspace workspace(MemoryArena::forThread(ArenaLifetime::Frame), getBlockPool());
+    ArenaScope frame(workspace.arena);
+
+    Queue queue, next;
+    size_t waveCapacity = 0;
+    Vector3D *wave = nullptr;
+
+    if(stats)
+    {
+        *stats = WavefrontStats();
+        stats->raysPerDepth.assign(settings.maxDepth + 1, 0);
+    }
+
+    for(size_t firstPixel = 0; firstPixel < nPixels; firstPixel += settings.waveSize)
+    {
+        size_t waveSize = std::min(settings.waveSize, nPixels - firstPixel);
+        wave = reserve(workspace.arena, wave, waveCapacity, waveSize);
+        std::fill(wave, wave + waveSize, Vector3D(0, 0, 0));
+
+        queue.allocate(waveSize, workspace);
+        generate(firstPixel, queue);
+
+        for(size_t depth = 0; queue.size > 0; depth++)
+        {
+            if(stats)
+                stats->raysPerDepth[depth] += queue.size;
+
+            bool sorted = settings.sortMode != RaySortMode::None && depth >= settings.sortFromDepth &&
+                          queue.size >= settings.sortMinRays;
+            if(sorted)
+            {
+                Clock::time_point sortStart = Clock::now();
+                sort(queue, next, workspace);
+                if(stats)
+                {
+                    stats->nSortedQueues++;
+                    stats->nSortedRays += queue.size;
+                    stats->sortSeconds += std::chrono::duration<double>(Clock::now() - sortStart).count();
+                }
+            }
+
+            Clock::time_point intersectStart = Clock::now();
+            intersect(sorted ? next : queue);
+            if(stats)
+                stats->intersectSeconds += std::chrono::duration<double>(Clock::now() - intersectStart).count();
+
+            if(sorted)
+            {
+                Clock::time_point unsortStart = Clock::now();
+                unsort(next, workspace.order, queue);
+                next.release(workspace);
+                if(stats)
+                    stats->sortSeconds += std::chrono::duration<double>(Clock::now() - unsortStart).count();
+            }
+
+            workspace.contributions = reserve(workspace.arena, workspace.contributions,
+                                              workspace.contributionCapacity, queue.size);
+            shade(queue, workspace.contributions);
+
+            // Several rays of the queue may belong to the same pixel, so
+            // contributions are gathered serially (it is a cheap sweep)
+            for(size_t i = 0; i < queue.size; i++)
+            {
+                wave[queue.ray(i).pixel - firstPixel] += workspace.contributions[i];
+            }
+
+            if(depth < settings.maxDepth)
+                spawn(queue, next, workspace);
+            queue.release(workspace);
+            std::swap(queue, next);
+        }
+
+        for(size_t i = 0; i < waveSize; i++)
+        {
+            size_t pixel = firstPixel + i;
+            film.setPixelValue(pixel % width, pixel / width, wave[i]);
+        }
+
+        if(stats)
+            stats->nWaves++;
+    }
+
+    if(stats)
+        stats->seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    return 0;
+}
+
+void WavefrontRenderer::generate(size_t firstPixel, Queue &queue) const
+{
+    size_t cropWidth = crop.getWidth();
+
+    Parallel::forRange(0, queue.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            size_t pixel = firstPixel + i;
+            double u = (crop.x0 + pixel % cropWidth + .5) / camera.width;
+            double v = (crop.y0 + pixel / cropWidth + .5) / camera.height;
+
+            PathRay &path = queue.ray(i);
+            path.ray        = camera.generateRay(u, v);
+            path.throughput = Vector3D(1, 1, 1);
+            path.pixel      = pixel;
+            path.valid      = true;
+        }
+    });
+}
+
+void WavefrontRenderer::sort(const Queue &queue, Queue &sorted, Workspace &workspace) const
+{
+    // Bounds of the origins, to spread them over the whole Morton grid
+    Vector3D originMin(INFINITY, INFINITY, INFINITY);
+    Vector3D originMax(-INFINITY, -INFINITY, -INFINITY);
+    for(size_t i = 0; i < queue.size; i++)
+    {
+        const Vector3D &o = queue.ray(i).ray.o;
+        originMin = Vector3D(std::min(originMin.x, o.x), std::min(originMin.y, o.y), std::min(originMin.z, o.z));
+        originMax = Vector3D(std::max(originMax.x, o.x), std::max(originMax.y, o.y), std::max(originMax.z, o.z));
+    }
+    Vector3D extent = originMax - originMin;
+    Vector3D originScale(extent.x > 0 ? 1 / extent.x : 0,
+                         extent.y > 0 ? 1 / extent.y : 0,
+                         extent.z > 0 ? 1 / extent.z : 0);
+
+    // Keys, order and radix sort scratch share one array
+    uint32_t *keys = workspace.keys =
+        reserve(workspace.arena, workspace.keys, workspace.keyCapacity, 3 * queue.size);
+    uint32_t *order        = workspace.order = keys + queue.size;
+    uint32_t *orderScratch = keys + 2 * queue.size;
+
+    Parallel::forRange(0, queue.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            keys[i] = RaySort::computeKey(queue.ray(i).ray, settings.sortMode, originMin, originScale);
+        }
+    });
+
+    RaySort::sortOrder(keys, queue.size, RaySort::getKeyBits(settings.sortMode), order, orderScratch);
+
+    sorted.allocate(queue.size, workspace);
+    Parallel::forRange(0, queue.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            sorted.ray(i) = queue.ray(order[i]);
+        }
+    });
+}
+
+void WavefrontRenderer::intersect(const Queue &queue) const
+{
+    Parallel::forRange(0, queue.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        // The rays of the batch are gathered as structure of arrays, and
+        // each shape intersects all of them in one call (as
+        // Utils::getClosestIntersection() does ray by ray, so the closest
+        // hits are the same); spheres take the whole batch to local
+        // coordinates with the SoA transforms of Matrix4x4
+        MemoryArena &arena = MemoryArena::forThread(ArenaLifetime::Tile);
+        ArenaScope scope(arena);
+        size_t n = end - begin;
+        double *soa = arena.alloc<double>(8 * n);
+        Intersection *its = arena.alloc<Intersection>(n);
+        bool *hit = arena.alloc<bool>(n);
+
+        RayBatch rays;
+        rays.ox = soa;         rays.oy = soa + n;     rays.oz = soa + 2 * n;
+        rays.dx = soa + 3 * n; rays.dy = soa + 4 * n; rays.dz = soa + 5 * n;
+        rays.minT = soa + 6 * n;
+        rays.maxT = soa + 7 * n;
+        rays.n = n;
+        for(size_t i = 0; i < n; i++)
+        {
+            const Ray &ray = queue.ray(begin + i).ray;
+            soa[i]         = ray.o.x;
+            soa[n + i]     = ray.o.y;
+            soa[2 * n + i] = ray.o.z;
+            soa[3 * n + i] = ray.d.x;
+            soa[4 * n + i] = ray.d.y;
+            soa[5 * n + i] = ray.d.z;
+            soa[6 * n + i] = ray.minT;
+            soa[7 * n + i] = ray.maxT;
+            hit[i] = false;
+        }
+
+        for(size_t k = 0; k < objects.size(); k++)
+        {
+            objects[k]->rayIntersect(rays, its, hit);
+        }
+
+        for(size_t i = 0; i < n; i++)
+        {
+            HitRecord &record = queue.hit(begin + i);
+            record.hit = hit[i];
+            if(hit[i])
+            {
+                record.its = its[i];
+                queue.ray(begin + i).ray.maxT = rays.maxT[i];
+            }
+        }
+    });
+}
+
+void WavefrontRenderer::unsort(const Queue &sorted, const uint32_t *order, Queue &queue) const
+{
+    Parallel::forRange(0, sorted.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            queue.hit(order[i]) = sorted.hit(i);
+        }
+    });
+}
+
+void WavefrontRenderer::shade(const Queue &queue, Vector3D *contributions) const
+{
+    Parallel::forRange(0, queue.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            const PathRay &path = queue.ray(i);
+            const HitRecord &hit = queue.hit(i);
+            if(!hit.hit)
+            {
+                contributions[i] = Utils::multiplyPerCanal(path.throughput, settings.background);
+                continue;
+            }
+
+            // The part of the path weight that is neither reflected nor
+            // transmitted ends here, with the flat color of the surface
+            const Material &material = hit.its.shape->getMaterial();
+            double kd = std::max(0.0, 1 - material.reflectivity - material.transmissivity);
+            contributions[i] = Utils::multiplyPerCanal(path.throughput, material.color) * kd;
+        }
+    });
+}
+
+void WavefrontRenderer::spawn(const Queue &queue, Queue &next, Workspace &workspace) const
+{
+    // Every ray has two child slots (reflected, transmitted) in the scratch
+    // array; each batch counts the slots it fills so that they can be
+    // compacted
+    size_t nBatches = (queue.size + settings.batchSize - 1) / settings.batchSize;
+    size_t *batchOffsets = workspace.batchOffsets =
+        reserve(workspace.arena, workspace.batchOffsets, workspace.batchCapacity, nBatches + 1);
+    PathRay *scratch = workspace.spawned =
+        reserve(workspace.arena, workspace.spawned, workspace.spawnedCapacity, 2 * queue.size);
+    batchOffsets[0] = 0;
+
+    Parallel::forRange(0, queue.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        size_t nChildren = 0;
+
+        for(size_t i = begin; i < end; i++)
+        {
+            PathRay &reflected   = scratch[2*i];
+            PathRay &transmitted = scratch[2*i + 1];
+            reflected.valid = transmitted.valid = false;
+
+            const HitRecord &hit = queue.hit(i);
+            if(!hit.hit)
+                continue;
+
+            const PathRay &parent = queue.ray(i);
+            const Intersection &its = hit.its;
+            const Material &material = its.shape->getMaterial();
+            if(!material.hasSpecular() && !material.hasTransmission())
+                continue;
+
+            // Orient the normal towards the incoming ray. Leaving the shape,
+            // the ray goes from the material (eta) to the air (1)
+            Vector3D normal = its.normal;
+            double cosThetaI = -dot(parent.ray.d.normalized(), normal);
+            double eta = 1.0 / material.eta;
+            if(cosThetaI < 0)
+            {
+                normal = -normal;
+                cosThetaI = -cosThetaI;
+                eta = material.eta;
+            }
+
+            double kr = material.reflectivity;
+            double kt = 0;
+            double cosThetaT = 0;
+            if(material.hasTransmission())
+            {
+                if(Utils::isTotalInternalReflection(eta, cosThetaI, cosThetaT))
+                {
+                    kr += material.transmissivity;
+                }
+                else
+                {
+                    double fresnel = Utils::computeReflectanceCoefficient(eta, cosThetaI, cosThetaT);
+                    kr += material.transmissivity * fresnel;
+                    kt  = material.transmissivity * (1 - fresnel);
+                }
+            }
+
+            Vector3D reflectedThroughput   = parent.throughput * kr;
+            Vector3D transmittedThroughput = parent.throughput * kt;
+            size_t depth = parent.ray.depth + 1;
+
+            if(std::max(std::max(reflectedThroughput.x, reflectedThroughput.y),
+                        reflectedThroughput.z) >= settings.minThroughput)
+            {
+                Vector3D direction = Utils::computeReflectionDirection(parent.ray.d, normal);
+                reflected.ray        = Ray(its.itsPoint, direction, depth);
+                reflected.throughput = reflectedThroughput;
+                reflected.pixel      = parent.pixel;
+                reflected.valid      = true;
+                nChildren++;
+            }
+
+            if(std::max(std::max(transmittedThroughput.x, transmittedThroughput.y),
+                        transmittedThroughput.z) >= settings.minThroughput)
+            {
+                Vector3D direction = Utils::computeTransmissionDirection(parent.ray, normal, eta,
+                                                                         cosThetaI, cosThetaT);
+                transmitted.ray        = Ray(its.itsPoint, direction, depth);
+                transmitted.throughput = transmittedThroughput;
+                transmitted.pixel      = parent.pixel;
+                transmitted.valid      = true;
+                nChildren++;
+            }
+        }
+
+        batchOffsets[begin / settings.batchSize + 1] = nChildren;
+    });
+
+    for(size_t b = 0; b < nBatches; b++)
+    {
+        batchOffsets[b + 1] += batchOffsets[b];
+    }
+
+    // Stream compaction: each batch copies its children to its own range
+    next.allocate(batchOffsets[nBatches], workspace);
+    Parallel::forRange(0, queue.size, settings.batchSize, [&](size_t begin, size_t end)
+    {
+        size_t out = batchOffsets[begin / settings.batchSize];
+        for(size_t slot = 2*begin; slot < 2*end; slot++)
+        {
+            if(scratch[slot].valid)
+                next.ray(out++) = scratch[slot];
+        }
+    });
+}
@@ -0,0 +1,200 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "cropwindow.h"
+#include "raysort.h"
+#include "../core/film.h"
+#include "../core/intersection.h"
+#include "../core/memoryarena.h"
+#include "../cameras/camera.h"
+#include "../shapes/shape.h"
+
+/**
+ * @brief The WavefrontSettings struct
+ */
+struct WavefrontSettings
+{
+    size_t maxDepth;       // Bounces allowed after the primary ray
+    size_t waveSize;       // Primary rays (pixels) in flight per wave
+    size_t batchSize;      // Queue entries handled by each parallel task
+    double minThroughput;  // Paths whose weight falls below this are dropped
+    Vector3D background;   // Color returned by rays that escape the scene
+
+    // Reordering of the queues before the intersect stage. Primary rays are
+    // generated in scanline order (already coherent), so by default only
+    // secondary queues of at least sortMinRays rays are sorted
+    RaySortMode sortMode;
+    size_t sortFromDepth;
+    size_t sortMinRays;
+
+    WavefrontSettings() : maxDepth(8), waveSize(1 << 16), batchSize(1024),
+                          minThroughput(1e-3), background(0, 0, 0),
+                          sortMode(RaySortMode::Morton), sortFromDepth(1),
+                          sortMinRays(4096)
+    { }
+};
+
+/**
+ * @brief The WavefrontStats struct
+ */
+struct WavefrontStats
+{
+    std::vector<size_t> raysPerDepth; // Rays traced at each depth
+    size_t nWaves;
+    size_t nSortedQueues;
+    size_t nSortedRays;
+    double sortSeconds;      // Time spent reordering queues
+    double intersectSeconds; // Time spent in the intersect stage
+    double seconds;
+
+    WavefrontStats() : nWaves(0), nSortedQueues(0), nSortedRays(0),
+                       sortSeconds(0), intersectSeconds(0), seconds(0)
+    { }
+};
+
+/**
+ * @brief The WavefrontRenderer class
+ *
+ * Traces primary and secondary (reflected and refracted) rays breadth first.
+ * Instead of following each path recursively, the image is processed in
+ * waves of waveSize pixels; all the rays of a wave that have the same depth
+ * sit in one queue, and every stage (generate, intersect, shade, spawn)
+ * sweeps the whole queue in parallel batches before the next one starts.
+ * Spawned rays are compacted into the queue of the next depth, keeping the
+ * order of their parents, so the result does not depend on the number of
+ * threads. A queue may be intersected in another order (see RaySortMode),
+ * so that neighbouring rays touch the same shapes; the hits are then put
+ * back in queue order, so shading, spawning and the sums of the pixels
+ * run in the same order, and give the same image, with or without it.
+ *
+ * As with Renderer, a crop window restricts rendering to a region of the
+ * image, and the film then holds just that region.
+ *
+ * Ray records come in pooled blocks (see RayBlock) and the queues and
+ * scratch arrays from the frame arena of the calling thread, so once a
+ * first render has warmed them up, the queues of later renders of the same
+ * size do not reach the heap.
+ */
+class WavefrontRenderer
+{
+public:
+    // Constructor(s)
+    WavefrontRenderer(const Camera &camera_, const std::vector<Shape*> &objects_,
+                      const WavefrontSettings &settings_ = WavefrontSettings());
+    WavefrontRenderer() = delete;
+
+    // Getters
+    const CropWindow &getCropWindow() const;
+
+    // Setters
+    // Clamped to the image. Defaults to the full frame
+    void setCropWindow(const CropWindow &crop_);
+
+    // Renders the crop window (one ray through the center of each pixel)
+    // into "film", which must have the size of the crop. Returns 0 on
+    // success
+    int render(Film &film, WavefrontStats *stats = nullptr) const;
+
+private:
+    // Queue entry: a ray, the weight of the path it belongs to, and the
+    // pixel of the film (row * width + col) that receives its contribution
+    struct PathRay
+    {
+        Ray ray;
+        Vector3D throughput;
+        size_t pixel;
+        bool valid; // Only used in the spawn scratch buffer
+    };
+
+    struct HitRecord
+    {
+        Intersection its;
+        bool hit;
+    };
+
+    // Records of blockRays consecutive queue entries. Blocks are recycled
+    // through an ObjectPool, so the records keep the locality of an array
+    // while the queues grow and shrink without reaching the heap
+    static const size_t blockShift = 10;
+    static const size_t blockRays  = (size_t)1 << blockShift;
+
+    struct RayBlock
+    {
+        PathRay rays[blockRays];
+        HitRecord hits[blockRays];
+
+        RayBlock() { } // The stages fill the records, there is nothing to clear
+    };
+
+    // Memory of a render, owned by the thread that runs it: its frame arena
+    // (released when render() returns) and its pool of blocks (kept for the
+    // next render)
+    struct Workspace
+    {
+        MemoryArena &arena;
+        ObjectPool<RayBlock> &pool;
+
+        // Scratch arrays, taken from the arena
+        Vector3D *contributions;
+        PathRay *spawned;
+        uint32_t *keys;  // Sort keys, order and radix sort scratch
+        uint32_t *order; // Original index of every entry of the sorted queue
+        size_t *batchOffsets;
+        size_t contributionCapacity, spawnedCapacity, keyCapacity, batchCapacity;
+
+        Workspace(MemoryArena &arena_, ObjectPool<RayBlock> &pool_)
+            : arena(arena_), pool(pool_), contributions(nullptr), spawned(nullptr),
+              keys(nullptr), order(nullptr), batchOffsets(nullptr), contributionCapacity(0),
+              spawnedCapacity(0), keyCapacity(0), batchCapacity(0)
+        { }
+    };
+
+    // Rays of one depth: blocks in the order of their entries, all of them
+    // full but the last. The array of blocks lives in the frame arena
+    struct Queue
+    {
+        RayBlock **blocks;
+        size_t size;
+        size_t blockCapacity;
+
+        Queue() : blocks(nullptr), size(0), blockCapacity(0)
+        { }
+
+        PathRay &ray(size_t i) const
+        {
+            return blocks[i >> blockShift]->rays[i & (blockRays - 1)];
+        }
+        HitRecord &hit(size_t i) const
+        {
+            return blocks[i >> blockShift]->hits[i & (blockRays - 1)];
+        }
+
+        // Takes the blocks for n entries (the queue must be empty)
+        void allocate(size_t n, Workspace &workspace);
+        // Gives the blocks back to the pool
+        void release(Workspace &workspace);
+    };
+
+    // Pipeline stages
+    void generate(size_t firstPixel, Queue &queue) const;
+    // Fills "sorted" with the rays of "queue" in key order
+    void sort(const Queue &queue, Queue &sorted, Workspace &workspace) const;
+    void intersect(const Queue &queue) const;
+    // Gives the hits of the sorted copy back to the entries of "queue"
+    void unsort(const Queue &sorted, const uint32_t *order, Queue &queue) const;
+    void shade(const Queue &queue, Vector3D *contributions) const;
+    void spawn(const Queue &queue, Queue &next, Workspace &workspace) const;
+
+    // Block pool of the calling thread
+    static ObjectPool<RayBlock> &getBlockPool();
+
+    const Camera &camera;
+    const std::vector<Shape*> &objects;
+    WavefrontSettings settings;
+    CropWindow crop;
+};
+
+#endif // WAVEFRONT_H
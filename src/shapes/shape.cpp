@@ -5,3 +5,60 @@ Shape::Shape(const Matrix4x4 &t_)
     objectToWorld = t_;
     objectToWorld.inverse(worldToObject);
 }
+
+const Material &Shape::getMaterial() const
+{
+    return material;
+}
+
+const Matrix4x4 &Shape::getObjectToWorld() const
+{
+    return objectToWorld;
+}
+
+const Matrix4x4 &Shape::getWorldToObject() const
+{
+    return worldToObject;
+}
+
+void Shape::setMaterial(const Material &material_)
+{
+    material = material_;
+}
+
+void Shape::setTransform(const Matrix4x4 &objectToWorld_, const Matrix4x4 &worldToObject_)
+{
+    objectToWorld = objectToWorld_;
+    worldToObject = worldToObject_;
+}
+
+size_t Shape::rayIntersectP(const Ray *rays, uint32_t *active, size_t nActive,
+                            bool *occluded) const
+{
+    // Generic version: one virtual call per ray, compacting in place
+    size_t nLeft = 0;
+    for(size_t i=0; i<nActive; i++)
+    {
+        uint32_t r = active[i];
+        if(rayIntersectP(rays[r]))
+            occluded[r] = true;
+        else
+            active[nLeft++] = r;
+    }
+    return nLeft;
+}
+
+void Shape::rayIntersect(const RayBatch &rays, Intersection *its, bool *hit) const
+{
+    // Generic version: one virtual call per ray
+    for(size_t i=0; i<rays.n; i++)
+    {
+        Ray ray(Vector3D(rays.ox[i], rays.oy[i], rays.oz[i]),
+                Vector3D(rays.dx[i], rays.dy[i], rays.dz[i]), 0, rays.minT[i], rays.maxT[i]);
+        if(rayIntersect(ray, its[i]))
+        {
+            rays.maxT[i] = ray.maxT;
+            hit[i] = true;
+        }
+    }
+}
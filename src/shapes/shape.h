@@ -1,11 +1,14 @@
 #ifndef SHAPE_H
 #define SHAPE_H
 
+#include <stdint.h>
+
+#include "../core/bounds3d.h"
 #include "../core/matrix4x4.h"
 #include "../core/vector3d.h"
 #include "../core/ray.h"
-
-class Intersection;
+#include "../core/intersection.h"
+#include "../materials/material.h"
 
 class Shape
 {
@@ -15,11 +18,47 @@ public:
 
     // Pure virtual function makes this class Abstract class.
     // Ray-shape intersection methods
+    // Any-hit (occlusion) query: true if the shape is hit at some
+    // t in [ray.minT, ray.maxT]. It stops as soon as the answer is known and
+    // computes neither the hit point nor the normal
     virtual bool rayIntersectP(const Ray &ray) const = 0;
 
+    // Batch form of rayIntersectP() over the rays rays[active[0..nActive)].
+    // Sets occluded[i] for every hit ray i, removes it from "active" and
+    // returns the number of rays still active
+    virtual size_t rayIntersectP(const Ray *rays, uint32_t *active, size_t nActive,
+                                 bool *occluded) const;
+
+    // Closest-hit query: if the shape is hit within [ray.minT, ray.maxT],
+    // fills "its", sets ray.maxT to the distance of the hit (so that farther
+    // shapes are discarded afterwards) and returns true
+    virtual bool rayIntersect(const Ray &ray, Intersection &its) const = 0;
+
+    // Batch form of rayIntersect() over the world-space rays of "rays": for
+    // every ray i hit within [minT[i], maxT[i]], fills its[i], lowers maxT[i]
+    // and sets hit[i]. Other entries are left alone, so that the shapes of a
+    // scene can be run one after the other over the same batch
+    virtual void rayIntersect(const RayBatch &rays, Intersection *its, bool *hit) const;
+
+    // Axis-aligned box, in world coordinates, that contains the shape
+    virtual Bounds3D getWorldBounds() const = 0;
+
+    // Getters
+    const Material &getMaterial() const;
+    const Matrix4x4 &getObjectToWorld() const;
+    const Matrix4x4 &getWorldToObject() const;
+
+    // Setters
+    void setMaterial(const Material &material_);
+    // Moves the shape. The inverse is given, not computed (e.g., it comes
+    // from SceneGraph, which derives it from the inverses of the local
+    // transforms)
+    void setTransform(const Matrix4x4 &objectToWorld_, const Matrix4x4 &worldToObject_);
+
 protected:
     Matrix4x4 objectToWorld;
     Matrix4x4 worldToObject;
+    Material material;
 };
 
 #endif // SHAPE_H
@@ -1,5 +1,12 @@
 #include "sphere.h"
 
+#include <algorithm>
+#include <cmath>
+
+// Rays taken to local coordinates at once by the batch intersection (their
+// local origins and directions are kept on the stack)
+static const size_t batchLanes = 64;
+
 Sphere::Sphere(const double radius_, const Matrix4x4 &t_)
     : Shape(t_), radius(radius_)
 { }
@@ -9,16 +16,141 @@ bool Sphere::rayIntersectP(const Ray &ray) const
     // Pass the ray to local coordinates
     Ray r = worldToObject.transformRay(ray);
 
+    return localIntersectP(r);
+}
+
+size_t Sphere::rayIntersectP(const Ray *rays, uint32_t *active, size_t nActive,
+                             bool *occluded) const
+{
+    // Same test, without a virtual call per ray
+    size_t nLeft = 0;
+    for(size_t i=0; i<nActive; i++)
+    {
+        uint32_t idx = active[i];
+        if(localIntersectP(worldToObject.transformRay(rays[idx])))
+            occluded[idx] = true;
+        else
+            active[nLeft++] = idx;
+    }
+    return nLeft;
+}
+
+bool Sphere::rayIntersect(const Ray &ray, Intersection &its) const
+{
+    // Pass the ray to local coordinates
+    Ray r = worldToObject.transformRay(ray);
+
+    double A = dot(r.d, r.d);
+    double B = 2 * dot(r.d, r.o);
+    double C = dot(r.o, r.o) - radius * radius;
+
+    double d = B*B - 4*A*C;
+    if(d < 0 || A == 0)
+        return false;
+
+    // Closest root within [minT, maxT]
+    double sqrtD = std::sqrt(d);
+    double t = (-B - sqrtD) / (2*A);
+    if(t < ray.minT || t > ray.maxT)
+    {
+        t = (-B + sqrtD) / (2*A);
+        if(t < ray.minT || t > ray.maxT)
+            return false;
+    }
+
+    // Farther shapes will be discarded from now on
+    ray.maxT = t;
+
+    // Normals transform with the inverse transpose of objectToWorld
+    Vector3D localNormal = (r.o + r.d * t) / radius;
+    its.itsPoint = ray.o + ray.d * t;
+    its.normal   = worldToObject.transposed().transformVector(localNormal).normalized();
+    its.shape    = this;
+
+    return true;
+}
+
+void Sphere::rayIntersect(const RayBatch &rays, Intersection *its, bool *hit) const
+{
+    // Same computations as rayIntersect(), in the same order (so the hits
+    // are the same, bit by bit), but the rays go to local coordinates in
+    // two batch transforms per group of lanes, and the quadratic of every
+    // lane is set up in a plain loop
+    double ox[batchLanes], oy[batchLanes], oz[batchLanes];
+    double dx[batchLanes], dy[batchLanes], dz[batchLanes];
+    double A[batchLanes], B[batchLanes], d[batchLanes];
+    const Matrix4x4 normalToWorld = worldToObject.transposed();
+
+    for(size_t first = 0; first < rays.n; first += batchLanes)
+    {
+        size_t n = std::min(batchLanes, rays.n - first);
+        worldToObject.transformPoints(rays.ox + first, rays.oy + first, rays.oz + first, n,
+                                      ox, oy, oz);
+        worldToObject.transformVectors(rays.dx + first, rays.dy + first, rays.dz + first, n,
+                                       dx, dy, dz);
+
+        for(size_t i = 0; i < n; i++)
+        {
+            A[i] = dx[i] * dx[i] + dy[i] * dy[i] + dz[i] * dz[i];
+            B[i] = 2 * (dx[i] * ox[i] + dy[i] * oy[i] + dz[i] * oz[i]);
+            double C = (ox[i] * ox[i] + oy[i] * oy[i] + oz[i] * oz[i]) - radius * radius;
+            d[i] = B[i] * B[i] - 4 * A[i] * C;
+        }
+
+        for(size_t i = 0; i < n; i++)
+        {
+            if(d[i] < 0 || A[i] == 0)
+                continue;
+
+            size_t r = first + i;
+            double sqrtD = std::sqrt(d[i]);
+            double t = (-B[i] - sqrtD) / (2 * A[i]);
+            if(t < rays.minT[r] || t > rays.maxT[r])
+            {
+                t = (-B[i] + sqrtD) / (2 * A[i]);
+                if(t < rays.minT[r] || t > rays.maxT[r])
+                    continue;
+            }
+            rays.maxT[r] = t;
+
+            Vector3D localNormal = (Vector3D(ox[i], oy[i], oz[i]) +
+                                    Vector3D(dx[i], dy[i], dz[i]) * t) / radius;
+            its[r].itsPoint = Vector3D(rays.ox[r], rays.oy[r], rays.oz[r]) +
+                              Vector3D(rays.dx[r], rays.dy[r], rays.dz[r]) * t;
+            its[r].normal   = normalToWorld.transformVector(localNormal).normalized();
+            its[r].shape    = this;
+            hit[r] = true;
+        }
+    }
+}
+
+Bounds3D Sphere::getWorldBounds() const
+{
+    Bounds3D local(Vector3D(-radius, -radius, -radius), Vector3D(radius, radius, radius));
+    return local.transformed(objectToWorld);
+}
+
+bool Sphere::localIntersectP(const Ray &r) const
+{
     // The ray-sphere intersection equation can be expressed in the
-    double A = pow(r.d.x,2) + pow(r.d.y, 2) + pow(r.d.z, 2);
-    double B = 2 * ((r.d.x*r.o.x) + (r.d.y* r.o.y) + (r.d.z*r.o.z));
-    double C = pow(r.o.x, 2) + pow(r.o.y, 2) + pow(r.o.z, 2) - pow(radius,2);
+    // form A*t^2 + B*t + C = 0, where
+    double A = dot(r.d, r.d);
+    double B = 2 * dot(r.d, r.o);
+    double C = dot(r.o, r.o) - radius * radius;
+
+    // Early exit: the ray line misses the sphere
+    double d = B*B - 4*A*C;
+    if(d < 0 || A == 0)
+        return false;
 
-    // Now we need to solve this quadratic equation for t
-    EqSolver solver;
-    rootValues roots;
+    // Any of the two roots within [minT, maxT] is enough (the transform is
+    // affine, so t has the same meaning in world and local coordinates)
+    double sqrtD = std::sqrt(d);
+    double t0 = (-B - sqrtD) / (2*A);
+    double t1 = (-B + sqrtD) / (2*A);
 
-    return solver.rootQuadEq(A, B, C, roots);
+    return (t0 >= r.minT && t0 <= r.maxT) ||
+           (t1 >= r.minT && t1 <= r.maxT);
 }
 
 std::string Sphere::toString() const
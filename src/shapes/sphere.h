@@ -14,9 +14,17 @@ public:
     Sphere(const double radius_, const Matrix4x4 &t);
 
     virtual bool rayIntersectP(const Ray &ray) const;
+    virtual size_t rayIntersectP(const Ray *rays, uint32_t *active, size_t nActive,
+                                 bool *occluded) const;
+    virtual bool rayIntersect(const Ray &ray, Intersection &its) const;
+    virtual void rayIntersect(const RayBatch &rays, Intersection *its, bool *hit) const;
+    virtual Bounds3D getWorldBounds() const;
     std::string toString() const;
 
 private:
+    // Any-hit test of a ray already in local coordinates
+    bool localIntersectP(const Ray &r) const;
+
     // The center of the sphere in local coordinates is assumed
     // to be (0, 0, 0). To pass to world coordinates just apply the
     // objectToWorld transformation contained in the mother class
@@ -0,0 +1,293 @@
+#include "mippyramid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../core/parallel.h"
+
+// Taps of a 1D resampling from srcSize to dstSize texels: output texel i
+// is sum_k weights[i * nTaps + k] * input[indices[i * nTaps + k]]
+struct ResampleTaps
+{
+    size_t nTaps;
+    std::vector<size_t> indices;
+    std::vector<float> weights;
+};
+
+static double sinc(double x)
+{
+    const double pi = 3.14159265358979323846;
+    if(std::fabs(x) < 1e-8)
+        return 1.0;
+    return std::sin(pi * x) / (pi * x);
+}
+
+// Modified Bessel function of the first kind, order 0
+static double besselI0(double x)
+{
+    double sum = 1, term = 1, halfX = x / 2;
+    for(int k = 1; k < 64 && term > 1e-12 * sum; k++)
+    {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+    }
+    return sum;
+}
+
+static double filterWeight(double x, const MipSettings &settings)
+{
+    double lobes = (double)settings.lobes;
+    if(std::fabs(x) >= lobes)
+        return 0;
+    if(settings.filter == MipFilter::Lanczos)
+        return sinc(x) * sinc(x / lobes);
+
+    double t = x / lobes;
+    return sinc(x) * besselI0(settings.kaiserAlpha * std::sqrt(1 - t * t)) /
+           besselI0(settings.kaiserAlpha);
+}
+
+static ResampleTaps computeTaps(size_t srcSize, size_t dstSize, const MipSettings &settings)
+{
+    ResampleTaps taps;
+    double scale = (double)srcSize / (double)dstSize;
+
+    // Box: exact overlap of each source texel with the footprint of the
+    // output texel. Others: filter evaluated at the source texel centers,
+    // stretched by the scale
+    double radius = settings.filter == MipFilter::Box ? scale / 2 : settings.lobes * scale;
+    taps.nTaps = (size_t)std::ceil(2 * radius) + 1;
+    taps.indices.assign(dstSize * taps.nTaps, 0);
+    taps.weights.assign(dstSize * taps.nTaps, 0.0f);
+
+    std::vector<double> w(taps.nTaps);
+    for(size_t i = 0; i < dstSize; i++)
+    {
+        double center = (i + 0.5) * scale;
+        long first = (long)std::floor(center - radius);
+        double sum = 0;
+        for(size_t k = 0; k < taps.nTaps; k++)
+        {
+            long t = first + (long)k;
+            if(settings.filter == MipFilter::Box)
+            {
+                double lo = std::max((double)t, center - radius);
+                double hi = std::min((double)t + 1, center + radius);
+                w[k] = std::max(hi - lo, 0.0);
+            }
+            else
+            {
+                w[k] = filterWeight((t + 0.5 - center) / scale, settings);
+            }
+            sum += w[k];
+        }
+
+        // Texels beyond the border repeat the border texel
+        for(size_t k = 0; k < taps.nTaps; k++)
+        {
+            long t = std::min(std::max(first + (long)k, 0L), (long)srcSize - 1);
+            taps.indices[i * taps.nTaps + k] = (size_t)t;
+            taps.weights[i * taps.nTaps + k] = sum != 0 ? (float)(w[k] / sum) : 0.0f;
+        }
+    }
+    return taps;
+}
+
+MipPyramid::MipPyramid()
+{ }
+
+MipPyramid::MipPyramid(const Film &film, const MipSettings &settings)
+{
+    build(film, settings);
+}
+
+MipPyramid::MipPyramid(const Vector3D *const *rows, size_t width, size_t height,
+                       const MipSettings &settings)
+{
+    build(rows, width, height, settings);
+}
+
+void MipPyramid::build(const Film &film, const MipSettings &settings)
+{
+    std::vector<const Vector3D *> rows(film.getHeight());
+    for(size_t y = 0; y < rows.size(); y++)
+        rows[y] = film.getRow(y);
+    build(rows.data(), film.getWidth(), film.getHeight(), settings);
+}
+
+void MipPyramid::build(const Vector3D *const *rows, size_t width, size_t height,
+                       const MipSettings &settings)
+{
+    widths.clear();
+    heights.clear();
+    offsets.clear();
+    texels.clear();
+    if(width == 0 || height == 0)
+        return;
+
+    // Level sizes first, so that the whole pyramid is allocated at once
+    size_t total = 0;
+    size_t w = width, h = height;
+    while(true)
+    {
+        widths.push_back(w);
+        heights.push_back(h);
+        offsets.push_back(total);
+        total += 3 * w * h;
+        if(w == 1 && h == 1)
+            break;
+        w = std::max(w / 2, (size_t)1);
+        h = std::max(h / 2, (size_t)1);
+    }
+    texels.assign(total, 0.0f);
+
+    Parallel::forRange(0, height, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t y = begin; y < end; y++)
+        {
+            float *dst = &texels[3 * y * width];
+            for(size_t x = 0; x < width; x++)
+            {
+                dst[3 * x]     = (float)rows[y][x].x;
+                dst[3 * x + 1] = (float)rows[y][x].y;
+                dst[3 * x + 2] = (float)rows[y][x].z;
+            }
+        }
+    });
+
+    for(size_t level = 1; level < widths.size(); level++)
+        downsample(level, settings);
+}
+
+void MipPyramid::downsample(size_t level, const MipSettings &settings)
+{
+    size_t srcW = widths[level - 1], srcH = heights[level - 1];
+    size_t dstW = widths[level], dstH = heights[level];
+    const float *src = &texels[offsets[level - 1]];
+    float *dst = &texels[offsets[level]];
+
+    ResampleTaps colTaps = computeTaps(srcW, dstW, settings);
+    ResampleTaps rowTaps = computeTaps(srcH, dstH, settings);
+
+    // Row pass: every source row resampled to dstW texels...
+    std::vector<float> narrow(3 * dstW * srcH);
+    Parallel::forRange(0, srcH, 16, [&](size_t begin, size_t end)
+    {
+        for(size_t y = begin; y < end; y++)
+        {
+            const float *in = src + 3 * y * srcW;
+            float *out = &narrow[3 * y * dstW];
+            for(size_t x = 0; x < dstW; x++)
+            {
+                const size_t *idx = &colTaps.indices[x * colTaps.nTaps];
+                const float *wgt = &colTaps.weights[x * colTaps.nTaps];
+                float r = 0, g = 0, b = 0;
+                for(size_t k = 0; k < colTaps.nTaps; k++)
+                {
+                    const float *p = in + 3 * idx[k];
+                    r += wgt[k] * p[0];
+                    g += wgt[k] * p[1];
+                    b += wgt[k] * p[2];
+                }
+                out[3 * x] = r;
+                out[3 * x + 1] = g;
+                out[3 * x + 2] = b;
+            }
+        }
+    });
+
+    // ... then each output row as a weighted sum of whole narrow rows
+    bool clamp = settings.clampNegative && settings.filter != MipFilter::Box;
+    Parallel::forRange(0, dstH, 8, [&](size_t begin, size_t end)
+    {
+        size_t n = 3 * dstW;
+        for(size_t y = begin; y < end; y++)
+        {
+            float *out = dst + y * n;
+            std::fill(out, out + n, 0.0f);
+            for(size_t k = 0; k < rowTaps.nTaps; k++)
+            {
+                float weight = rowTaps.weights[y * rowTaps.nTaps + k];
+                if(weight == 0)
+                    continue;
+                const float *in = &narrow[rowTaps.indices[y * rowTaps.nTaps + k] * n];
+                for(size_t t = 0; t < n; t++)
+                    out[t] += weight * in[t];
+            }
+            if(clamp)
+            {
+                for(size_t t = 0; t < n; t++)
+                    out[t] = std::max(out[t], 0.0f);
+            }
+        }
+    });
+}
+
+size_t MipPyramid::getLevelCount() const
+{
+    return widths.size();
+}
+
+size_t MipPyramid::getLevelWidth(size_t level) const
+{
+    return widths[level];
+}
+
+size_t MipPyramid::getLevelHeight(size_t level) const
+{
+    return heights[level];
+}
+
+const float *MipPyramid::getLevel(size_t level) const
+{
+    return &texels[offsets[level]];
+}
+
+Vector3D MipPyramid::getTexel(size_t level, size_t x, size_t y) const
+{
+    const float *p = getLevel(level) + 3 * (y * widths[level] + x);
+    return Vector3D(p[0], p[1], p[2]);
+}
+
+size_t MipPyramid::getTotalTexels() const
+{
+    return texels.size() / 3;
+}
+
+double MipPyramid::getLevelOfDetail(double footprint) const
+{
+    if(widths.empty() || !(footprint > 1))
+        return 0;
+    return std::min(std::log2(footprint), (double)(widths.size() - 1));
+}
+
+size_t MipPyramid::getLevelForFootprint(double footprint) const
+{
+    return (size_t)std::floor(getLevelOfDetail(footprint) + 0.5);
+}
+
+size_t MipPyramid::getLevelForSize(size_t maxWidth, size_t maxHeight) const
+{
+    for(size_t level = 0; level < widths.size(); level++)
+        if(widths[level] <= maxWidth && heights[level] <= maxHeight)
+            return level;
+    return widths.empty() ? 0 : widths.size() - 1;
+}
+
+void MipPyramid::toFilm(size_t level, Film &film) const
+{
+    if(level >= widths.size() || film.getWidth() != widths[level] ||
+       film.getHeight() != heights[level])
+    {
+        std::cout << "Problem at MipPyramid::toFilm() : no level " << level
+                  << " of the size of the film" << std::endl;
+        return;
+    }
+
+    for(size_t y = 0; y < heights[level]; y++)
+    {
+        Vector3D *row = film.getRow(y);
+        for(size_t x = 0; x < widths[level]; x++)
+            row[x] = getTexel(level, x, y);
+    }
+}
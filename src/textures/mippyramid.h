@@ -0,0 +1,93 @@
+#ifndef MIPPYRAMID_H
+#define MIPPYRAMID_H
+
+#include <vector>
+
+#include "../core/film.h"
+
+/**
+ * @brief The MipFilter enum
+ *
+ * Filter used to halve each level into the next one
+ */
+enum class MipFilter
+{
+    Box,     // Mean of the (about) 2x2 texels below each texel
+    Lanczos, // sinc(x) sinc(x / lobes), |x| < lobes
+    Kaiser   // sinc(x) times a Kaiser window of half-width "lobes"
+};
+
+/**
+ * @brief The MipSettings struct
+ */
+struct MipSettings
+{
+    MipFilter filter;
+    int lobes;          // Support (in texels of the smaller level) of
+                        //  Lanczos and Kaiser
+    double kaiserAlpha; // Shape of the Kaiser window (larger is smoother)
+    bool clampNegative; // Lanczos and Kaiser ring: negative results are
+                        //  clamped to 0 (what textures and previews want)
+
+    MipSettings() : filter(MipFilter::Box), lobes(3), kaiserAlpha(4),
+                    clampNegative(true)
+    { }
+};
+
+/**
+ * @brief The MipPyramid class
+ *
+ * Image pyramid: level 0 is the source image and each level halves the
+ * previous one (rounding down, never below 1 texel) until 1x1. All the
+ * levels live in a single allocation of RGB floats (3 per texel, row by
+ * row, level after level), so the pyramid is 4/3 of the source size at
+ * 12 bytes per texel. Each level is built with a separable polyphase
+ * filter: a row pass and a column pass, both parallel over rows, the
+ * latter as contiguous multiply-adds over whole rows.
+ */
+class MipPyramid
+{
+public:
+    // Constructor(s)
+    MipPyramid();
+    MipPyramid(const Film &film, const MipSettings &settings = MipSettings());
+    // From an image as given by BitMap::read()
+    MipPyramid(const Vector3D *const *rows, size_t width, size_t height,
+               const MipSettings &settings = MipSettings());
+
+    void build(const Film &film, const MipSettings &settings = MipSettings());
+    void build(const Vector3D *const *rows, size_t width, size_t height,
+               const MipSettings &settings = MipSettings());
+
+    // Getters
+    size_t getLevelCount() const;
+    size_t getLevelWidth(size_t level) const;
+    size_t getLevelHeight(size_t level) const;
+    // First float of the level (3 per texel, width * 3 floats per row)
+    const float *getLevel(size_t level) const;
+    Vector3D getTexel(size_t level, size_t x, size_t y) const;
+    size_t getTotalTexels() const;
+
+    // Level queries. A footprint is the size, in level-0 texels, of the
+    // area to average (e.g., the screen-space derivative of a lookup):
+    // getLevelOfDetail() is its continuous log2 (for trilinear lookups)
+    // and getLevelForFootprint() the nearest level
+    double getLevelOfDetail(double footprint) const;
+    size_t getLevelForFootprint(double footprint) const;
+    // Finest level that fits in maxWidth x maxHeight (e.g., thumbnails)
+    size_t getLevelForSize(size_t maxWidth, size_t maxHeight) const;
+
+    // Copies a level into film (of the size of the level)
+    void toFilm(size_t level, Film &film) const;
+
+private:
+    // Builds level "level" from level "level - 1"
+    void downsample(size_t level, const MipSettings &settings);
+
+    std::vector<size_t> widths;
+    std::vector<size_t> heights;
+    std::vector<size_t> offsets; // Of each level in "texels", in floats
+    std::vector<float> texels;
+};
+
+#endif // MIPPYRAMID_H
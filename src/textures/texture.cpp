@@ -0,0 +1,345 @@
+#include "texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "../core/parallel.h"
+
+// Spreads the low 32 bits of x to the even bits of the result
+static uint64_t spreadBits(uint64_t x)
+{
+    x &= 0xFFFFFFFFull;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8))  & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2))  & 0x3333333333333333ull;
+    x = (x | (x << 1))  & 0x5555555555555555ull;
+    return x;
+}
+
+static unsigned log2Ceil(size_t n)
+{
+    unsigned bits = 0;
+    while(((size_t)1 << bits) < n)
+        bits++;
+    return bits;
+}
+
+const size_t Texture::batchLanes;
+
+Texture::Texture() : tileShift(3)
+{ }
+
+Texture::Texture(const Film &film, const TextureSettings &settings_) : tileShift(3)
+{
+    build(MipPyramid(film, settings_.mip), settings_);
+}
+
+Texture::Texture(const Vector3D *const *rows, size_t width, size_t height,
+                 const TextureSettings &settings_) : tileShift(3)
+{
+    build(MipPyramid(rows, width, height, settings_.mip), settings_);
+}
+
+void Texture::build(const MipPyramid &pyramid, const TextureSettings &settings_)
+{
+    settings = settings_;
+    tileShift = log2Ceil(std::max(settings.tileSize, (size_t)1));
+    settings.tileSize = (size_t)1 << tileShift;
+
+    size_t nLevels = settings.mipmaps ? pyramid.getLevelCount()
+                                      : std::min(pyramid.getLevelCount(), (size_t)1);
+    widths.assign(nLevels, 0);
+    heights.assign(nLevels, 0);
+    columnStart.assign(nLevels, 0);
+    rowStart.assign(nLevels, 0);
+    columnIndex.clear();
+    rowIndex.clear();
+
+    // Index tables of each level, and its size including the padding
+    // required by the layout
+    size_t total = 0;
+    for(size_t level = 0; level < nLevels; level++)
+    {
+        size_t w = pyramid.getLevelWidth(level), h = pyramid.getLevelHeight(level);
+        widths[level] = w;
+        heights[level] = h;
+        columnStart[level] = columnIndex.size();
+        rowStart[level] = rowIndex.size();
+
+        size_t texels = w * h;
+        if(settings.layout == TextureLayout::Tiled)
+        {
+            // Tiles row by row, texels row by row inside each tile
+            size_t t = settings.tileSize, mask = t - 1;
+            size_t tilesX = (w + t - 1) / t;
+            for(size_t x = 0; x < w; x++)
+                columnIndex.push_back(((x >> tileShift) << (2 * tileShift)) + (x & mask));
+            for(size_t y = 0; y < h; y++)
+                rowIndex.push_back(total + (((y >> tileShift) * tilesX) << (2 * tileShift)) +
+                                   ((y & mask) << tileShift));
+            texels = tilesX * ((h + t - 1) / t) * t * t;
+        }
+        else if(settings.layout == TextureLayout::Morton)
+        {
+            // The low b bits of x and y are interleaved, and the remaining
+            // high bits of the larger side go on top (at most 2x padding
+            // per side)
+            unsigned bx = log2Ceil(w), by = log2Ceil(h), b = std::min(bx, by);
+            size_t mask = ((size_t)1 << b) - 1;
+            for(size_t x = 0; x < w; x++)
+                columnIndex.push_back((size_t)spreadBits(x & mask) | ((x >> b) << (2 * b)));
+            for(size_t y = 0; y < h; y++)
+                rowIndex.push_back(total + ((size_t)(spreadBits(y & mask) << 1) |
+                                            ((y >> b) << (2 * b))));
+            texels = ((size_t)1 << bx) * ((size_t)1 << by);
+        }
+        else
+        {
+            for(size_t x = 0; x < w; x++)
+                columnIndex.push_back(x);
+            for(size_t y = 0; y < h; y++)
+                rowIndex.push_back(total + y * w);
+        }
+        total += texels;
+    }
+
+    texels8.clear();
+    texelsF.clear();
+    if(settings.format == TextureFormat::RGB8)
+        texels8.assign(4 * total, 0);
+    else
+        texelsF.assign(4 * total, 0.0f);
+
+    for(size_t level = 0; level < nLevels; level++)
+    {
+        const float *src = pyramid.getLevel(level);
+        size_t w = widths[level];
+        Parallel::forRange(0, heights[level], 16, [&](size_t begin, size_t end)
+        {
+            for(size_t y = begin; y < end; y++)
+            {
+                for(size_t x = 0; x < w; x++)
+                {
+                    const float *p = src + 3 * (y * w + x);
+                    size_t index = getIndex(level, x, y);
+                    for(int c = 0; c < 3; c++)
+                    {
+                        if(settings.format == TextureFormat::RGB8)
+                        {
+                            float value = std::min(std::max(p[c], 0.0f), 1.0f);
+                            texels8[4 * index + c] = (uint8_t)(value * 255.0f + 0.5f);
+                        }
+                        else
+                        {
+                            texelsF[4 * index + c] = p[c];
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+size_t Texture::getWidth(size_t level) const
+{
+    return widths.empty() ? 0 : widths[level];
+}
+
+size_t Texture::getHeight(size_t level) const
+{
+    return heights.empty() ? 0 : heights[level];
+}
+
+size_t Texture::getLevelCount() const
+{
+    return widths.size();
+}
+
+size_t Texture::getBytes() const
+{
+    return texels8.size() + texelsF.size() * sizeof(float);
+}
+
+const TextureSettings &Texture::getSettings() const
+{
+    return settings;
+}
+
+size_t Texture::getTexelsPerLookup(TextureFilter filter)
+{
+    switch(filter)
+    {
+    case TextureFilter::Nearest:  return 1;
+    case TextureFilter::Bilinear: return 4;
+    default:                      return 8;
+    }
+}
+
+size_t Texture::getIndex(size_t level, size_t x, size_t y) const
+{
+    return columnIndex[columnStart[level] + x] + rowIndex[rowStart[level] + y];
+}
+
+long Texture::wrap(long c, size_t size) const
+{
+    long n = (long)size;
+    if(c >= 0 && c < n)
+        return c;
+    if(settings.wrap == TextureWrap::Clamp)
+        return c < 0 ? 0 : n - 1;
+    c %= n;
+    return c < 0 ? c + n : c;
+}
+
+void Texture::fetch(size_t index, float *rgb) const
+{
+    size_t i = 4 * index;
+    if(settings.format == TextureFormat::RGB8)
+    {
+        const float scale = 1.0f / 255.0f;
+        rgb[0] = texels8[i] * scale;
+        rgb[1] = texels8[i + 1] * scale;
+        rgb[2] = texels8[i + 2] * scale;
+    }
+    else
+    {
+        rgb[0] = texelsF[i];
+        rgb[1] = texelsF[i + 1];
+        rgb[2] = texelsF[i + 2];
+    }
+}
+
+Vector3D Texture::getTexel(size_t level, long x, long y) const
+{
+    float rgb[3];
+    fetch(getIndex(level, wrap(x, widths[level]), wrap(y, heights[level])), rgb);
+    return Vector3D(rgb[0], rgb[1], rgb[2]);
+}
+
+Vector3D Texture::sample(double u, double v, TextureFilter filter, double lod) const
+{
+    float fu = (float)u, fv = (float)v, flod = (float)lod, rgb[3];
+    sample(&fu, &fv, &flod, 1, filter, rgb);
+    return Vector3D(rgb[0], rgb[1], rgb[2]);
+}
+
+void Texture::nearestBatch(const float *u, const float *v, size_t n, float *rgb) const
+{
+    float w = (float)widths[0], h = (float)heights[0];
+    long x[batchLanes], y[batchLanes];
+    for(size_t i = 0; i < n; i++)
+    {
+        x[i] = (long)std::floor(u[i] * w);
+        y[i] = (long)std::floor(v[i] * h);
+    }
+    for(size_t i = 0; i < n; i++)
+        fetch(getIndex(0, wrap(x[i], widths[0]), wrap(y[i], heights[0])), &rgb[3 * i]);
+}
+
+void Texture::bilinearBatch(const float *u, const float *v, const size_t *level,
+                            const float *weight, size_t n, float *rgb) const
+{
+    // Texel coordinates and fractions of every lane...
+    float sx[batchLanes], sy[batchLanes], fx[batchLanes], fy[batchLanes];
+    long x0[batchLanes], y0[batchLanes];
+    for(size_t i = 0; i < n; i++)
+    {
+        sx[i] = u[i] * (float)widths[level[i]] - 0.5f;
+        sy[i] = v[i] * (float)heights[level[i]] - 0.5f;
+    }
+    for(size_t i = 0; i < n; i++)
+    {
+        float flx = std::floor(sx[i]), fly = std::floor(sy[i]);
+        fx[i] = sx[i] - flx;
+        fy[i] = sy[i] - fly;
+        x0[i] = (long)flx;
+        y0[i] = (long)fly;
+    }
+
+    // ... the indices of their four texels...
+    size_t index[4][batchLanes];
+    for(size_t i = 0; i < n; i++)
+    {
+        size_t l = level[i];
+        const size_t *columns = &columnIndex[columnStart[l]];
+        const size_t *rows = &rowIndex[rowStart[l]];
+        size_t xa = columns[wrap(x0[i], widths[l])], xb = columns[wrap(x0[i] + 1, widths[l])];
+        size_t ya = rows[wrap(y0[i], heights[l])], yb = rows[wrap(y0[i] + 1, heights[l])];
+        index[0][i] = xa + ya;
+        index[1][i] = xb + ya;
+        index[2][i] = xa + yb;
+        index[3][i] = xb + yb;
+    }
+
+    // ... gathered into channel-major arrays...
+    float c[4][3][batchLanes];
+    for(int k = 0; k < 4; k++)
+    {
+        for(size_t i = 0; i < n; i++)
+        {
+            float t[3];
+            fetch(index[k][i], t);
+            c[k][0][i] = t[0];
+            c[k][1][i] = t[1];
+            c[k][2][i] = t[2];
+        }
+    }
+
+    // ... and blended
+    for(int ch = 0; ch < 3; ch++)
+    {
+        float out[batchLanes];
+        for(size_t i = 0; i < n; i++)
+        {
+            float top    = c[0][ch][i] + fx[i] * (c[1][ch][i] - c[0][ch][i]);
+            float bottom = c[2][ch][i] + fx[i] * (c[3][ch][i] - c[2][ch][i]);
+            out[i] = weight[i] * (top + fy[i] * (bottom - top));
+        }
+        for(size_t i = 0; i < n; i++)
+            rgb[3 * i + ch] += out[i];
+    }
+}
+
+void Texture::sample(const float *u, const float *v, const float *lod, size_t n,
+                     TextureFilter filter, float *rgb) const
+{
+    if(widths.empty())
+    {
+        std::fill(rgb, rgb + 3 * n, 0.0f);
+        return;
+    }
+
+    size_t lastLevel = widths.size() - 1;
+    for(size_t start = 0; start < n; start += batchLanes)
+    {
+        size_t m = std::min(batchLanes, n - start);
+        const float *bu = u + start, *bv = v + start;
+        float *out = rgb + 3 * start;
+        std::fill(out, out + 3 * m, 0.0f);
+
+        if(filter == TextureFilter::Nearest)
+        {
+            nearestBatch(bu, bv, m, out);
+            continue;
+        }
+
+        size_t level0[batchLanes], level1[batchLanes];
+        float weight0[batchLanes], weight1[batchLanes];
+        bool trilinear = filter == TextureFilter::Trilinear && lod && lastLevel > 0;
+        for(size_t i = 0; i < m; i++)
+        {
+            float l = trilinear ? std::min(std::max(lod[start + i], 0.0f), (float)lastLevel) : 0.0f;
+            float fl = std::floor(l);
+            level0[i] = (size_t)fl;
+            level1[i] = std::min(level0[i] + 1, lastLevel);
+            weight1[i] = l - fl;
+            weight0[i] = 1.0f - weight1[i];
+        }
+
+        bilinearBatch(bu, bv, level0, weight0, m, out);
+        if(trilinear)
+            bilinearBatch(bu, bv, level1, weight1, m, out);
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "mippyramid.h"
+
+// Order of the texels of each level in memory
+enum class TextureLayout
+{
+    RowMajor, // As loaded (reference layout)
+    Tiled,    // Square tiles of tileSize x tileSize texels, tile after tile
+    Morton    // Z-order curve: texels close in 2D are close in memory
+};
+
+// Storage of each texel (both padded to 4 channels)
+enum class TextureFormat { RGB8, Float };
+
+enum class TextureFilter { Nearest, Bilinear, Trilinear };
+
+enum class TextureWrap { Repeat, Clamp };
+
+/**
+ * @brief The TextureSettings struct
+ */
+struct TextureSettings
+{
+    TextureLayout layout;
+    TextureFormat format;
+    TextureWrap wrap;
+    size_t tileSize;   // Power of two (Tiled layout)
+    bool mipmaps;      // Keep the whole pyramid (needed by Trilinear)
+    MipSettings mip;
+
+    TextureSettings() : layout(TextureLayout::Morton), format(TextureFormat::RGB8),
+                        wrap(TextureWrap::Repeat), tileSize(8), mipmaps(true)
+    { }
+};
+
+/**
+ * @brief The Texture class
+ *
+ * Image (and its mip levels) converted from the row-major Vector3D layout
+ * of Film and BitMap::read() (24 bytes per texel) into 4 or 16 bytes per
+ * texel, in an order that keeps the texels used by a 2D lookup in few
+ * cache lines. Texture coordinates (u, v) span [0, 1] over the image, with
+ * v = 0 at the first row; "lod" is the continuous mip level (see
+ * MipPyramid::getLevelOfDetail()), used by Trilinear only.
+ *
+ * The batch lookup handles the samples in groups of "batchLanes": index
+ * and weight computations run as plain loops over the group (which the
+ * compiler vectorizes), then the texels are gathered, then blended again
+ * in vector-friendly loops.
+ */
+class Texture
+{
+public:
+    // Constructor(s)
+    Texture();
+    Texture(const Film &film, const TextureSettings &settings = TextureSettings());
+    // From an image as given by BitMap::read()
+    Texture(const Vector3D *const *rows, size_t width, size_t height,
+            const TextureSettings &settings = TextureSettings());
+
+    void build(const MipPyramid &pyramid, const TextureSettings &settings);
+
+    // Getters
+    size_t getWidth(size_t level = 0) const;
+    size_t getHeight(size_t level = 0) const;
+    size_t getLevelCount() const;
+    size_t getBytes() const;
+    const TextureSettings &getSettings() const;
+
+    // Single lookups
+    Vector3D getTexel(size_t level, long x, long y) const;
+    Vector3D sample(double u, double v, TextureFilter filter, double lod = 0) const;
+
+    // Batch lookup of n samples: rgb receives 3 floats per sample; "lod"
+    // may be null (level 0)
+    void sample(const float *u, const float *v, const float *lod, size_t n,
+                TextureFilter filter, float *rgb) const;
+
+    // Texels read by one lookup with the given filter
+    static size_t getTexelsPerLookup(TextureFilter filter);
+
+    static const size_t batchLanes = 16;
+
+private:
+    // Index of texel (x, y) of a level (x, y already wrapped) in the texel
+    // array. Every layout is separable, index = f(x) + g(y), so both terms
+    // are looked up in per-level tables (g includes the level offset)
+    size_t getIndex(size_t level, size_t x, size_t y) const;
+    long wrap(long c, size_t size) const;
+    void fetch(size_t index, float *rgb) const;
+
+    // Bilinear lookups of a batch (at most batchLanes samples) of one level
+    // per sample; accumulates weight * color into rgb (3 floats per sample)
+    void bilinearBatch(const float *u, const float *v, const size_t *level,
+                       const float *weight, size_t n, float *rgb) const;
+    void nearestBatch(const float *u, const float *v, size_t n, float *rgb) const;
+
+    TextureSettings settings;
+    size_t tileShift;
+    std::vector<size_t> widths;
+    std::vector<size_t> heights;
+    std::vector<size_t> columnStart; // First entry of each level in columnIndex
+    std::vector<size_t> rowStart;    // First entry of each level in rowIndex
+    std::vector<size_t> columnIndex; // f(x) of every level
+    std::vector<size_t> rowIndex;    // g(y) of every level
+    std::vector<uint8_t> texels8;    // RGB8: 4 bytes per texel
+    std::vector<float> texelsF;      // Float: 4 floats per texel
+};
+
+#endif // TEXTURE_H
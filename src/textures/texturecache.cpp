@@ -0,0 +1,428 @@
+#include "texturecache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "../core/parallel.h"
+
+static const char tiledMagic[8] = { 'R', 'T', 'I', 'S', 'T', 'E', 'X', '1' };
+static const size_t tiledHeaderSize = 8 + 3 * sizeof(uint32_t);
+// Limits of the texture headers: tile keys keep 24 bits per tile coordinate,
+// and a single tile (of 3 bytes per texel) is at most 48 MB
+static const size_t maxTextureSide = 1 << 24;
+static const size_t maxTileSize = 4096;
+
+static uint64_t tileKey(int texture, size_t tileX, size_t tileY)
+{
+    return ((uint64_t)texture << 48) | ((uint64_t)tileY << 24) | (uint64_t)tileX;
+}
+
+static long wrapCoordinate(long c, size_t size)
+{
+    long n = (long)size;
+    if(c >= 0 && c < n)
+        return c;
+    c %= n;
+    return c < 0 ? c + n : c;
+}
+
+// Reads the header of a 24-bit uncompressed BMP. Returns false if the file
+// is not one
+static bool readBmpHeader(std::ifstream &stream, size_t &width, size_t &height,
+                          uint64_t &dataOffset, bool &bottomUp)
+{
+    char header[54];
+    stream.seekg(0);
+    if(!stream.read(header, 54) || header[0] != 'B' || header[1] != 'M')
+        return false;
+
+    int32_t offbits, fileWidth, fileHeight, compression;
+    int16_t bitCount;
+    memcpy(&offbits,     &header[10], sizeof(offbits));
+    memcpy(&fileWidth,   &header[18], sizeof(fileWidth));
+    memcpy(&fileHeight,  &header[22], sizeof(fileHeight));
+    memcpy(&bitCount,    &header[28], sizeof(bitCount));
+    memcpy(&compression, &header[30], sizeof(compression));
+    if(bitCount != 24 || compression != 0 || fileWidth <= 0 || fileHeight == 0)
+        return false;
+
+    width = (size_t)fileWidth;
+    bottomUp = fileHeight > 0;
+    height = (size_t)(fileHeight > 0 ? fileHeight : -fileHeight);
+    dataOffset = (uint64_t)offbits;
+    return true;
+}
+
+TextureCache::TextureCache(const TextureCacheSettings &settings_)
+    : settings(settings_), bytesRead(0), bytesResident(0), peakResident(0)
+{
+    size_t nShards = settings.nShards ? settings.nShards : 4 * Parallel::getThreadCount();
+    for(size_t i = 0; i < nShards; i++)
+        shards.push_back(std::unique_ptr<Shard>(new Shard()));
+    shardBudget = settings.memoryBudget / nShards;
+
+    size_t tileSize = std::min(std::max(settings.tileSize, (size_t)1), maxTileSize);
+    fitShards(tileSize * tileSize * 3);
+}
+
+void TextureCache::fitShards(size_t tileBytes)
+{
+    size_t nShards = std::max(settings.memoryBudget / tileBytes, (size_t)1);
+    if(nShards >= shards.size())
+        return;
+
+    // The counters of the removed shards are kept in the first one
+    clear();
+    for(size_t i = nShards; i < shards.size(); i++)
+    {
+        shards[0]->hits += shards[i]->hits;
+        shards[0]->misses += shards[i]->misses;
+        shards[0]->evictions += shards[i]->evictions;
+    }
+    shards.resize(nShards);
+    shardBudget = settings.memoryBudget / nShards;
+}
+
+int TextureCache::addTexture(const std::string &fileName)
+{
+    std::unique_ptr<TextureFile> file(new TextureFile());
+    file->fileName = fileName;
+    std::unique_ptr<std::ifstream> stream = acquireStream(*file);
+    if(!stream)
+    {
+        std::cout << "Problem at TextureCache::addTexture() : could not open file \""
+                  << fileName << "\"" << std::endl;
+        return -1;
+    }
+
+    stream->seekg(0, std::ios::end);
+    uint64_t fileSize = (uint64_t)stream->tellg();
+    stream->seekg(0);
+
+    char magic[8];
+    stream->read(magic, 8);
+    if(*stream && memcmp(magic, tiledMagic, 8) == 0)
+    {
+        // The header must describe a texture that the file actually holds
+        // before any tile is allocated from it
+        uint32_t fields[3];
+        bool valid = (bool)stream->read(reinterpret_cast<char *>(fields), sizeof(fields)) &&
+                     fields[0] > 0 && fields[0] <= maxTextureSide &&
+                     fields[1] > 0 && fields[1] <= maxTextureSide &&
+                     fields[2] > 0 && fields[2] <= maxTileSize;
+        if(valid)
+        {
+            uint64_t t = fields[2];
+            uint64_t nTiles = ((fields[0] + t - 1) / t) * ((fields[1] + t - 1) / t);
+            valid = fileSize >= tiledHeaderSize + nTiles * t * t * 3;
+        }
+        if(!valid)
+        {
+            std::cout << "Problem at TextureCache::addTexture() : corrupted tiled file \""
+                      << fileName << "\"" << std::endl;
+            return -1;
+        }
+        file->tiled = true;
+        file->width = fields[0];
+        file->height = fields[1];
+        file->tileSize = fields[2];
+        file->dataOffset = tiledHeaderSize;
+        file->rowStride = 0;
+    }
+    else
+    {
+        stream->clear();
+        bool bottomUp;
+        if(!readBmpHeader(*stream, file->width, file->height, file->dataOffset, bottomUp) ||
+           !bottomUp || file->width > maxTextureSide || file->height > maxTextureSide)
+        {
+            std::cout << "Problem at TextureCache::addTexture() : \"" << fileName
+                      << "\" is neither a 24-bit bottom-up BMP nor a tiled texture" << std::endl;
+            return -1;
+        }
+        file->tiled = false;
+        file->tileSize = std::min(std::max(settings.tileSize, (size_t)1), maxTileSize);
+        file->rowStride = (file->width * 3 + 3) / 4 * 4;
+        if(fileSize < file->dataOffset + (uint64_t)file->rowStride * file->height)
+        {
+            std::cout << "Problem at TextureCache::addTexture() : truncated BMP file \""
+                      << fileName << "\"" << std::endl;
+            return -1;
+        }
+    }
+    file->tilesX = (file->width + file->tileSize - 1) / file->tileSize;
+    fitShards(file->tileSize * file->tileSize * 3);
+
+    releaseStream(*file, std::move(stream));
+    textures.push_back(std::move(file));
+    return (int)textures.size() - 1;
+}
+
+size_t TextureCache::getWidth(int texture) const
+{
+    return textures[texture]->width;
+}
+
+size_t TextureCache::getHeight(int texture) const
+{
+    return textures[texture]->height;
+}
+
+std::unique_ptr<std::ifstream> TextureCache::acquireStream(TextureFile &file)
+{
+    {
+        std::lock_guard<std::mutex> lock(file.streamMutex);
+        if(!file.streams.empty())
+        {
+            std::unique_ptr<std::ifstream> stream = std::move(file.streams.back());
+            file.streams.pop_back();
+            return stream;
+        }
+    }
+
+    // All the streams are busy (at most one per thread loading a tile)
+    std::unique_ptr<std::ifstream> stream(new std::ifstream(file.fileName.c_str(),
+                                                            std::ios::binary | std::ios::in));
+    if(!stream->is_open())
+        return nullptr;
+    return stream;
+}
+
+void TextureCache::releaseStream(TextureFile &file, std::unique_ptr<std::ifstream> stream)
+{
+    stream->clear();
+    std::lock_guard<std::mutex> lock(file.streamMutex);
+    file.streams.push_back(std::move(stream));
+}
+
+std::shared_ptr<const TextureCache::Tile> TextureCache::loadTile(TextureFile &file,
+                                                                 size_t tileX, size_t tileY)
+{
+    size_t t = file.tileSize;
+    std::shared_ptr<Tile> tile = std::make_shared<Tile>(t * t * 3, 0);
+    size_t x0 = tileX * t, y0 = tileY * t;
+    size_t w = std::min(t, file.width - x0), h = std::min(t, file.height - y0);
+
+    std::unique_ptr<std::ifstream> stream = acquireStream(file);
+    if(!stream)
+    {
+        std::cout << "Problem at TextureCache::loadTile() : could not open file \""
+                  << file.fileName << "\"" << std::endl;
+        return tile;
+    }
+
+    if(file.tiled)
+    {
+        // Tiles are stored whole (edge tiles padded), in RGB order
+        uint64_t offset = file.dataOffset + (uint64_t)(tileY * file.tilesX + tileX) * tile->size();
+        stream->seekg(offset);
+        stream->read(reinterpret_cast<char *>(tile->data()), tile->size());
+        bytesRead += tile->size();
+    }
+    else
+    {
+        // One read per row of the tile; the BMP stores the last row first,
+        // in BGR order
+        std::vector<uint8_t> bgr(w * 3);
+        for(size_t y = 0; y < h; y++)
+        {
+            uint64_t fileRow = file.height - 1 - (y0 + y);
+            stream->seekg(file.dataOffset + fileRow * file.rowStride + x0 * 3);
+            stream->read(reinterpret_cast<char *>(bgr.data()), bgr.size());
+            uint8_t *dst = &(*tile)[y * t * 3];
+            for(size_t x = 0; x < w; x++)
+            {
+                dst[3 * x]     = bgr[3 * x + 2];
+                dst[3 * x + 1] = bgr[3 * x + 1];
+                dst[3 * x + 2] = bgr[3 * x];
+            }
+        }
+        bytesRead += w * h * 3;
+    }
+
+    if(!*stream)
+    {
+        std::cout << "Problem at TextureCache::loadTile() : could not read tile (" << tileX
+                  << ", " << tileY << ") of \"" << file.fileName << "\"" << std::endl;
+    }
+    releaseStream(file, std::move(stream));
+    return tile;
+}
+
+std::shared_ptr<const TextureCache::Tile> TextureCache::getTile(int texture, size_t tileX,
+                                                                size_t tileY)
+{
+    uint64_t key = tileKey(texture, tileX, tileY);
+    Shard &shard = *shards[(key * 0x9E3779B97F4A7C15ull >> 32) % shards.size()];
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.tiles.find(key);
+        if(found != shard.tiles.end())
+        {
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+            shard.hits++;
+            return found->second->second;
+        }
+    }
+
+    // Miss: the file is read with the shard unlocked. Two threads may load
+    // the same tile at once; the second one finds the first copy below
+    std::shared_ptr<const Tile> tile = loadTile(*textures[texture], tileX, tileY);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.misses++;
+    auto found = shard.tiles.find(key);
+    if(found != shard.tiles.end())
+        return found->second->second;
+
+    shard.lru.push_front(std::make_pair(key, tile));
+    shard.tiles[key] = shard.lru.begin();
+    shard.bytes += tile->size();
+    uint64_t resident = bytesResident += tile->size();
+
+    // Evict down to the budget (always keeping the new tile)
+    while(shard.bytes > shardBudget && shard.lru.size() > 1)
+    {
+        const Shard::LruList::value_type &last = shard.lru.back();
+        shard.bytes -= last.second->size();
+        resident = bytesResident -= last.second->size();
+        shard.tiles.erase(last.first);
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+
+    uint64_t peak = peakResident.load();
+    while(resident > peak && !peakResident.compare_exchange_weak(peak, resident))
+    { }
+    return tile;
+}
+
+Vector3D TextureCache::getTexel(int texture, long x, long y)
+{
+    const TextureFile &file = *textures[texture];
+    size_t wx = (size_t)wrapCoordinate(x, file.width);
+    size_t wy = (size_t)wrapCoordinate(y, file.height);
+    size_t t = file.tileSize;
+
+    std::shared_ptr<const Tile> tile = getTile(texture, wx / t, wy / t);
+    const uint8_t *p = &(*tile)[((wy % t) * t + (wx % t)) * 3];
+    return Vector3D(p[0], p[1], p[2]) / 255.0;
+}
+
+Vector3D TextureCache::sample(int texture, double u, double v, TextureFilter filter)
+{
+    const TextureFile &file = *textures[texture];
+    if(filter == TextureFilter::Nearest)
+        return getTexel(texture, (long)std::floor(u * file.width), (long)std::floor(v * file.height));
+
+    // Bilinear (there are no mip levels to blend for Trilinear)
+    double sx = u * file.width - 0.5, sy = v * file.height - 0.5;
+    double fx = std::floor(sx), fy = std::floor(sy);
+    long x0 = (long)fx, y0 = (long)fy;
+    double tx = sx - fx, ty = sy - fy;
+
+    Vector3D c00, c10, c01, c11;
+    size_t t = file.tileSize;
+    long wx = wrapCoordinate(x0, file.width), wy = wrapCoordinate(y0, file.height);
+    if((size_t)wx % t != t - 1 && (size_t)wy % t != t - 1 &&
+       (size_t)wx + 1 < file.width && (size_t)wy + 1 < file.height)
+    {
+        // Common case: the four texels are in the same tile (one lookup)
+        std::shared_ptr<const Tile> tile = getTile(texture, wx / t, wy / t);
+        const uint8_t *p = &(*tile)[(((size_t)wy % t) * t + (size_t)wx % t) * 3];
+        const uint8_t *q = p + t * 3;
+        c00 = Vector3D(p[0], p[1], p[2]);
+        c10 = Vector3D(p[3], p[4], p[5]);
+        c01 = Vector3D(q[0], q[1], q[2]);
+        c11 = Vector3D(q[3], q[4], q[5]);
+        c00 /= 255.0; c10 /= 255.0; c01 /= 255.0; c11 /= 255.0;
+    }
+    else
+    {
+        c00 = getTexel(texture, x0, y0);
+        c10 = getTexel(texture, x0 + 1, y0);
+        c01 = getTexel(texture, x0, y0 + 1);
+        c11 = getTexel(texture, x0 + 1, y0 + 1);
+    }
+
+    Vector3D top = c00 + (c10 - c00) * tx;
+    Vector3D bottom = c01 + (c11 - c01) * tx;
+    return top + (bottom - top) * ty;
+}
+
+TextureCacheStats TextureCache::getStats() const
+{
+    TextureCacheStats stats;
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        stats.hits += shards[i]->hits;
+        stats.misses += shards[i]->misses;
+        stats.evictions += shards[i]->evictions;
+    }
+    stats.bytesRead = bytesRead.load();
+    stats.bytesResident = bytesResident.load();
+    stats.peakResident = peakResident.load();
+    return stats;
+}
+
+void TextureCache::clear()
+{
+    for(size_t i = 0; i < shards.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        bytesResident -= shards[i]->bytes;
+        shards[i]->tiles.clear();
+        shards[i]->lru.clear();
+        shards[i]->bytes = 0;
+    }
+}
+
+int TextureCache::convertToTiled(const std::string &bmpName, const std::string &tiledName,
+                                 size_t tileSize)
+{
+    // A single-shard cache over the BMP with no budget (it only keeps the
+    // last tile) reads each tile once, in file order
+    TextureCacheSettings settings;
+    settings.tileSize = std::max(tileSize, (size_t)1);
+    settings.nShards = 1;
+    settings.memoryBudget = 0;
+    TextureCache cache(settings);
+    int texture = cache.addTexture(bmpName);
+    if(texture < 0)
+        return 1;
+
+    std::ofstream out(tiledName.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+    if(!out.is_open())
+    {
+        std::cout << "Problem at TextureCache::convertToTiled() : could not create file \""
+                  << tiledName << "\"" << std::endl;
+        return 1;
+    }
+
+    const TextureFile &file = *cache.textures[texture];
+    uint32_t fields[3] = { (uint32_t)file.width, (uint32_t)file.height, (uint32_t)file.tileSize };
+    out.write(tiledMagic, 8);
+    out.write(reinterpret_cast<const char *>(fields), sizeof(fields));
+
+    size_t tilesY = (file.height + file.tileSize - 1) / file.tileSize;
+    for(size_t ty = 0; ty < tilesY; ty++)
+    {
+        for(size_t tx = 0; tx < file.tilesX; tx++)
+        {
+            std::shared_ptr<const Tile> tile = cache.getTile(texture, tx, ty);
+            out.write(reinterpret_cast<const char *>(tile->data()), tile->size());
+        }
+    }
+
+    if(!out)
+    {
+        std::cout << "Problem at TextureCache::convertToTiled() : could not write file \""
+                  << tiledName << "\"" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <atomic>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "texture.h"
+
+/**
+ * @brief The TextureCacheSettings struct
+ */
+struct TextureCacheSettings
+{
+    size_t memoryBudget; // Bytes of tile data kept in memory (all shards)
+    size_t tileSize;     // Tile side of BMP textures (tiled files keep theirs)
+    size_t nShards;      // Independent locks/LRU lists (0: 4 per thread). At
+                         //  most one per tile that fits in the budget
+
+    TextureCacheSettings() : memoryBudget(256 << 20), tileSize(64), nShards(0)
+    { }
+};
+
+/**
+ * @brief The TextureCacheStats struct
+ */
+struct TextureCacheStats
+{
+    uint64_t hits;
+    uint64_t misses;       // Lookups that had to load their tile
+    uint64_t evictions;
+    uint64_t bytesRead;    // From the texture files
+    uint64_t bytesResident;
+    uint64_t peakResident;
+
+    TextureCacheStats() : hits(0), misses(0), evictions(0), bytesRead(0),
+                          bytesResident(0), peakResident(0)
+    { }
+};
+
+/**
+ * @brief The TextureCache class
+ *
+ * Textures are registered by file name and only their headers are read;
+ * tiles of texels (RGB, 8 bits per channel) are loaded from disk on first
+ * access and evicted in least-recently-used order once the memory budget
+ * is exceeded. Two file formats are read:
+ *  - 24-bit BMP files, whose tiles are read row by row with seeks, and
+ *  - pre-tiled files (see convertToTiled()), one read per tile.
+ *
+ * The cache is split into shards (by hash of the tile), each with its own
+ * mutex, LRU list, share of the budget and hit/miss counters, so that
+ * render threads looking up different tiles rarely wait for each other or
+ * write the same cache line. A shard always keeps the tile it loaded last,
+ * so there are never more shards than tiles that fit in the budget. Files
+ * are read with no lock held, each load through its own stream. Tiles are
+ * handed out as shared pointers, so a tile evicted while a thread still
+ * uses it stays valid until released.
+ */
+class TextureCache
+{
+public:
+    typedef std::vector<uint8_t> Tile;
+
+    // Constructor(s)
+    TextureCache(const TextureCacheSettings &settings_ = TextureCacheSettings());
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+
+    // Registers a texture (BMP or pre-tiled, detected from the contents) and
+    // returns its id, or -1 if the file cannot be used. Not thread-safe with
+    // respect to lookups: register the textures before rendering
+    int addTexture(const std::string &fileName);
+
+    size_t getWidth(int texture) const;
+    size_t getHeight(int texture) const;
+
+    // Lookups (thread-safe). Coordinates wrap around (repeat)
+    Vector3D getTexel(int texture, long x, long y);
+    Vector3D sample(int texture, double u, double v,
+                    TextureFilter filter = TextureFilter::Bilinear);
+
+    TextureCacheStats getStats() const;
+    void clear();
+
+    // Writes a BMP file as a pre-tiled file. Returns 0 on success
+    static int convertToTiled(const std::string &bmpName, const std::string &tiledName,
+                              size_t tileSize = 64);
+
+private:
+    struct TextureFile
+    {
+        std::string fileName;
+        bool tiled;          // Pre-tiled format (otherwise BMP)
+        size_t width;
+        size_t height;
+        size_t tileSize;
+        size_t tilesX;
+        uint64_t dataOffset; // Of the first pixel row / tile
+        size_t rowStride;    // BMP: bytes per (padded) row
+        // Idle streams of the file. A load takes one (or opens a new one)
+        // and gives it back, so misses on the same texture read in
+        // parallel, each with its own file position; the mutex only
+        // guards the list
+        std::vector<std::unique_ptr<std::ifstream>> streams;
+        std::mutex streamMutex;
+    };
+
+    struct Shard
+    {
+        typedef std::list<std::pair<uint64_t, std::shared_ptr<const Tile>>> LruList;
+        std::mutex mutex;
+        LruList lru; // Most recently used first
+        std::unordered_map<uint64_t, LruList::iterator> tiles;
+        size_t bytes;
+        // Guarded by the mutex, like the rest
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+
+        Shard() : bytes(0), hits(0), misses(0), evictions(0)
+        { }
+    };
+
+    std::shared_ptr<const Tile> getTile(int texture, size_t tileX, size_t tileY);
+    std::shared_ptr<const Tile> loadTile(TextureFile &file, size_t tileX, size_t tileY);
+    // Returns null if the file cannot be opened
+    static std::unique_ptr<std::ifstream> acquireStream(TextureFile &file);
+    static void releaseStream(TextureFile &file, std::unique_ptr<std::ifstream> stream);
+    // Lowers the number of shards (emptying the cache) if some shard could
+    // not hold a tile of tileBytes within its share of the budget
+    void fitShards(size_t tileBytes);
+
+    TextureCacheSettings settings;
+    std::vector<std::unique_ptr<TextureFile>> textures;
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardBudget;
+
+    // Only updated when a tile is loaded (the shards count the lookups)
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<uint64_t> bytesResident;
+    std::atomic<uint64_t> peakResident;
+};
+
+#endif // TEXTURECACHE_H